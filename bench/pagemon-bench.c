@@ -0,0 +1,494 @@
+/*
+ * Copyright (C) Colin Ian King 2015-2026
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * colin.i.king@gmail.com
+ */
+
+/*
+ *  pagemon benchmark driver. This pulls in pagemon.c directly
+ *  so the static readers and renderers can be timed as-is
+ *  against a synthetic target process created by pagemon-target.
+ */
+int pagemon_main(int argc, char **argv);
+
+#define main pagemon_main
+#include "../pagemon.c"
+#undef main
+
+#include <sys/wait.h>
+
+#define BENCH_ITERATIONS	(100)	/* Default iterations per benchmark */
+#define BENCH_COLS		(200)	/* Off-screen window width */
+#define BENCH_LINES		(60)	/* Off-screen window height */
+
+/*
+ *  Benchmark results, latency of each iteration
+ */
+typedef struct {
+	const char *name;		/* Benchmark name */
+	uint64_t *ns;			/* Per iteration latency */
+	uint64_t pages;			/* Pages processed */
+	uint32_t n;			/* Iterations run */
+} bench_t;
+
+static int bench_cmp(const void *p1, const void *p2)
+{
+	const uint64_t *a = (const uint64_t *)p1;
+	const uint64_t *b = (const uint64_t *)p2;
+
+	if (*a < *b)
+		return -1;
+	return (*a > *b) ? 1 : 0;
+}
+
+/*
+ *  bench_report()
+ *	sort the latencies and report throughput
+ *	and latency percentiles
+ */
+static void bench_report(bench_t *b)
+{
+	uint64_t total = 0;
+	uint32_t i;
+
+	if (!b->n)
+		return;
+	for (i = 0; i < b->n; i++)
+		total += b->ns[i];
+	qsort(b->ns, b->n, sizeof(*b->ns), bench_cmp);
+
+	(void)printf("%-12s %6" PRIu32 " %14.0f %10.1f %10.1f %10.1f %10.1f\n",
+		b->name, b->n,
+		total ? (double)b->pages * 1000000000.0 / (double)total : 0.0,
+		(double)b->ns[b->n / 2] / 1000.0,
+		(double)b->ns[(b->n * 95) / 100] / 1000.0,
+		(double)b->ns[(b->n * 99) / 100] / 1000.0,
+		(double)b->ns[b->n - 1] / 1000.0);
+}
+
+/*
+ *  bench_read_maps()
+ *	time forced re-reads of the maps
+ */
+static void bench_read_maps(bench_t *b, const uint32_t iterations)
+{
+	uint32_t i;
+
+	for (i = 0; i < iterations; i++) {
+		const uint64_t t = prof_time_ns();
+
+		if (read_maps(true) < 0)
+			break;
+		b->ns[b->n++] = prof_time_ns() - t;
+		b->pages += g.mem_info.npages;
+	}
+}
+
+/*
+ *  bench_parse_maps()
+ *	time parsing of the maps text alone, the
+ *	maps are read once up front
+ */
+static void bench_parse_maps(bench_t *b, const uint32_t iterations)
+{
+	const ssize_t len = maps_read();
+	uint32_t i;
+
+	if (len < 0)
+		return;
+	for (i = 0; i < iterations; i++) {
+		const uint64_t t = prof_time_ns();
+
+		if (maps_parse(g.mem_info.buf, (size_t)len) < 0)
+			break;
+		b->ns[b->n++] = prof_time_ns() - t;
+		b->pages += g.mem_info.npages;
+	}
+}
+
+/*
+ *  bench_pagemap_scan()
+ *	time full scans of the pagemap of all mappings
+ */
+static void bench_pagemap_scan(bench_t *b, const uint32_t iterations)
+{
+	static pagemap_t buf[65536];
+	const size_t buf_pages = sizeof(buf) / sizeof(buf[0]);
+	uint32_t i, j;
+	int fd;
+
+	if ((fd = open(g.path_pagemap, O_RDONLY)) < 0)
+		return;
+
+	for (i = 0; i < iterations; i++) {
+		const uint64_t t = prof_time_ns();
+
+		for (j = 0; j < g.mem_info.nmaps; j++) {
+			const map_t *map = &g.mem_info.maps[j];
+			addr_t page = map->begin / g.page_size;
+			const addr_t end = map->end / g.page_size;
+
+			while (page < end) {
+				const size_t n = MINIMUM(buf_pages, end - page);
+
+				if (pread(fd, buf, n * sizeof(pagemap_t),
+				    (off_t)(page * sizeof(pagemap_t))) < 0)
+					break;
+				page += n;
+			}
+		}
+		b->ns[b->n++] = prof_time_ns() - t;
+		b->pages += g.mem_info.npages;
+	}
+	(void)close(fd);
+}
+
+/*
+ *  bench_pyramid_sample()
+ *	time full pagemap samples into the page
+ *	state pyramid
+ */
+static void bench_pyramid_sample(bench_t *b, const uint32_t iterations)
+{
+	uint32_t i;
+
+	for (i = 0; i < iterations; i++) {
+		const uint64_t t = prof_time_ns();
+
+		pyramid_sample_all();
+		b->ns[b->n++] = prof_time_ns() - t;
+		b->pages += g.mem_info.npages;
+	}
+}
+
+/*
+ *  bench_numa_query()
+ *	time move_pages() NUMA node queries of
+ *	all the pages
+ */
+static void bench_numa_query(bench_t *b, const uint32_t iterations)
+{
+	uint32_t i;
+
+	if (numa_alloc() < 0)
+		return;
+	for (i = 0; i < iterations; i++) {
+		const uint64_t t = prof_time_ns();
+
+		numa_query(0, (index_t)g.mem_info.npages);
+		b->ns[b->n++] = prof_time_ns() - t;
+		b->pages += g.mem_info.npages;
+	}
+	numa_free();
+}
+
+/*
+ *  bench_show_zoom()
+ *	time rendering of page view frames straight
+ *	after a zoom change, stepping the zoom through
+ *	powers of 2 up to MAX_ZOOM
+ */
+static void bench_show_zoom(bench_t *b, const uint32_t iterations)
+{
+	position_t p;
+	uint32_t i;
+	int32_t zoom = MIN_ZOOM;
+
+	(void)memset(&p, 0, sizeof(p));
+	update_xymax(&p, VIEW_PAGE);
+	for (i = 0; i < iterations; i++) {
+		uint64_t t;
+
+		t = prof_time_ns();
+		(void)show_pages(0, 0, &p, zoom);
+		b->ns[b->n++] = prof_time_ns() - t;
+		b->pages += MINIMUM((uint64_t)zoom * p.xmax * p.ymax,
+			(uint64_t)g.mem_info.npages);
+		zoom = (zoom * 2 > MAX_ZOOM) ? MIN_ZOOM : zoom * 2;
+	}
+}
+
+/*
+ *  bench_show_pages()
+ *	time page view frames, sampling and rendering,
+ *	moving one window of pages further on each frame
+ */
+static void bench_show_pages(bench_t *b, const uint32_t iterations)
+{
+	position_t p;
+	index_t page_index = 0;
+	uint32_t i;
+
+	(void)memset(&p, 0, sizeof(p));
+	update_xymax(&p, VIEW_PAGE);
+	for (i = 0; i < iterations; i++) {
+		const index_t window = (index_t)p.xmax * p.ymax;
+		uint64_t t;
+
+		if (page_index >= (index_t)g.mem_info.npages)
+			page_index = 0;
+		t = prof_time_ns();
+		pyramid_sample_frame(page_index, MINIMUM(page_index + window,
+			(index_t)g.mem_info.npages));
+		(void)show_pages(page_index, page_index, &p, 1);
+		b->ns[b->n++] = prof_time_ns() - t;
+		b->pages += window;
+		page_index += window;
+	}
+}
+
+/*
+ *  bench_show_va()
+ *	time rendering of address view frames, stepping
+ *	through each cell size from 1 page to the whole
+ *	address space
+ */
+static void bench_show_va(bench_t *b, const uint32_t iterations)
+{
+	const uint32_t page_shift = (uint32_t)__builtin_ctz(g.page_size);
+	position_t p;
+	uint32_t i;
+
+	(void)memset(&p, 0, sizeof(p));
+	update_xymax(&p, VIEW_PAGE);
+	for (i = 0; i < iterations; i++) {
+		const uint32_t levels = va_shift_max(&p) - page_shift + 1;
+		uint64_t t;
+
+		va_goto(&p, g.mem_info.maps[0].begin, page_shift + (i % levels));
+		t = prof_time_ns();
+		(void)show_va(-1, &p);
+		b->ns[b->n++] = prof_time_ns() - t;
+		b->pages += (uint64_t)p.xmax * p.ymax;
+	}
+}
+
+/*
+ *  bench_show_memory()
+ *	time rendering of memory view frames,
+ *	one page further on each frame
+ */
+static void bench_show_memory(bench_t *b, const uint32_t iterations)
+{
+	position_t p[2];
+	index_t page_index = 0;
+	uint32_t i;
+
+	(void)memset(p, 0, sizeof(p));
+	update_xymax(p, VIEW_MEM);
+	for (i = 0; i < iterations; i++) {
+		uint64_t t;
+
+		if (page_index >= (index_t)g.mem_info.npages)
+			page_index = 0;
+		t = prof_time_ns();
+		(void)show_memory(page_index, 0, &p[VIEW_MEM]);
+		b->ns[b->n++] = prof_time_ns() - t;
+		b->pages++;
+		page_index++;
+	}
+}
+
+/*
+ *  bench_vm_read()
+ *	time reading and parsing of the VM stats
+ */
+static void bench_vm_read(bench_t *b, const uint32_t iterations)
+{
+	uint32_t i;
+
+	for (i = 0; i < iterations; i++) {
+		const uint64_t t = prof_time_ns();
+
+		if (vm_read(&g.vm) < 0)
+			break;
+		b->ns[b->n++] = prof_time_ns() - t;
+		b->pages++;
+	}
+	vm_close(&g.vm);
+}
+
+/*
+ *  bench_usage()
+ *	mini help info
+ */
+static void bench_usage(void)
+{
+	(void)printf("Usage: pagemon-bench [options] [-- target options]\n"
+		" -f dir    benchmark captured files in dir (see pagemon -C)\n"
+		"           rather than a synthetic target\n"
+		" -i n      iterations per benchmark, default %d\n"
+		" -t path   path to pagemon-target\n"
+		"target options are passed to pagemon-target, see "
+		"pagemon-target -h\n", BENCH_ITERATIONS);
+}
+
+int main(int argc, char **argv)
+{
+	static char default_target[] = "./bench/pagemon-target";
+	char *target = default_target;
+	const char *fixture_dir = NULL;
+	uint32_t iterations = BENCH_ITERATIONS;
+	char ready[8];
+	int fds[2], status;
+	pid_t pid;
+	FILE *devnull;
+	SCREEN *screen;
+	size_t i;
+	bench_t benches[] = {
+		{ "read_maps",	NULL, 0, 0 },
+		{ "parse_maps",	NULL, 0, 0 },
+		{ "pagemap",	NULL, 0, 0 },
+		{ "sample",	NULL, 0, 0 },
+		{ "show_pages",	NULL, 0, 0 },
+		{ "show_zoom",	NULL, 0, 0 },
+		{ "show_va",	NULL, 0, 0 },
+		{ "show_memory", NULL, 0, 0 },
+		{ "vm_read",	NULL, 0, 0 },
+		{ "numa",	NULL, 0, 0 },
+	};
+
+	for (;;) {
+		int c = getopt(argc, argv, "f:hi:t:");
+
+		if (c == -1)
+			break;
+		switch (c) {
+		case 'f':
+			fixture_dir = optarg;
+			break;
+		case 'i':
+			iterations = strtoul(optarg, NULL, 10);
+			if (iterations < 1) {
+				(void)fprintf(stderr, "Invalid iterations value\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 't':
+			target = optarg;
+			break;
+		case 'h':
+			bench_usage();
+			exit(EXIT_SUCCESS);
+		default:
+			bench_usage();
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	g.page_size = sysconf(_SC_PAGESIZE);
+	g.pidfd = -1;
+	if (fixture_dir) {
+		pid = 0;
+		if (fixture_init(fixture_dir) < 0) {
+			(void)fprintf(stderr, "Cannot read captured maps and "
+				"pagemap in %s\n", fixture_dir);
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		/* Start the target, remaining args are passed to it */
+		if (pipe(fds) < 0) {
+			(void)fprintf(stderr, "pipe failed: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		pid = fork();
+		if (pid < 0) {
+			(void)fprintf(stderr, "fork failed: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		if (pid == 0) {
+			argv[optind - 1] = target;
+			(void)dup2(fds[1], STDOUT_FILENO);
+			(void)close(fds[0]);
+			(void)close(fds[1]);
+			(void)execv(target, &argv[optind - 1]);
+			_exit(EXIT_FAILURE);
+		}
+		(void)close(fds[1]);
+		if (read(fds[0], ready, sizeof(ready)) < 5) {
+			(void)fprintf(stderr, "Target %s failed to start\n", target);
+			(void)waitpid(pid, &status, 0);
+			exit(EXIT_FAILURE);
+		}
+		proc_attach(pid);
+	}
+	g.max_pages = ((addr_t)((size_t)~0)) / g.page_size;
+
+	/* Render into an off-screen terminal */
+	devnull = fopen("/dev/null", "r+");
+	screen = devnull ? newterm("xterm", devnull, devnull) : NULL;
+	if (!screen) {
+		(void)fprintf(stderr, "Cannot create off-screen terminal\n");
+		if (pid)
+			(void)kill(pid, SIGKILL);
+		exit(EXIT_FAILURE);
+	}
+	(void)resizeterm(BENCH_LINES, BENCH_COLS);
+	(void)start_color();
+	g.mainwin = newwin(LINES, COLS, 0, 0);
+
+	for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+		benches[i].ns = calloc(iterations, sizeof(uint64_t));
+		if (!benches[i].ns) {
+			(void)fprintf(stderr, "Out of memory\n");
+			if (pid)
+				(void)kill(pid, SIGKILL);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	bench_read_maps(&benches[0], iterations);
+	bench_parse_maps(&benches[1], iterations);
+	/* Parsing left the page table stale, rebuild it */
+	(void)read_maps(true);
+	bench_pagemap_scan(&benches[2], iterations);
+	bench_pyramid_sample(&benches[3], iterations);
+	bench_show_pages(&benches[4], iterations);
+	bench_show_zoom(&benches[5], iterations);
+	bench_show_va(&benches[6], iterations);
+	/* Memory contents are not captured in fixtures */
+	if (!g.offline)
+		bench_show_memory(&benches[7], iterations);
+	bench_vm_read(&benches[8], iterations);
+	/* Nodes cannot be queried for fixtures */
+	if (!g.offline)
+		bench_numa_query(&benches[9], iterations);
+
+	(void)delwin(g.mainwin);
+	(void)endwin();
+	delscreen(screen);
+	(void)fclose(devnull);
+
+	(void)printf("%" PRIu32 " maps, %" PRIu64 " pages\n",
+		g.mem_info.nmaps, (uint64_t)g.mem_info.npages);
+	(void)printf("%-12s %6s %14s %10s %10s %10s %10s\n",
+		"Benchmark", "Iters", "Pages/sec", "p50 us", "p95 us",
+		"p99 us", "Max us");
+	for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+		bench_report(&benches[i]);
+		free(benches[i].ns);
+	}
+
+	if (pid) {
+		(void)kill(pid, SIGKILL);
+		(void)waitpid(pid, &status, 0);
+	}
+	free(g.mem_info.pages);
+	pyramid_free(&g.mem_info.pyramid);
+
+	exit(EXIT_SUCCESS);
+}
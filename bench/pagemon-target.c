@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) Colin Ian King 2015-2026
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * colin.i.king@gmail.com
+ */
+
+/*
+ *  Synthetic process for pagemon benchmarking. Creates a
+ *  configurable number of mappings with a given resident,
+ *  swapped and dirty page fraction and optionally churns
+ *  small mappings at a given rate. Writes "ready" to stdout
+ *  once the mappings have been set up.
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+
+#define CHURN_SLOTS		(16)	/* Churn mappings kept alive */
+#define CHURN_PAGES		(16)	/* Pages per churn mapping */
+#define DIRTY_USEC		(10000)	/* Time between dirtying pages */
+
+typedef struct {
+	uint8_t *addr;			/* Start of mapping */
+	size_t pages;			/* Pages in mapping */
+} target_map_t;
+
+/*
+ *  show_usage()
+ *	mini help info
+ */
+static void show_usage(void)
+{
+	(void)printf("Usage: pagemon-target [options]\n"
+		" -m maps   number of mappings, default 1024\n"
+		" -s size   total size in MB, default 256\n"
+		" -r pc     percentage of pages resident, default 50\n"
+		" -w pc     percentage of pages swapped out, default 0\n"
+		" -d pc     percentage of pages re-dirtied, default 10\n"
+		" -c rate   mmap/munmap churn per second, default 0\n");
+}
+
+/*
+ *  get_pc()
+ *	parse a percentage
+ */
+static double get_pc(const char *arg)
+{
+	const double pc = atof(arg);
+
+	if ((pc < 0.0) || (pc > 100.0)) {
+		(void)fprintf(stderr, "Invalid percentage '%s'\n", arg);
+		exit(EXIT_FAILURE);
+	}
+	return pc / 100.0;
+}
+
+int main(int argc, char **argv)
+{
+	const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	size_t nmaps = 1024, size_mb = 256, map_pages, i, j;
+	size_t resident, swapped, dirty;
+	double resident_pc = 0.5, swapped_pc = 0.0, dirty_pc = 0.1;
+	unsigned long churn = 0, churn_count = 0;
+	target_map_t *maps;
+	uint8_t *reserve, *churn_maps[CHURN_SLOTS];
+	struct timespec start;
+
+	for (;;) {
+		int c = getopt(argc, argv, "c:d:hm:r:s:w:");
+
+		if (c == -1)
+			break;
+		switch (c) {
+		case 'c':
+			churn = strtoul(optarg, NULL, 10);
+			break;
+		case 'd':
+			dirty_pc = get_pc(optarg);
+			break;
+		case 'm':
+			nmaps = strtoul(optarg, NULL, 10);
+			break;
+		case 'r':
+			resident_pc = get_pc(optarg);
+			break;
+		case 's':
+			size_mb = strtoul(optarg, NULL, 10);
+			break;
+		case 'w':
+			swapped_pc = get_pc(optarg);
+			break;
+		case 'h':
+			show_usage();
+			exit(EXIT_SUCCESS);
+		default:
+			show_usage();
+			exit(EXIT_FAILURE);
+		}
+	}
+	if ((nmaps == 0) || (size_mb == 0)) {
+		(void)fprintf(stderr, "Number of maps and size must be non-zero\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Die with the benchmark driver */
+	(void)prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+	map_pages = (size_mb * 1024 * 1024) / (nmaps * page_size);
+	if (map_pages == 0)
+		map_pages = 1;
+	resident = (size_t)((double)map_pages * resident_pc);
+	swapped = (size_t)((double)map_pages * swapped_pc);
+	dirty = (size_t)((double)map_pages * dirty_pc);
+
+	maps = calloc(nmaps, sizeof(*maps));
+	if (!maps) {
+		(void)fprintf(stderr, "Out of memory\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/*
+	 *  Reserve the whole region and then map each mapping
+	 *  into it with a one page hole between them so that
+	 *  adjacent mappings cannot be merged into one VMA
+	 */
+	reserve = mmap(NULL, nmaps * (map_pages + 1) * page_size, PROT_NONE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (reserve == MAP_FAILED) {
+		(void)fprintf(stderr, "Cannot reserve address space\n");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < nmaps; i++) {
+		uint8_t *addr = reserve + (i * (map_pages + 1) * page_size);
+
+		maps[i].addr = mmap(addr, map_pages * page_size,
+			PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+		if (maps[i].addr == MAP_FAILED) {
+			(void)fprintf(stderr, "Cannot map mapping %zu\n", i);
+			exit(EXIT_FAILURE);
+		}
+		maps[i].pages = map_pages;
+		(void)munmap(addr + (map_pages * page_size), page_size);
+
+		for (j = 0; j < resident; j++)
+			maps[i].addr[j * page_size] = (uint8_t)j;
+#if defined(MADV_PAGEOUT)
+		if (swapped)
+			(void)madvise(maps[i].addr,
+				((swapped < resident) ? swapped : resident) *
+				page_size, MADV_PAGEOUT);
+#endif
+	}
+	(void)memset(churn_maps, 0, sizeof(churn_maps));
+
+	(void)printf("ready\n");
+	(void)fflush(stdout);
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &start);
+	for (;;) {
+		struct timespec now;
+		double elapsed;
+		unsigned long due;
+
+		/* Re-dirty the pages after the swapped out ones */
+		for (i = 0; i < nmaps; i++) {
+			for (j = swapped; (j < swapped + dirty) && (j < map_pages); j++)
+				maps[i].addr[j * page_size]++;
+		}
+
+		(void)clock_gettime(CLOCK_MONOTONIC, &now);
+		elapsed = (double)(now.tv_sec - start.tv_sec) +
+			  (double)(now.tv_nsec - start.tv_nsec) / 1000000000.0;
+		due = (unsigned long)(elapsed * (double)churn);
+		while (churn_count < due) {
+			const size_t slot = churn_count % CHURN_SLOTS;
+
+			if (churn_maps[slot])
+				(void)munmap(churn_maps[slot], CHURN_PAGES * page_size);
+			churn_maps[slot] = mmap(NULL, CHURN_PAGES * page_size,
+				PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (churn_maps[slot] == MAP_FAILED)
+				churn_maps[slot] = NULL;
+			else
+				churn_maps[slot][0] = 1;
+			churn_count++;
+		}
+		(void)usleep(DIRTY_USEC);
+	}
+	return EXIT_SUCCESS;
+}
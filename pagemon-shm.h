@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) Colin Ian King 2015-2026
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+#ifndef __PAGEMON_SHM_H__
+#define __PAGEMON_SHM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ *  Layout of the page state snapshot that pagemon -M name publishes
+ *  in the POSIX shared memory object /name (/dev/shm/name):
+ *
+ *	offset 0		pagemon_shm_header_t
+ *	maps_offset		nmaps x pagemon_shm_map_t, in address order
+ *	states_offset		(npages + 1) / 2 bytes of page states,
+ *				4 bits per page, the page of index i is
+ *				in byte i / 2, the low nibble for even i
+ *
+ *  Pages are numbered from 0 across all the maps in order, map m
+ *  has pages first .. first + (end - begin) / page_size - 1. All
+ *  fields are in host byte order. Readers should check the magic
+ *  and version and must not assume the offsets, they may move in
+ *  later versions. The segment only grows, size is its current
+ *  size, a reader that mapped less should map it again. The object
+ *  is created with mode 0600, readers run as the same user.
+ *
+ *  The header seq is a seqlock generation count, it is odd while
+ *  pagemon is writing a snapshot. Readers copy what they need
+ *  between pagemon_shm_read_begin() and pagemon_shm_read_retry()
+ *  and go round again if a snapshot was written meanwhile:
+ *
+ *	do {
+ *		seq = pagemon_shm_read_begin(hdr);
+ *		... copy maps and states ...
+ *	} while (pagemon_shm_read_retry(hdr, seq));
+ */
+#define PAGEMON_SHM_MAGIC	(0x4e4f4d50)	/* "PMON" */
+#define PAGEMON_SHM_VERSION	(1)
+#define PAGEMON_SHM_NAME_MAX	(96)		/* Map name, truncated */
+
+/* Page states, as shown in the pagemon page view */
+#define PAGEMON_SHM_NOT_PRESENT	(0)		/* Not in RAM */
+#define PAGEMON_SHM_PRESENT	(1)		/* Present in RAM */
+#define PAGEMON_SHM_SWAPPED	(2)		/* Swapped out */
+#define PAGEMON_SHM_MAPPED	(3)		/* File or shared anon */
+#define PAGEMON_SHM_DIRTY	(4)		/* Soft dirty */
+
+typedef struct {
+	uint32_t magic;			/* PAGEMON_SHM_MAGIC */
+	uint32_t version;		/* PAGEMON_SHM_VERSION */
+	uint64_t seq;			/* Generation, odd while writing */
+	uint64_t size;			/* Segment size in bytes */
+	uint64_t timestamp_ns;		/* CLOCK_REALTIME of the snapshot */
+	int32_t pid;			/* Process ID */
+	uint32_t page_size;		/* Page size in bytes */
+	uint32_t nmaps;			/* Maps in the map table */
+	uint32_t maps_max;		/* Map table capacity */
+	uint64_t npages;		/* Pages in the state array */
+	uint64_t pages_max;		/* State array capacity in pages */
+	uint64_t maps_offset;		/* Offset of the map table */
+	uint64_t states_offset;		/* Offset of the state array */
+	uint64_t restarts;		/* Times a followed process restarted */
+} pagemon_shm_header_t;
+
+typedef struct {
+	uint64_t begin;			/* Start of mapping */
+	uint64_t end;			/* End of mapping */
+	uint64_t first;			/* Index of first page in mapping */
+	char attr[8];			/* Map attributes, e.g. rw-p */
+	char name[PAGEMON_SHM_NAME_MAX];/* Map name, may be empty */
+} pagemon_shm_map_t;
+
+/*
+ *  pagemon_shm_state()
+ *	state of page index of a copied state array
+ */
+static inline uint8_t pagemon_shm_state(const uint8_t *states, const uint64_t index)
+{
+	return (states[index >> 1] >> ((index & 1) << 2)) & 0xf;
+}
+
+/*
+ *  pagemon_shm_read_begin()
+ *	wait for a complete snapshot and return its generation
+ */
+static inline uint64_t pagemon_shm_read_begin(const pagemon_shm_header_t *hdr)
+{
+	uint64_t seq;
+
+	while ((seq = __atomic_load_n(&hdr->seq, __ATOMIC_ACQUIRE)) & 1)
+		;
+	return seq;
+}
+
+/*
+ *  pagemon_shm_read_retry()
+ *	true if the snapshot changed while it was read
+ */
+static inline bool pagemon_shm_read_retry(const pagemon_shm_header_t *hdr, const uint64_t seq)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&hdr->seq, __ATOMIC_RELAXED) != seq;
+}
+
+#endif
@@ -30,19 +30,38 @@
 #include <limits.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/timerfd.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <termios.h>
 #include <ncurses.h>
 #include <dirent.h>
 #include <libgen.h>
 #include <ctype.h>
 #include <setjmp.h>
+#include <regex.h>
+#include <poll.h>
+#include <pthread.h>
 
 #include "perf.h"
+#include "pagemon-shm.h"
 
 #define APP_NAME		"pagemon"
-#define MAX_MAPS		(65536)
+#define MAPS_CHUNK		(1024)	/* Mappings table growth */
+#define MAPS_BUF_MIN		(64 * KB)/* Initial maps text buffer size */
+#define INTERN_MAX		(4 * MB)/* Name arena size before reset */
+#define INTERN_HASH_MIN		(1024)	/* Minimum name hash table size */
+#define PYRAMID_SHIFT		(6)	/* log2 of blocks per pyramid level */
+#define PYRAMID_LEVELS		(5)	/* Pyramid levels above the pages */
+#define PYRAMID_VIEW_BUDGET	(65536)	/* Visible pages sampled per frame */
+#define PYRAMID_BG_BUDGET	(8192)	/* Other pages sampled per frame */
+#define PYRAMID_READ		(4096)	/* Pagemap entries per read */
 
 #define ADDR_OFFSET		(17)	/* Display x offset from address */
 #define HEX_WIDTH		(3)	/* Width of each 2 hex digit value */
@@ -56,13 +75,75 @@
 #define MIN_ZOOM		(1)
 #define MAX_ZOOM		(999)
 
+#if !defined(MADV_COLD)
+#define MADV_COLD		(20)	/* Deactivate pages */
+#endif
+#if !defined(MADV_PAGEOUT)
+#define MADV_PAGEOUT		(21)	/* Reclaim pages */
+#endif
+#if !defined(MPOL_MF_MOVE)
+#define MPOL_MF_MOVE		(1 << 1)	/* Move pages owned by process */
+#endif
+#if !defined(__NR_cachestat)
+#define __NR_cachestat		(451)	/* Linux 6.5, same on most arches */
+#endif
+
 #define MAXIMUM(a, b)		((a) > (b) ? (a) : (b))
 #define MINIMUM(a, b)		((a) < (b) ? (a) : (b))
 
 #define DEFAULT_UDELAY		(15000)	/* Delay between each refresh */
 #define DEFAULT_TICKS		(60)	/* Ticks between dirty page checks */
-#define PROCPATH_MAX		(32)	/* Size of proc pathnames */
+#define PROCPATH_MAX		(PATH_MAX)/* Size of proc or fixture pathnames */
 #define BLINK_MASK		(0x20)	/* Cursor blink counter mask */
+#define NUMA_NODES_MAX		(16)	/* NUMA nodes told apart */
+#define NUMA_NODE_NONE		(0xff)	/* Node unknown or not in RAM */
+#define NUMA_BATCH		(1024)	/* Pages per move_pages() query */
+#define NUMA_VIEW_BUDGET	(16384)	/* Visible pages queried per frame */
+#define NUMA_BG_BUDGET		(4096)	/* Other pages queried per frame */
+#define NUMA_CELL_SAMPLES	(64)	/* Pages looked at per cell */
+#define NUMA_MAPS_NS		(1000000000ULL)	/* Time between numa_maps reads */
+#define MIGRATE_BATCH		(512)	/* Pages per move_pages() migration */
+#define RECLAIM_IOV		(512)	/* iovecs per process_madvise() */
+#define RECLAIM_SCAN_NS		(250000000ULL)	/* Time between refault scans */
+#define PRESSURE_SAMPLE_NS	(1000000000ULL)	/* Time between cgroup samples */
+#define PRESSURE_THRESHOLD	(10.0)	/* PSI some avg10 % that is an event */
+#define PRESSURE_EVENTS		(8)	/* Pressure events kept */
+#define EXPORT_NS		(1000000000ULL)	/* Time between metrics snapshots */
+#define EXPORT_REQ_MS		(100)	/* Wait for a scrape request */
+#define EXPORT_SEND_SEC		(1)	/* Give up on a stalled scrape */
+#define SHM_PUBLISH_NS		(250000000ULL)	/* Time between shared snapshots */
+#define SHM_MAPS_MIN		(256)	/* Initial shared map table size */
+#define SHM_PAGES_MIN		(65536)	/* Initial shared page state size */
+#define SWAPMAP_NS		(5000000000ULL)	/* Time between swap layout scans */
+#define SWAPMAP_DEVS_MAX	(32)	/* Swap types told apart */
+#define SWAPMAP_TYPE_SHIFT	(58)	/* Swap type position in a slot */
+#define SWAP_IO_SSD_US		(100)	/* Guessed SSD swap-in I/O time */
+#define SWAP_IO_HDD_US		(8000)	/* Guessed rotating disk I/O time */
+#define SWAP_IO_ZRAM_US		(10)	/* Guessed zram decompress time */
+#define FCACHE_NS		(1000000000ULL)	/* Time between file cache queries */
+#define FCACHE_HASH		(256)	/* File cache hash table size, power of 2 */
+#define FCACHE_NONE		(0xffffffff)	/* End of a file cache hash chain */
+#define FCACHE_FILES_MAX	(4096)	/* Files cached before a reset */
+#define FCACHE_PAGES_MAX	(1ULL << 22)	/* Largest file mincore() is used on */
+#define FCACHE_CELL_SAMPLES	(64)	/* Pages looked at per cell */
+#define PHYSMAP_NS		(5000000000ULL)	/* Time between PFN scans */
+#define PHYSMAP_ZONES_MAX	(16)	/* Memory zones told apart */
+#define PHYSMAP_RADIX_BITS	(11)	/* PFN bits sorted per radix pass */
+#define PHYSMAP_THP_SIZE	(2 * MB)/* PMD sized transparent huge page */
+#define PHYSMAP_CELL_SAMPLES	(64)	/* Pages looked at per cell */
+#define DIRTY_INTERVAL_MS	(1000)	/* Default dirty rate interval */
+#define DIRTY_LINK_MBS		(1250)	/* Default link bandwidth, 10 Gbit/s */
+#define DIRTY_DOWNTIME_MS	(300)	/* Pre-copy stop and copy target */
+#define DIRTY_ROUNDS_MAX	(30)	/* Pre-copy rounds before giving up */
+
+#define ANSI_CELL_MAX		(40)	/* Worst case output bytes per cell */
+#define ANSI_ROW_MAX		(16)	/* Cursor move bytes per row */
+#define ANSI_GAP_MAX		(6)	/* Unchanged cells rewritten, not skipped */
+#define ANSI_RUN_MIN		(8)	/* Same cells erased or repeated, not written */
+#define ANSI_BLOCK_NS		(1000000ULL)/* A write this long was throttled */
+#define ANSI_RATE_MAX		(64.0 * 1024.0 * 1024.0)/* Rate seen as unthrottled */
+#define PROC_MATCH_MAX		(64)	/* Max processes matching a name */
+#define FOLLOW_USEC		(5000)	/* Delay between restart searches */
 
 /*
  *  Memory size scaling
@@ -95,9 +176,64 @@
 #define PAGE_FILE_SHARED_ANON	(1ULL << 61)
 #define PAGE_SWAPPED		(1ULL << 62)
 #define PAGE_PRESENT		(1ULL << 63)
+#define PAGE_PFN_MASK		(0x007fffffffffffffULL)	/* PFN or swap, bits 0-54 */
 
 #define OPT_FLAG_READ_ALL_PAGES	(0x00000001)
 #define OPT_FLAG_PID		(0x00000002)
+#define OPT_FLAG_PROF_DUMP	(0x00000004)
+#define OPT_FLAG_CAPTURE	(0x00000008)
+#define OPT_FLAG_FIXTURE	(0x00000010)
+#define OPT_FLAG_CAPTURE_STOP	(0x00000020)
+
+/*
+ *  Self profiling stages
+ */
+enum {
+	PROF_OTHER = 0,			/* Not timed */
+	PROF_MAPS,			/* read_maps() */
+	PROF_PAGEMAP,			/* pagemap reads in show_pages() */
+	PROF_MEMORY,			/* show_memory() */
+	PROF_VM,			/* vm_sample() */
+	PROF_NUMA,			/* move_pages() node queries */
+	PROF_CLEAR_REFS,		/* clear_refs write */
+	PROF_REFRESH,			/* curses refresh */
+	PROF_MAX
+};
+
+#define PROF_BUCKETS		(24)	/* log2 microsecond histogram buckets */
+
+/*
+ *  Sampling tasks, each runs on its own wall clock period
+ */
+enum {
+	SCHED_MAPS = 0,			/* read_maps() */
+	SCHED_PAGEMAP,			/* pagemap page state sampling */
+	SCHED_CLEAR_REFS,		/* soft dirty reset */
+	SCHED_VM,			/* vm_sample() */
+	SCHED_PERF,			/* perf counter rates */
+	SCHED_MAX
+};
+
+#define SCHED_MAPS_NS		(1000000000ULL)/* Default time between maps reads */
+#define SCHED_PERF_NS		(1000000000ULL)/* Default time between perf reads */
+
+#define VM_SAMPLES		(300)	/* VM stats samples kept */
+#define VM_SAMPLE_NS		(1000000000ULL)/* Default time between VM samples */
+#define VM_FIELDS_MAX		(32)	/* Max Vm fields shown from status */
+#define SPARK_WIDTH		(22)	/* Sparkline width */
+
+/*
+ *  VM stats time series
+ */
+enum {
+	VM_RSS = 0,			/* VmRSS */
+	VM_SWAP,			/* VmSwap */
+	VM_ANON,			/* RssAnon */
+	VM_FILE,			/* RssFile */
+	VM_MINFLT,			/* Minor faults per second */
+	VM_MAJFLT,			/* Major faults per second */
+	VM_SERIES
+};
 
 enum {
 	WHITE_RED = 1,
@@ -110,6 +246,73 @@ enum {
 	BLACK_WHITE,
 	BLACK_BLACK,
 	BLUE_WHITE,
+	WHITE_MAGENTA,
+};
+
+/*
+ *  Key line prompts for a command argument
+ */
+enum {
+	PROMPT_NONE = 0,		/* No prompt */
+	PROMPT_MIGRATE,			/* Node to migrate to */
+	PROMPT_RECLAIM,			/* Advice to reclaim with */
+};
+
+/*
+ *  Page states shown in the page and address views,
+ *  in increasing order of precedence. These are the
+ *  PAGEMON_SHM_* states of the shared snapshot
+ */
+enum {
+	PAGE_STATE_NOT_PRESENT = 0,	/* Not in RAM */
+	PAGE_STATE_PRESENT,		/* Present in RAM */
+	PAGE_STATE_SWAPPED,		/* Swapped out */
+	PAGE_STATE_MAPPED,		/* File or shared anon */
+	PAGE_STATE_DIRTY,		/* Soft dirty */
+	PAGE_STATE_MAX
+};
+
+/*
+ *  cgroup memory.stat counters sampled
+ */
+enum {
+	PSTAT_REFAULT_ANON = 0,		/* workingset_refault_anon */
+	PSTAT_REFAULT_FILE,		/* workingset_refault_file */
+	PSTAT_PGSCAN,			/* pgscan */
+	PSTAT_PGSTEAL,			/* pgsteal */
+	PSTAT_MAX
+};
+
+/*
+ *  Page state transitions seen by the pyramid sampling
+ */
+enum {
+	CHANGE_SWAP_OUT = 0,		/* In RAM to swapped */
+	CHANGE_SWAP_IN,			/* Swapped to in RAM */
+	CHANGE_DROPPED,			/* In RAM to not present */
+	CHANGE_FAULTED,			/* Not present to in RAM */
+	CHANGE_MAX
+};
+
+/*
+ *  Kind of device a swap area is on
+ */
+enum {
+	SWAP_DEV_SSD = 0,		/* Non-rotational or unknown */
+	SWAP_DEV_HDD,			/* Rotating disk */
+	SWAP_DEV_ZRAM,			/* Compressed RAM */
+};
+
+/*
+ *  Length class of the physically contiguous run a page is in
+ */
+enum {
+	PHYS_RUN_NONE = 0,		/* Not in RAM or PFN unknown */
+	PHYS_RUN_SINGLE,		/* No contiguous neighbours */
+	PHYS_RUN_SHORT,			/* Under 16 pages */
+	PHYS_RUN_LONG,			/* Under a huge page */
+	PHYS_RUN_HUGE,			/* Huge page sized or longer */
+	PHYS_RUN_MAX
 };
 
 /*
@@ -123,16 +326,40 @@ typedef uint64_t pagemap_t;		/* PTE page map bits */
 typedef uint64_t checksum_t;		/* Pagemap checksum */
 
 /*
- *  Memory map info, represents 1 or more pages
+ *  Memory map info, represents 1 or more pages. Just
+ *  the frequently used fields, the rarely used ones
+ *  are kept in a parallel map_info_t table
  */
 typedef struct {
 	addr_t begin;			/* Start of mapping */
 	addr_t end;			/* End of mapping */
+	index_t first;			/* Index of first page in mapping */
 	char attr[5];			/* Map attributes */
-	char dev[6];			/* Map device, if any */
-	char name[NAME_MAX + 1];	/* Name of mapping */
 } map_t;
 
+/*
+ *  Rarely used memory map info
+ */
+typedef struct {
+	uint32_t name;			/* Name offset in name arena */
+	char dev[8];			/* Map device, if any */
+	uint64_t offset;		/* Offset into the file */
+	uint64_t inode;			/* File inode, 0 if none */
+} map_info_t;
+
+/*
+ *  Interned strings, each unique string is stored
+ *  once in the arena, offset 0 is the empty string
+ */
+typedef struct {
+	char *buf;			/* String arena */
+	size_t size;			/* Arena size */
+	size_t used;			/* Arena bytes used */
+	uint32_t *hash;			/* Hash table of arena offsets */
+	uint32_t hash_size;		/* Hash table size, power of 2 */
+	uint32_t count;			/* Number of strings */
+} intern_t;
+
 /*
  *  Page info, 1 per page with map reference
  *  to the memory map it belongs to
@@ -143,19 +370,81 @@ typedef struct {
 	index_t index;			/* Index into map */
 } page_t;
 
+/*
+ *  Multi-resolution summary of page states. Level 0
+ *  is the state of each page, each level above holds
+ *  the state counts of blocks of 64 times as many
+ *  pages as the level below, so any range of pages
+ *  can be summarised in a few steps
+ */
+typedef struct {
+	uint8_t *states;		/* State of each page */
+	uint8_t *resident;		/* page_residency() of each page */
+	uint32_t (*counts[PYRAMID_LEVELS])[PAGE_STATE_MAX];
+					/* Per block state counts */
+	uint32_t levels;		/* Levels above level 0 */
+	addr_t npages;			/* Pages summarised */
+	index_t next;			/* Next page to sample */
+	index_t view_next;		/* Next visible page to sample */
+	uint64_t changes[PAGE_STATE_MAX][PAGE_STATE_MAX];
+					/* Residency transitions, old by new */
+} pyramid_t;
+
 /*
  *  General memory mapping info, containing
  *  a fix set of memory maps, and pointer
  *  to an array of per page info.
  */
 typedef struct {
-	map_t maps[MAX_MAPS];		/* Mappings */
+	map_t *maps;			/* Mappings */
+	map_info_t *map_info;		/* Rarely used mapping info */
 	uint32_t nmaps;			/* Number of mappings */
+	uint32_t maps_size;		/* Size of mappings tables */
+	intern_t names;			/* Mapping names */
+	char *buf;			/* Maps text buffer */
+	size_t buf_size;		/* Maps text buffer size */
 	page_t *pages;			/* Pages */
+	pyramid_t pyramid;		/* Page state summary */
 	addr_t npages;			/* Number of pages */
 	addr_t last_addr;		/* Last address */
 } mem_info_t;
 
+/*
+ *  How a page state is shown
+ */
+typedef struct {
+	char ch;			/* Character shown */
+	uint8_t pair;			/* Colour pair */
+} page_state_t;
+
+/*
+ *  Page state counts of a range of pages
+ */
+typedef struct {
+	uint64_t n[PAGE_STATE_MAX];	/* Pages in each state */
+	uint64_t faults;		/* Sampled faults */
+	uint64_t nodes[NUMA_NODES_MAX];	/* Pages in RAM on each NUMA node */
+	uint64_t cached;		/* Sampled pages not in RAM but cached */
+	uint64_t runs[PHYS_RUN_MAX];	/* Sampled pages in each run class */
+} page_counts_t;
+
+/*
+ *  NUMA node of each page, queried with move_pages(),
+ *  and the numa_maps node counts of the Tab view map
+ */
+typedef struct {
+	uint8_t *nodes;			/* Node of each page */
+	addr_t npages;			/* Pages in nodes */
+	index_t next;			/* Next page to query */
+	index_t view_next;		/* Next visible page to query */
+	char *buf;			/* numa_maps text buffer */
+	size_t buf_size;		/* numa_maps text buffer size */
+	addr_t maps_begin;		/* Map of the numa_maps counts */
+	uint64_t maps_ns;		/* Time numa_maps was read */
+	uint64_t maps_nodes[NUMA_NODES_MAX];/* numa_maps pages per node */
+	bool maps_valid;		/* Map was found in numa_maps */
+} numa_t;
+
 /*
  *  Cursor context, we have one each for the
  *  memory map and page contents views
@@ -170,6 +459,460 @@ typedef struct {
 	int32_t ymax;			/* Height */
 } position_t;
 
+/*
+ *  Self profiling stats, one per stage
+ */
+typedef struct {
+	uint64_t count;			/* Times stage was run */
+	uint64_t total_ns;		/* Total time in stage */
+	uint64_t max_ns;		/* Longest time in stage */
+	uint64_t syscalls;		/* System calls made */
+	uint64_t bytes;			/* Bytes read */
+	uint64_t hist[PROF_BUCKETS];	/* Latency histogram */
+} prof_stat_t;
+
+/*
+ *  Sampling task schedule and achieved intervals
+ */
+typedef struct {
+	uint64_t period_ns;		/* Requested period */
+	uint64_t next_ns;		/* Next deadline, 0 to run now */
+	uint64_t last_ns;		/* Time of last run */
+	uint64_t interval_ns;		/* Last achieved interval */
+	uint64_t interval_max_ns;	/* Longest achieved interval */
+	uint64_t interval_total_ns;	/* Sum of achieved intervals */
+	uint64_t late_total_ns;		/* Sum of time run after deadline */
+	uint64_t runs;			/* Times task was run */
+	uint64_t missed;		/* Deadlines skipped */
+} sched_task_t;
+
+/*
+ *  Self profiling context, one per timed section
+ */
+typedef struct {
+	uint64_t start_ns;		/* Start time */
+	int prev_stage;			/* Stage being interrupted */
+} prof_t;
+
+/*
+ *  NUMA migration of a selection, run on a worker
+ *  thread, the counters are updated atomically
+ */
+typedef struct {
+	pthread_t thread;		/* Worker thread */
+	addr_t *addrs;			/* Addresses of pages to move */
+	uint64_t npages;		/* Pages to move */
+	uint64_t done;			/* Pages attempted */
+	uint64_t moved;			/* Pages now on the node */
+	uint64_t start_ns;		/* Start time */
+	uint64_t end_ns;		/* End time, 0 while running */
+	pid_t pid;			/* Process */
+	int node;			/* Node to move to */
+	bool started;			/* Worker created */
+	bool stop;			/* Ask the worker to stop */
+} migrate_t;
+
+/*
+ *  Reclaim experiment on a selection, the pages in RAM
+ *  before the advice are tracked to see which of them
+ *  leave RAM and how soon they are faulted back in
+ */
+typedef struct {
+	addr_t *addrs;			/* Pages in RAM before the advice */
+	uint8_t *states;		/* Page residency of last scan */
+	uint8_t *left;			/* Page left RAM after the advice */
+	uint64_t selected;		/* Pages selected */
+	uint64_t before;		/* Pages in RAM before */
+	uint64_t resident;		/* Pages still in RAM after */
+	uint64_t swapped;		/* Pages swapped out */
+	uint64_t refaulted;		/* Pages faulted back in */
+	uint64_t advise_ns;		/* Time taken by the advice */
+	uint64_t start_ns;		/* Time the advice completed */
+	uint64_t half_ns;		/* Time to refault half, 0 if not yet */
+	uint64_t scan_ns;		/* Time of last scan */
+	uint64_t faults;		/* perf user faults at start */
+	uint64_t majflt;		/* Major faults at start */
+	uint64_t minflt;		/* Minor faults at start */
+	int advice;			/* MADV_COLD or MADV_PAGEOUT */
+	int err;			/* errno of process_madvise, or 0 */
+	bool active;			/* Report is shown */
+} reclaim_t;
+
+/*
+ *  Page state transitions while the cgroup
+ *  memory pressure was over the threshold
+ */
+typedef struct {
+	time_t when;			/* Time of the sample */
+	double some;			/* PSI some avg10, % */
+	double full;			/* PSI full avg10, % */
+	uint64_t changes[CHANGE_MAX];	/* Transitions since last sample */
+} pressure_event_t;
+
+/*
+ *  cgroup v2 memory pressure sampler, the cgroup files
+ *  are kept open and re-read from the start each sample
+ */
+typedef struct {
+	char path[PROCPATH_MAX];	/* cgroup directory */
+	char buf[8192];			/* File contents */
+	int fd_pressure;		/* memory.pressure fd */
+	int fd_stat;			/* memory.stat fd */
+	int fd_current;			/* memory.current fd */
+	int fd_max;			/* memory.max fd */
+	bool opened;			/* Have the files been opened? */
+	bool valid;			/* Was a cgroup v2 path found? */
+	bool have_psi;			/* memory.pressure was read */
+	double some_avg10;		/* PSI some avg10, % */
+	double full_avg10;		/* PSI full avg10, % */
+	double some_rate;		/* Some stall, ms per second */
+	double full_rate;		/* Full stall, ms per second */
+	uint64_t some_total;		/* Some stall total, us */
+	uint64_t full_total;		/* Full stall total, us */
+	uint64_t current;		/* memory.current, bytes */
+	uint64_t max;			/* memory.max, bytes, 0 if unlimited */
+	uint64_t stat[PSTAT_MAX];	/* memory.stat counters */
+	double stat_rate[PSTAT_MAX];	/* memory.stat counters per second */
+	uint64_t changes[CHANGE_MAX];	/* Page state transitions */
+	double change_rate[CHANGE_MAX];	/* Transitions per second */
+	uint64_t prev_stat[PSTAT_MAX];	/* Previous memory.stat counters */
+	uint64_t prev_changes[CHANGE_MAX];/* Previous transitions */
+	uint64_t prev_some;		/* Previous some stall total */
+	uint64_t prev_full;		/* Previous full stall total */
+	uint64_t sample_ns;		/* Time of last sample */
+	pressure_event_t events[PRESSURE_EVENTS];/* Ring buffer of events */
+	uint32_t head;			/* Next event to write */
+	uint32_t count;			/* Events in ring buffer */
+} pressure_t;
+
+/*
+ *  Prometheus metrics served on a Unix socket, a worker
+ *  thread answers scrapes from the last snapshot so a
+ *  scrape never waits for the process to be sampled
+ */
+typedef struct {
+	const char *path;		/* Unix socket path */
+	char *text;			/* Last snapshot */
+	size_t len;			/* Last snapshot length */
+	char *serve;			/* Worker copy of the snapshot */
+	size_t serve_size;		/* Worker copy size */
+	uint64_t scrapes;		/* Scrapes answered */
+	uint64_t snapshot_ns;		/* Time of last snapshot */
+	pthread_t thread;		/* Worker thread */
+	pthread_mutex_t lock;		/* Guards text, len and scrapes */
+	int fd;				/* Listening socket */
+	bool started;			/* Worker created */
+	bool daemon;			/* Serve only, no curses */
+} export_t;
+
+/*
+ *  Page state snapshots published in a POSIX shared
+ *  memory object, the layout is in pagemon-shm.h
+ */
+typedef struct {
+	const char *name;		/* Shared memory object name */
+	char path[NAME_MAX];		/* Name with a leading / */
+	pagemon_shm_header_t *hdr;	/* Mapped object */
+	size_t size;			/* Mapped size */
+	uint64_t maps_offset;		/* Offset of the map table */
+	uint64_t states_offset;		/* Offset of the state array */
+	uint64_t pages_max;		/* State array capacity in pages */
+	uint64_t seq;			/* Seqlock generation count */
+	uint32_t maps_max;		/* Map table capacity */
+	uint64_t publish_ns;		/* Time of last snapshot */
+	int fd;				/* Shared memory object fd */
+	bool started;			/* Object created */
+} shm_t;
+
+/*
+ *  Swap area, one per swap type
+ */
+typedef struct {
+	char name[32];			/* Device or file basename */
+	uint64_t pages;			/* Pages of the process on it */
+	uint8_t kind;			/* SWAP_DEV_* */
+} swap_dev_t;
+
+/*
+ *  Swap layout of the swapped pages of a map
+ */
+typedef struct {
+	addr_t begin;			/* Start of mapping */
+	char name[24];			/* Map basename, truncated */
+	uint64_t pages;			/* Pages in swap */
+	uint64_t runs;			/* Runs of consecutive swap slots */
+	uint64_t max_run;		/* Longest run */
+	uint64_t ios;			/* Estimated swap-in I/Os */
+	uint64_t est_us;		/* Estimated swap-in time */
+	uint32_t types;			/* Bitmap of swap types used */
+} swap_map_stat_t;
+
+/*
+ *  Swap layout analysis of all the swapped pages
+ */
+typedef struct {
+	uint64_t *slots;		/* Swap slots of a map, type and offset */
+	size_t slots_size;		/* Swap slots allocated */
+	swap_map_stat_t *stats;		/* Maps with pages in swap */
+	size_t nstats;			/* Maps in stats */
+	size_t stats_size;		/* Map stats allocated */
+	swap_dev_t devs[SWAPMAP_DEVS_MAX];/* Swap areas by type */
+	uint32_t ndevs;			/* Swap areas */
+	uint32_t page_cluster;		/* log2 pages read per swap-in */
+	uint64_t pages;			/* Pages in swap */
+	uint64_t scan_ns;		/* Time of last scan */
+	uint64_t scan_time_ns;		/* Time the last scan took */
+} swapmap_t;
+
+/*
+ *  Memory zone, from /proc/zoneinfo
+ */
+typedef struct {
+	char name[12];			/* Zone name */
+	uint32_t node;			/* NUMA node */
+	uint64_t start;			/* First PFN */
+	uint64_t end;			/* Last PFN + 1 */
+	uint64_t pages;			/* Pages of the process in it */
+} phys_zone_t;
+
+/*
+ *  Physical layout of the pages in RAM of a map
+ */
+typedef struct {
+	addr_t begin;			/* Start of mapping */
+	uint64_t pages;			/* Pages in RAM with a known PFN */
+	uint64_t runs;			/* Runs of consecutive PFNs */
+	uint64_t max_run;		/* Longest run */
+	uint64_t thp_mapped;		/* Aligned huge page sized runs */
+	uint64_t thp_eligible;		/* Aligned ranges in RAM but not huge */
+	uint64_t zones[PHYSMAP_ZONES_MAX];/* Pages in each zone */
+} phys_map_stat_t;
+
+/*
+ *  Physical contiguity and fragmentation analysis
+ *  of the PFNs of all the pages in RAM
+ */
+typedef struct {
+	uint64_t *pfns;			/* PFNs of a map, sorted */
+	uint64_t *tmp;			/* Radix sort buffer */
+	size_t pfns_size;		/* PFNs allocated */
+	uint8_t *runs;			/* Run class of each page, PHYS_RUN_* */
+	addr_t runs_npages;		/* Pages in runs */
+	phys_map_stat_t *stats;		/* Maps with pages in RAM, in map order */
+	size_t nstats;			/* Maps in stats */
+	size_t stats_size;		/* Map stats allocated */
+	phys_zone_t zones[PHYSMAP_ZONES_MAX];/* Zones in PFN order */
+	uint32_t nzones;		/* Zones */
+	uint64_t pages;			/* Pages in RAM with a known PFN */
+	uint64_t no_pfn;		/* Pages in RAM with PFN hidden */
+	uint64_t scan_ns;		/* Time of last scan */
+	uint64_t scan_time_ns;		/* Time the last scan took */
+} physmap_t;
+
+/*
+ *  cachestat(2) range and page cache counts
+ */
+typedef struct {
+	uint64_t off;			/* Offset of range */
+	uint64_t len;			/* Length of range, 0 to end of file */
+} cachestat_range_t;
+
+typedef struct {
+	uint64_t nr_cache;		/* Pages in the page cache */
+	uint64_t nr_dirty;		/* Dirty pages */
+	uint64_t nr_writeback;		/* Pages under writeback */
+	uint64_t nr_evicted;		/* Pages evicted */
+	uint64_t nr_recently_evicted;	/* Pages evicted while in the workingset */
+} cachestat_t;
+
+/*
+ *  Page cache state of a mapped file
+ */
+typedef struct {
+	char dev[8];			/* File device */
+	uint64_t inode;			/* File inode */
+	uint8_t *resident;		/* mincore() vector of the file */
+	uint64_t npages;		/* Pages in resident, 0 if none */
+	uint64_t query_ns;		/* Time of last query */
+	cachestat_t stat;		/* cachestat() of the whole file */
+	uint32_t next;			/* Next file in hash chain */
+	bool have_stat;			/* cachestat() worked */
+	bool valid;			/* File could be queried */
+} fcache_file_t;
+
+/*
+ *  Page cache state of the mapped files, one per inode
+ *  however many maps the file has, and the cachestat()
+ *  of the file range of the Tab view map
+ */
+typedef struct {
+	fcache_file_t *files;		/* Files queried */
+	uint32_t count;			/* Files in files */
+	uint32_t size;			/* Files allocated */
+	uint32_t hash[FCACHE_HASH];	/* Hash chain heads, by dev and inode */
+	addr_t range_begin;		/* Map of range_stat */
+	uint64_t range_ns;		/* Time range_stat was queried */
+	cachestat_t range_stat;		/* cachestat() of the map range */
+	bool range_valid;		/* range_stat is valid */
+} fcache_t;
+
+/*
+ *  Pages dirtied in the last interval of a map
+ */
+typedef struct {
+	addr_t begin;			/* Start of mapping */
+	char name[24];			/* Map basename, truncated */
+	uint64_t resident;		/* Pages in RAM */
+	uint64_t dirty;			/* Pages dirtied */
+} dirty_map_t;
+
+/*
+ *  Dirty rate tracking, soft dirty is cleared on a
+ *  timerfd period and the pages dirtied in each
+ *  interval are counted map by map
+ */
+typedef struct {
+	dirty_map_t *maps;		/* Maps with dirtied pages, most first */
+	size_t nmaps;			/* Maps in maps */
+	size_t maps_size;		/* Maps allocated */
+	const char *log_path;		/* CSV log of the series, or NULL */
+	FILE *log;			/* CSV log */
+	uint64_t interval_ms;		/* Timer period */
+	uint64_t reset_ns;		/* Time soft dirty was last cleared */
+	uint64_t actual_ns;		/* Length of the last interval */
+	uint64_t pages;			/* Pages dirtied in the last interval */
+	uint64_t resident;		/* Pages in RAM, the memory to pre-copy */
+	uint64_t intervals;		/* Intervals measured */
+	uint64_t missed;		/* Timer expirations missed */
+	double link_mbs;		/* Link bandwidth, MB per second */
+	int timer_fd;			/* Interval timer */
+	bool started;			/* Timer is running */
+} dirty_t;
+
+/*
+ *  Direct ANSI output, curses draws into g.mainwin as
+ *  usual but only the cells that changed since the last
+ *  frame are written to the terminal, paced to the rate
+ *  the terminal has been seen to take them
+ */
+typedef struct {
+	chtype *cells;			/* Cells as last written, lines x cols */
+	chtype *line;			/* Row read from g.mainwin */
+	char *buf;			/* Frame output */
+	size_t buf_size;		/* Size of buf */
+	size_t len;			/* Bytes of frame in buf */
+	size_t max_bytes;		/* Output cap per frame */
+	FILE *null;			/* curses output, discarded */
+	SCREEN *screen;			/* curses screen reading the keys */
+	struct termios saved;		/* Terminal modes to restore */
+	volatile sig_atomic_t redraw;	/* Resumed, write the whole screen */
+	int fd;				/* Terminal */
+	int lines;			/* Rows in cells */
+	int cols;			/* Columns in cells */
+	int row;			/* Row the next frame starts at */
+	int cur_y;			/* Terminal cursor row, -1 unknown */
+	int cur_x;			/* Terminal cursor column */
+	chtype attr;			/* Terminal attributes, ~0 unknown */
+	double rate;			/* Terminal throughput, bytes/sec, 0 unthrottled */
+	uint64_t next_ns;		/* Earliest time of next frame */
+	uint64_t first_ns;		/* Time of first frame */
+	uint64_t last_ns;		/* Time of last frame */
+	uint64_t frames;		/* Frames written */
+	uint64_t bytes;			/* Bytes written */
+	uint64_t last_bytes;		/* Bytes of last frame */
+	uint64_t skipped;		/* Frames held back for the terminal */
+	uint64_t capped;		/* Frames cut short at max_bytes */
+	bool enabled;			/* Use direct ANSI output */
+	bool started;			/* Terminal set up */
+	bool bce;			/* Erase fills with the background colour */
+	bool rep;			/* Can repeat the last character */
+} ansi_t;
+
+/*
+ *  Pre-copy live migration estimate
+ */
+typedef struct {
+	bool converges;			/* Dirtied memory shrinks to the target */
+	uint32_t rounds;		/* Copy rounds before stop and copy */
+	double total_s;			/* Total migration time */
+	double downtime_ms;		/* Stop and copy time */
+} precopy_t;
+
+/*
+ *  Process name or command line regex to match
+ */
+typedef struct {
+	char pattern[256];		/* Name or regex */
+	regex_t regex;			/* Compiled regex */
+	bool is_regex;			/* Match the command line by regex */
+	bool compiled;			/* Is regex compiled */
+} proc_match_t;
+
+/*
+ *  Process matching a name or regex
+ */
+typedef struct {
+	pid_t pid;			/* Process ID */
+	uint64_t start;			/* Start time in clock ticks */
+	char cmdline[64];		/* Command line, truncated */
+} proc_cand_t;
+
+/*
+ *  VM stats sample, one value per series
+ */
+typedef struct {
+	double v[VM_SERIES];		/* Series values */
+} vm_sample_t;
+
+/*
+ *  Vm field from status, the name points
+ *  into the status buffer
+ */
+typedef struct {
+	const char *name;		/* Name without the Vm prefix */
+	uint32_t len;			/* Name length */
+	uint64_t value;			/* Value in kB */
+} vm_field_t;
+
+/*
+ *  VM stats sampler, the /proc files are read with
+ *  one pread each into the buffers and parsed in place
+ */
+typedef struct {
+	char status[8192];		/* /proc/$PID/status contents */
+	char stat[1024];		/* /proc/$PID/stat contents */
+	char io[1024];			/* /proc/$PID/io contents */
+	char oom[32];			/* /proc/$PID/oom_score contents */
+	int fd_status;			/* /proc/$PID/status fd */
+	int fd_stat;			/* /proc/$PID/stat fd */
+	int fd_io;			/* /proc/$PID/io fd */
+	int fd_oom;			/* /proc/$PID/oom_score fd */
+	bool opened;			/* Have the files been opened? */
+	bool have_stat;			/* stat was read */
+	bool have_io;			/* io was read */
+	bool have_oom;			/* oom_score was read */
+	vm_field_t fields[VM_FIELDS_MAX];/* Vm fields from status */
+	uint32_t nfields;		/* Number of Vm fields */
+	const char *state;		/* Process state, in status */
+	uint32_t state_len;		/* Process state length */
+	uint64_t rss;			/* VmRSS, kB */
+	uint64_t swap;			/* VmSwap, kB */
+	uint64_t anon;			/* RssAnon, kB */
+	uint64_t file;			/* RssFile, kB */
+	uint64_t minflt;		/* Minor page faults */
+	uint64_t majflt;		/* Major page faults */
+	uint64_t read_bytes;		/* Bytes read from storage */
+	uint64_t write_bytes;		/* Bytes written to storage */
+	uint64_t oom_score;		/* OOM score */
+	uint64_t prev[4];		/* Previous minflt, majflt, read, write */
+	double read_rate;		/* Bytes read per second */
+	double write_rate;		/* Bytes written per second */
+	uint64_t sample_ns;		/* Time of last sample */
+	vm_sample_t samples[VM_SAMPLES];/* Ring buffer of samples */
+	uint32_t head;			/* Next sample to write */
+	uint32_t count;			/* Samples in ring buffer */
+} vm_t;
+
 /*
  *  Globals, stashed in a global struct
  */
@@ -180,10 +923,36 @@ typedef struct {
 	checksum_t checksum;		/* Pagemap check sum */
 	checksum_t prev_checksum;	/* Previous checksum */
 	uint32_t page_size;		/* Page size in bytes */
+	uint32_t va_shift;		/* log2 bytes per address view cell */
+	uint64_t va_row;		/* First row in address view */
 	pid_t pid;			/* Process ID */
+	int pidfd;			/* pidfd of process, or -1 */
+	uint32_t restarts;		/* Times a followed process restarted */
+	proc_match_t match;		/* Process name or regex to follow */
 	mem_info_t mem_info;		/* Mapping and page info */
+	prof_stat_t prof[PROF_MAX];	/* Self profiling stats */
+	sched_task_t sched[SCHED_MAX];	/* Sampling task schedule */
+	vm_t vm;			/* VM stats sampler */
+	numa_t numa;			/* NUMA nodes of pages */
+	migrate_t migrate;		/* NUMA migration of selection */
+	reclaim_t reclaim;		/* Reclaim experiment on selection */
+	pressure_t pressure;		/* cgroup memory pressure */
+	export_t export;		/* Prometheus metrics */
+	shm_t shm;			/* Shared page state snapshots */
+	swapmap_t swapmap;		/* Swap layout analysis */
+	fcache_t fcache;		/* Page cache of mapped files */
+	physmap_t physmap;		/* Physical contiguity analysis */
+	dirty_t dirty;			/* Dirty rate tracking */
+	ansi_t ansi;			/* Direct ANSI output */
+	addr_t sel_begin;		/* Selection start page address */
+	addr_t sel_end;			/* Selection end page address */
+	int prof_stage;			/* Current self profiling stage */
 #if defined(PERF_ENABLED)
 	perf_t perf;			/* Perf context */
+	perf_t perf_hw;			/* Perf TLB and cache context */
+	perf_sample_t sample;		/* Page fault sampling context */
+	uint32_t *faults;		/* Sampled faults per page */
+	uint32_t faults_max;		/* Hottest page fault count */
 #endif
 	bool curses_started;		/* Are we in curses mode? */
 	bool tab_view;			/* Page pop-up info */
@@ -192,10 +961,25 @@ typedef struct {
 	bool resized;			/* SIGWINCH occurred */
 	bool terminate;			/* SIGSEGV termination */
 	bool auto_zoom;			/* Automatic zoom */
+	bool offline;			/* Reading a captured fixture */
+	bool capture_stopped;		/* Target stopped by capture() */
+	bool prof_view;			/* Self profiling stats */
+	bool va_view;			/* Virtual address space view */
+	bool numa_view;			/* NUMA node view */
+	bool pressure_view;		/* cgroup memory pressure */
+	bool swap_view;			/* Swap layout analysis */
+	bool cache_view;		/* Page cache of unmapped file pages */
+	bool phys_view;			/* Physical contiguity of pages */
+	bool dirty_view;		/* Dirty rate tracking */
+	bool selection;			/* Pages are selected */
+	bool selecting;			/* Selection end follows cursor */
+	bool follow;			/* Reattach when the process restarts */
 #if defined(PERF_ENABLED)
 	bool perf_view;			/* Perf statistics */
+	bool fault_view;		/* Page fault sampling */
 #endif
 	uint8_t view;			/* Default page or memory view */
+	uint8_t prompt;			/* Key line prompt, PROMPT_* */
 	uint8_t opt_flags;		/* User option flags */
 	char path_refs[PROCPATH_MAX];	/* /proc/$PID/clear_refs */
 	char path_pagemap[PROCPATH_MAX];/* /proc/$PID/pagemap */
@@ -204,906 +988,7035 @@ typedef struct {
 	char path_status[PROCPATH_MAX];	/* /proc/$PID/status */
 	char path_stat[PROCPATH_MAX];	/* /proc/$PID/stat */
 	char path_oom[PROCPATH_MAX];	/* /proc/$PID/oom_score */
+	char path_io[PROCPATH_MAX];	/* /proc/$PID/io */
+	char path_smaps_rollup[PROCPATH_MAX];/* /proc/$PID/smaps_rollup */
+	char path_smaps[PROCPATH_MAX];	/* /proc/$PID/smaps */
+	char path_numa_maps[PROCPATH_MAX];/* /proc/$PID/numa_maps */
+	char path_cgroup[PROCPATH_MAX];	/* /proc/$PID/cgroup */
 } global_t;
 
 static global_t g;
 
+static const page_state_t page_states[PAGE_STATE_MAX] = {
+	{ '.',	BLACK_WHITE },		/* PAGE_STATE_NOT_PRESENT */
+	{ 'P',	WHITE_YELLOW },		/* PAGE_STATE_PRESENT */
+	{ 'S',	WHITE_GREEN },		/* PAGE_STATE_SWAPPED */
+	{ 'M',	WHITE_RED },		/* PAGE_STATE_MAPPED */
+	{ 'D',	WHITE_CYAN },		/* PAGE_STATE_DIRTY */
+};
+
+static const page_state_t phys_runs[PHYS_RUN_MAX] = {
+	{ '.',	BLACK_WHITE },		/* PHYS_RUN_NONE */
+	{ '1',	WHITE_RED },		/* PHYS_RUN_SINGLE */
+	{ 's',	WHITE_MAGENTA },	/* PHYS_RUN_SHORT */
+	{ 'l',	WHITE_CYAN },		/* PHYS_RUN_LONG */
+	{ 'H',	WHITE_GREEN },		/* PHYS_RUN_HUGE */
+};
+
 /*
- *  mem_to_str()
- *	report memory in different units
+ *  Colours of NUMA nodes, cycled through
+ *  if there are more nodes
  */
-static void mem_to_str(const addr_t addr, char *const buf, const size_t buflen)
+static const uint8_t numa_pairs[] = {
+	WHITE_GREEN,
+	WHITE_MAGENTA,
+	WHITE_CYAN,
+	WHITE_YELLOW,
+};
+
+#define NUMA_PAIRS	(sizeof(numa_pairs) / sizeof(numa_pairs[0]))
+
+static const char *const prof_names[PROF_MAX] = {
+	"Other",
+	"Maps",
+	"Pagemap",
+	"Memory",
+	"VM Stats",
+	"NUMA",
+	"Clear Refs",
+	"Refresh",
+};
+
+static const char *const sched_names[SCHED_MAX] = {
+	"maps",
+	"pagemap",
+	"refs",
+	"vm",
+	"perf",
+};
+
+/*
+ *  prof_time_ns()
+ *	monotonic time in nanoseconds
+ */
+static inline uint64_t prof_time_ns(void)
 {
-	uint64_t scaled, val = (uint64_t)addr;
-	char unit;
+	struct timespec ts;
 
-	if (val < 99 * MB) {
-		scaled = val / KB;
-		unit = 'K';
-	} else if (val < 99 * GB) {
-		scaled = val / MB;
-		unit = 'M';
-	} else if (val < 99 * TB) {
-		scaled = val / GB;
-		unit = 'G';
-	} else {
-		scaled = val / TB;
-		unit = 'T';
-	}
-	(void)snprintf(buf, buflen, "%7" PRIu64 " %c", scaled, unit);
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
 }
 
 /*
- *  read_buf()
- *	read data into a buffer, just
- *	for one liner /proc file reading
+ *  prof_begin()
+ *	start timing a self profiling stage
  */
-static int read_buf(
-	const char *path,
-	char *const buffer,
-	const size_t sz)
+static inline void prof_begin(prof_t *const prof, const int stage)
 {
-	int fd;
-	ssize_t ret;
+	prof->prev_stage = g.prof_stage;
+	g.prof_stage = stage;
+	prof->start_ns = prof_time_ns();
+}
 
-	if ((fd = open(path, O_RDONLY)) < 0)
-		return -1;
-	ret = read(fd, buffer, sz);
-	(void)close(fd);
+/*
+ *  prof_end()
+ *	stop timing the current self profiling stage
+ */
+static inline void prof_end(const prof_t *const prof)
+{
+	prof_stat_t *ps = &g.prof[g.prof_stage];
+	const uint64_t ns = prof_time_ns() - prof->start_ns;
+	const uint64_t us = ns / 1000;
+	int bucket = us ? 64 - __builtin_clzll(us) : 0;
+
+	bucket = MINIMUM(bucket, PROF_BUCKETS - 1);
+	ps->hist[bucket]++;
+	ps->count++;
+	ps->total_ns += ns;
+	if (ps->max_ns < ns)
+		ps->max_ns = ns;
+	g.prof_stage = prof->prev_stage;
+}
 
-	if ((ret < 1) || (ret > (ssize_t)sz))
-		return -1;
-	buffer[ret - 1] = '\0';
-	return 0;
+/*
+ *  prof_syscall()
+ *	account a system call and bytes read
+ *	against the current profiling stage
+ */
+static inline void prof_syscall(const ssize_t bytes)
+{
+	prof_stat_t *ps = &g.prof[g.prof_stage];
+
+	ps->syscalls++;
+	if (bytes > 0)
+		ps->bytes += (uint64_t)bytes;
 }
 
 /*
- *  proc_name_to_pid()
- *	find a process by name, return PID of
- *	first match found. Zero indicates error
+ *  prof_percentile()
+ *	estimate latency percentile in microseconds
+ *	from the upper bound of the histogram bucket
  */
-static pid_t proc_name_to_pid(char *const name)
+static uint64_t prof_percentile(const prof_stat_t *const ps, const double pc)
 {
-	char *ptr;
-	bool isnum = true;
-	DIR *dir;
-	struct dirent *d;
-	pid_t pid = 0;
+	const uint64_t target = (uint64_t)((double)ps->count * pc / 100.0);
+	uint64_t sum = 0;
+	int i;
+
+	if (!ps->count)
+		return 0;
+	for (i = 0; i < PROF_BUCKETS; i++) {
+		sum += ps->hist[i];
+		if (sum > target)
+			return 1ULL << i;
+	}
+	return 1ULL << (PROF_BUCKETS - 1);
+}
 
-	/* Could be just a pid in numeric form */
-	for (ptr = name; *ptr; ptr++) {
-		if (!isdigit(*ptr)) {
-			isnum = false;
-			break;
-		}
-	}
-	if (isnum) {
-		pid = (pid_t)strtol(name, NULL, 10);
-		if (errno || (pid < 1)) {
-			(void)fprintf(stderr, "Invalid pid value '%s'\n", name);
-			return 0;
-		}
-		return pid;
-	}
+/*
+ *  sched_due()
+ *	true if sampling task id is due at time now. Deadlines
+ *	advance by whole periods from the first run so the task
+ *	keeps to the wall clock however long each frame takes,
+ *	deadlines that passed while it waited are counted as
+ *	missed rather than run in a burst
+ */
+static bool sched_due(const int id, const uint64_t now)
+{
+	sched_task_t *const t = &g.sched[id];
 
-	/* No, search for process name */
-	dir = opendir("/proc");
-	if (!dir)
-		return pid;
+	if (now < t->next_ns)
+		return false;
 
-	while ((d = readdir(dir)) != NULL) {
-		char path[PATH_MAX], buf[4096], *bn;
+	if (t->next_ns) {
+		const uint64_t late = now - t->next_ns;
+		const uint64_t periods = late / t->period_ns;
 
-		if (!isdigit(d->d_name[0]))
-			continue;
+		t->missed += periods;
+		t->late_total_ns += late - (periods * t->period_ns);
+		t->next_ns += (periods + 1) * t->period_ns;
+	} else {
+		t->next_ns = now + t->period_ns;
+	}
+	if (t->last_ns) {
+		t->interval_ns = now - t->last_ns;
+		t->interval_total_ns += t->interval_ns;
+		t->interval_max_ns = MAXIMUM(t->interval_max_ns, t->interval_ns);
+	}
+	t->last_ns = now;
+	t->runs++;
 
-		(void)snprintf(path, sizeof(path), "/proc/%s/cmdline",
-			       d->d_name);
+	return true;
+}
 
-		if (read_buf(path, buf, sizeof(buf)) < 0)
-			continue;
+/*
+ *  sched_period()
+ *	set the period of sampling task id, the next
+ *	deadline is moved to one period after the last run
+ */
+static void sched_period(const int id, const uint64_t period_ns)
+{
+	sched_task_t *const t = &g.sched[id];
 
-		bn = basename(buf);
-		if (!bn)
-			continue;
+	t->period_ns = MAXIMUM(1ULL, period_ns);
+	if (t->last_ns)
+		t->next_ns = t->last_ns + t->period_ns;
+}
 
-		if (!strcmp(name, bn)) {
-			pid = (pid_t)strtol(d->d_name, NULL, 10);
-			if ((errno == 0) && (pid > 0))
-				break;
-		}
-	}
-	(void)closedir(dir);
+/*
+ *  sched_init()
+ *	default periods of tasks not set with -T, the
+ *	pagemap is sampled every refresh and soft dirty
+ *	is reset every ticks refreshes
+ */
+static void sched_init(const useconds_t udelay, const int32_t ticks)
+{
+	const uint64_t defaults[SCHED_MAX] = {
+		SCHED_MAPS_NS,
+		(uint64_t)udelay * 1000ULL,
+		(uint64_t)udelay * 1000ULL * (uint64_t)ticks,
+		VM_SAMPLE_NS,
+		SCHED_PERF_NS,
+	};
+	int i;
 
-	if (!pid)
-		(void)fprintf(stderr, "Cannot find process '%s'\n", name);
-	return pid;
+	for (i = 0; i < SCHED_MAX; i++) {
+		if (!g.sched[i].period_ns)
+			sched_period(i, defaults[i]);
+	}
 }
 
 /*
- *  get_proc_self_stat_field()
- *     find nth field of /proc/$PID/stat data. This works around
- *     the problem that the comm field can contain spaces and
- *     multiple ) so sscanf on this field won't work.  The returned
- *     pointer is the start of the Nth field and it is up to the
- *     caller to determine the end of the field
+ *  sched_reset()
+ *	run all sampling tasks on the next frame
  */
-static const char *get_proc_self_stat_field(const char *buf, const int num)
+static void sched_reset(void)
 {
-	const char *ptr, *comm_end;
-	int n;
+	int i;
 
-	if (num < 1 || !buf || !*buf)
-		return NULL;
-	if (num == 1)
-		return buf;
-	if (num == 2)
-		return strstr(buf, "(");
+	for (i = 0; i < SCHED_MAX; i++)
+		g.sched[i].next_ns = 0;
+}
 
-	comm_end = NULL;
-	for (ptr = buf; *ptr; ptr++) {
-		if (*ptr == ')')
-			comm_end = ptr;
-	}
-	if (!comm_end)
-		return NULL;
-	comm_end++;
-	n = num - 2;
+/*
+ *  sched_parse()
+ *	parse a comma separated list of task=ms periods
+ */
+static int sched_parse(const char *list)
+{
+	const char *ptr = list;
 
-	ptr = comm_end;
 	while (*ptr) {
-		while (*ptr && *ptr == ' ')
-			ptr++;
-		n--;
-		if (n <= 0)
+		const char *end = strchr(ptr, ',');
+		const char *eq = strchr(ptr, '=');
+		const size_t len = end ? (size_t)(end - ptr) : strlen(ptr);
+		unsigned long long ms;
+		char *num_end;
+		int i;
+
+		if (!eq || (end && (eq > end)))
+			return -1;
+		for (i = 0; i < SCHED_MAX; i++) {
+			if ((strlen(sched_names[i]) == (size_t)(eq - ptr)) &&
+			    !strncmp(ptr, sched_names[i], (size_t)(eq - ptr)))
+				break;
+		}
+		if (i == SCHED_MAX)
+			return -1;
+		errno = 0;
+		ms = strtoull(eq + 1, &num_end, 10);
+		if (errno || !ms || (num_end != ptr + len))
+			return -1;
+		g.sched[i].period_ns = ms * 1000000ULL;
+		if (!end)
 			break;
-		while (*ptr && *ptr != ' ')
-			ptr++;
+		ptr = end + 1;
 	}
-
-	return ptr;
+	return 0;
 }
 
 /*
- *  read_faults()
- *	read minor and major page faults
+ *  mem_to_str()
+ *	report memory in different units
  */
-static int read_faults(
-	uint64_t *const minor_flt,
-	uint64_t *const major_flt)
+static void mem_to_str(const addr_t addr, char *const buf, const size_t buflen)
 {
-	char buf[4096];
-	const char *ptr;
+	uint64_t scaled, val = (uint64_t)addr;
+	char unit;
+
+	if (val < 99 * MB) {
+		scaled = val / KB;
+		unit = 'K';
+	} else if (val < 99 * GB) {
+		scaled = val / MB;
+		unit = 'M';
+	} else if (val < 99 * TB) {
+		scaled = val / GB;
+		unit = 'G';
+	} else {
+		scaled = val / TB;
+		unit = 'T';
+	}
+	(void)snprintf(buf, buflen, "%7" PRIu64 " %c", scaled, unit);
+}
 
-	*minor_flt = 0;
-	*major_flt = 0;
+/*
+ *  read_buf()
+ *	read data into a buffer, just
+ *	for one liner /proc file reading
+ */
+static int read_buf(
+	const char *path,
+	char *const buffer,
+	const size_t sz)
+{
+	int fd;
+	ssize_t ret;
 
-	if (read_buf(g.path_stat, buf, sizeof(buf)) < 0)
+	if ((fd = open(path, O_RDONLY)) < 0)
 		return -1;
+	ret = read(fd, buffer, sz);
+	(void)close(fd);
+	prof_syscall(0);
+	prof_syscall(ret);
+	prof_syscall(0);
 
-	ptr = get_proc_self_stat_field(buf, 10);
-	if (!ptr)
-		return -1;
-	if (sscanf(ptr, "%" SCNu64 " %*u %" SCNu64, minor_flt, major_flt) != 2)
+	if ((ret < 1) || (ret > (ssize_t)sz))
 		return -1;
+	buffer[ret - 1] = '\0';
 	return 0;
 }
 
 /*
- *  read_oom_score()
- *	read the process oom score
+ *  proc_match_init()
+ *	set up a process name or command line regex match,
+ *	names match the basename or full path of argv[0]
  */
-static int read_oom_score(uint64_t *const score)
+static int proc_match_init(
+	proc_match_t *const match,
+	const char *pattern,
+	const bool is_regex)
 {
-	char buf[4096];
-
-	*score = ~0ULL;
-
-	if (read_buf(g.path_oom, buf, sizeof(buf)) < 0)
-		return -1;
-
-	if (sscanf(buf, "%" SCNu64, score) != 1)
+	(void)snprintf(match->pattern, sizeof(match->pattern), "%s", pattern);
+	match->is_regex = is_regex;
+	if (!is_regex)
+		return 0;
+	if (regcomp(&match->regex, pattern, REG_EXTENDED | REG_NOSUB) != 0) {
+		(void)fprintf(stderr, "Invalid regular expression '%s'\n", pattern);
 		return -1;
+	}
+	match->compiled = true;
 	return 0;
 }
 
 /*
- *  read_maps()
- *	read memory maps for a specific process
+ *  proc_match_free()
+ *	free a compiled regex match
  */
-static int read_maps(const bool force)
+static void proc_match_free(proc_match_t *const match)
 {
-	FILE *fp;
-	uint32_t i, j, n = 0;
-	char buffer[4096];
-	page_t *page;
-	checksum_t checksum = 0ULL;
-	map_t *map;
+	if (match->compiled)
+		regfree(&match->regex);
+	match->compiled = false;
+}
 
-	g.mem_info.npages = 0;
-	g.mem_info.last_addr = 0;
+/*
+ *  proc_start_time()
+ *	start time in clock ticks of the process in
+ *	directory name of /proc, 0 if unknown
+ */
+static uint64_t proc_start_time(const int proc_fd, const char *name)
+{
+	char path[PROCPATH_MAX], buf[1024], *ptr;
+	int fd, field;
+	ssize_t ret;
 
-	if (kill(g.pid, 0) < 0)
-		return ERR_NO_PROCESS;
-	if (force)
-		g.prev_checksum = 0;
+	(void)snprintf(path, sizeof(path), "%s/stat", name);
+	if ((fd = openat(proc_fd, path, O_RDONLY)) < 0)
+		return 0;
+	ret = read(fd, buf, sizeof(buf) - 1);
+	(void)close(fd);
+	if (ret < 1)
+		return 0;
+	buf[ret] = '\0';
+
+	/* Skip to field 22, starttime, from field 2, comm */
+	ptr = strrchr(buf, ')');
+	for (field = 2; ptr && (field < 22); field++) {
+		ptr = strchr(ptr, ' ');
+		if (ptr)
+			ptr++;
+	}
+	return ptr ? strtoull(ptr, NULL, 10) : 0;
+}
 
-	fp = fopen(g.path_maps, "r");
-	if (fp == NULL)
-		return ERR_NO_MAP_INFO;
+/*
+ *  proc_find()
+ *	find up to max processes that match, skipping
+ *	ourself and the exclude pid. The cmdline of each
+ *	process is read with one openat relative to /proc.
+ *	Returns the number of candidates found
+ */
+static size_t proc_find(
+	const proc_match_t *const match,
+	proc_cand_t *const cands,
+	const size_t max,
+	const pid_t exclude)
+{
+	const pid_t self = getpid();
+	DIR *dir;
+	struct dirent *d;
+	size_t n = 0;
+	int proc_fd;
 
-	map = g.mem_info.maps;
-	while (fgets(buffer, sizeof(buffer), fp) != NULL) {
-		int ret;
-		intptr_t length;
-
-		map->name[0] = '\0';
-		ret = sscanf(buffer, "%" SCNx64 "-%" SCNx64
-			" %5s %*s %6s %*d %s",
-			&map->begin,
-			&map->end,
-			map->attr,
-			map->dev,
-			map->name);
-		if ((ret != 5) && (ret != 4))
-			continue;
-		if (ret == 4)
-			map->name[0]= '\0';
+	dir = opendir("/proc");
+	if (!dir)
+		return 0;
+	proc_fd = dirfd(dir);
 
-		/* Simple sanity check */
-		if (map->end < map->begin)
-			continue;
+	while ((n < max) && ((d = readdir(dir)) != NULL)) {
+		char path[PROCPATH_MAX], buf[4096], *arg0, *ptr;
+		pid_t pid;
+		ssize_t len;
+		bool found;
+		int fd;
 
-		length = map->end - map->begin;
-		/* Check for overflow */
-		if (g.mem_info.npages + length < g.mem_info.npages)
+		if (!isdigit(d->d_name[0]))
+			continue;
+		pid = (pid_t)strtol(d->d_name, NULL, 10);
+		if ((pid == self) || (pid == exclude))
 			continue;
 
-		if (g.mem_info.last_addr < map->end)
-			g.mem_info.last_addr = map->end;
-
-		checksum ^= map->begin;
-		checksum <<= 1;
-		checksum ^= map->end;
-		checksum <<= 1;
-		checksum ^= map->attr[0];
-		checksum <<= 1;
-		checksum ^= map->attr[1];
-		checksum <<= 1;
-		checksum ^= map->attr[2];
-		checksum <<= 1;
-		checksum ^= map->attr[3];
-		checksum <<= 1;
-		checksum ^= length;
+		(void)snprintf(path, sizeof(path), "%s/cmdline", d->d_name);
+		if ((fd = openat(proc_fd, path, O_RDONLY)) < 0)
+			continue;
+		len = read(fd, buf, sizeof(buf) - 1);
+		(void)close(fd);
+		/* Kernel threads have no command line */
+		if (len < 1)
+			continue;
+		buf[len] = '\0';
+
+		found = false;
+		if (!match->is_regex) {
+			arg0 = strrchr(buf, '/');
+			arg0 = arg0 ? arg0 + 1 : buf;
+			found = !strcmp(match->pattern, arg0) ||
+				!strcmp(match->pattern, buf);
+		}
+		/* Regexes match the arguments joined by spaces */
+		for (ptr = buf; ptr < buf + len - 1; ptr++) {
+			if (*ptr == '\0')
+				*ptr = ' ';
+		}
+		if (match->is_regex)
+			found = (regexec(&match->regex, buf, 0, NULL, 0) == 0);
+		if (!found)
+			continue;
 
-		g.mem_info.npages += length / g.page_size;
+		cands[n].pid = pid;
+		cands[n].start = proc_start_time(proc_fd, d->d_name);
+		(void)snprintf(cands[n].cmdline, sizeof(cands[n].cmdline),
+			"%.*s", (int)sizeof(cands[n].cmdline) - 1, buf);
 		n++;
-		map++;
-		if (n >= MAX_MAPS)
-			break;
 	}
-	(void)fclose(fp);
-
-	checksum += g.mem_info.npages;
-	checksum += n;
-	g.checksum = checksum;
+	(void)closedir(dir);
 
-	/* No change in maps, so nothing to do */
-	if (g.checksum == g.prev_checksum)
-		return OK;
-	g.prev_checksum = checksum;
+	return n;
+}
 
-	/* Unlikely, but need to keep Coverity Scan happy */
-	if (g.mem_info.npages > g.max_pages)
-		return ERR_TOO_MANY_PAGES;
-	if (g.mem_info.npages == 0)
-		return ERR_TOO_FEW_PAGES;
+/*
+ *  proc_newest()
+ *	the most recently started candidate
+ */
+static pid_t proc_newest(const proc_cand_t *const cands, const size_t n)
+{
+	size_t i, newest = 0;
 
-	free(g.mem_info.pages);
-	g.mem_info.nmaps = n;
-	g.mem_info.pages = calloc(g.mem_info.npages, sizeof(page_t));
-	if (!g.mem_info.pages) {
-		g.mem_info.nmaps = 0;
-		return ERR_ALLOC_NOMEM;
+	for (i = 1; i < n; i++) {
+		if (cands[i].start > cands[newest].start)
+			newest = i;
 	}
+	return cands[newest].pid;
+}
 
-	map = g.mem_info.maps;
-	page = g.mem_info.pages;
-	for (i = 0; i < g.mem_info.nmaps; i++, map++) {
-		addr_t addr = map->begin;
-		addr_t count = (map->end - map->begin) / g.page_size;
+/*
+ *  proc_pick()
+ *	ask the user to pick one of several matching
+ *	processes, zero indicates error
+ */
+static pid_t proc_pick(const proc_cand_t *const cands, const size_t n)
+{
+	char buf[32];
+	size_t i;
+	unsigned long choice;
+
+	(void)printf("Processes matching '%s':\n", g.match.pattern);
+	for (i = 0; i < n; i++)
+		(void)printf("%3zu) %7d %s\n", i + 1, cands[i].pid,
+			cands[i].cmdline);
+	(void)fflush(stdout);
+	if (!isatty(fileno(stdin))) {
+		(void)fprintf(stderr, "Multiple processes match, use -p to "
+			"specify the process ID\n");
+		return 0;
+	}
 
-		for (j = 0; j < count; j++, page++) {
-			page->addr = addr;
-			page->map = map;
-			page->index = i;
-			addr += g.page_size;
-		}
+	for (;;) {
+		(void)printf("Select process [1-%zu]: ", n);
+		(void)fflush(stdout);
+		if (!fgets(buf, sizeof(buf), stdin))
+			return 0;
+		choice = strtoul(buf, NULL, 10);
+		if ((choice >= 1) && (choice <= n))
+			return cands[choice - 1].pid;
 	}
-	return (n == 0) ? ERR_NO_MAP_INFO : OK;
 }
 
 /*
- *  handle_winch()
- *	handle SIGWINCH, flag a window resize
+ *  proc_lookup()
+ *	find a process by pid, name or command line regex,
+ *	picking one if several match. Zero indicates error
  */
-static void handle_winch(int sig)
+static pid_t proc_lookup(const char *pattern, const bool is_regex)
 {
-	(void)sig;
+	proc_cand_t cands[PROC_MATCH_MAX];
+	const char *ptr;
+	bool isnum = !is_regex;
+	pid_t pid;
+	size_t n;
 
-	g.resized = true;
+	/* Could be just a pid in numeric form */
+	for (ptr = pattern; isnum && *ptr; ptr++) {
+		if (!isdigit(*ptr))
+			isnum = false;
+	}
+	if (isnum) {
+		errno = 0;
+		pid = (pid_t)strtol(pattern, NULL, 10);
+		if (errno || (pid < 1)) {
+			(void)fprintf(stderr, "Invalid pid value '%s'\n", pattern);
+			return 0;
+		}
+		return pid;
+	}
+
+	/* No, search for process name or command line */
+	if (proc_match_init(&g.match, pattern, is_regex) < 0)
+		return 0;
+	n = proc_find(&g.match, cands, PROC_MATCH_MAX, 0);
+	if (!n) {
+		(void)fprintf(stderr, "Cannot find process '%s'\n", pattern);
+		return 0;
+	}
+	return (n == 1) ? cands[0].pid : proc_pick(cands, n);
 }
 
+#define FIELD_IS(name, len, str) \
+	(((len) == sizeof(str) - 1) && !memcmp(name, str, sizeof(str) - 1))
+
 /*
- *  handle_terminate()
- *	handle termination signals
+ *  vm_u64()
+ *	parse a decimal value in place
  */
-static void handle_terminate(int sig)
+static inline uint64_t vm_u64(const char *ptr)
 {
-	static bool already_handled = false;
+	uint64_t val = 0;
 
-	(void)sig;
+	while ((*ptr == ' ') || (*ptr == '\t'))
+		ptr++;
+	while ((uint8_t)(*ptr - '0') < 10) {
+		val = (val * 10) + (uint64_t)(*ptr - '0');
+		ptr++;
+	}
+	return val;
+}
 
-	if (already_handled)
-		exit(EXIT_FAILURE);
+/*
+ *  vm_pread()
+ *	read a /proc file from the start with a single
+ *	pread, returns length read or -1 on failure
+ */
+static ssize_t vm_pread(const int fd, char *const buf, const size_t size)
+{
+	ssize_t ret;
 
-	g.terminate = true;
-	siglongjmp(g.env, 1);
+	if (fd < 0)
+		return -1;
+	ret = pread(fd, buf, size - 1, 0);
+	prof_syscall(ret);
+	if (ret < 0)
+		return -1;
+	buf[ret] = '\0';
+	return ret;
 }
 
 /*
- *  show_usage()
- *	mini help info
+ *  vm_open()
+ *	open the VM stats files, they are kept open
+ *	and re-read from the start on each sample
  */
-static void show_usage(void)
+static void vm_open(vm_t *const vm)
 {
-	(void)printf(APP_NAME ", version " VERSION "\n\n"
-		"Usage: " APP_NAME " [options]\n"
-		" -a        enable automatic zoom mode\n"
-		" -d        delay in microseconds between refreshes, "
-			"default %u\n"
-		" -h        help\n"
-		" -p pid    process ID to monitor\n"
-		" -r        read (page back in) pages at start\n"
-		" -t ticks  ticks between dirty page checks\n"
-		" -v        enable VM view\n"
-		" -z zoom   set page zoom scale\n",
-		DEFAULT_UDELAY);
+	vm->fd_status = open(g.path_status, O_RDONLY);
+	vm->fd_stat = open(g.path_stat, O_RDONLY);
+	vm->fd_io = open(g.path_io, O_RDONLY);
+	vm->fd_oom = open(g.path_oom, O_RDONLY);
+	vm->opened = true;
 }
 
-#if defined(PERF_ENABLED)
 /*
- *  show_perf()
- *	show perf stats
+ *  vm_close()
+ *	close the VM stats files
  */
-static void show_perf(void)
+static void vm_close(vm_t *const vm)
 {
-	int y = LINES - 6;
-	const int x = 2;
-	static uint8_t perf_ticker = 0;
-
-	/* Don't hammer perf to death */
-	if (++perf_ticker > 10) {
-		perf_stop(&g.perf);
-		perf_start(&g.perf, g.pid);
-		perf_ticker = 0;
-	}
-	(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_CYAN) | A_BOLD);
-	(void)mvwprintw(g.mainwin, y + 0, x,
-		" Page Faults (User Space):   %15" PRIu64 " ",
-		perf_counter(&g.perf, PERF_TP_PAGE_FAULT_USER));
-	(void)mvwprintw(g.mainwin, y + 1, x,
-		" Page Faults (Kernel Space): %15" PRIu64 " ",
-		perf_counter(&g.perf, PERF_TP_PAGE_FAULT_KERNEL));
-	(void)mvwprintw(g.mainwin, y + 2, x,
-		" Kernel Page Allocate:       %15" PRIu64 " ",
-		perf_counter(&g.perf, PERF_TP_MM_PAGE_ALLOC));
-	(void)mvwprintw(g.mainwin, y + 3, x,
-		" Kernel Page Free:           %15" PRIu64 " ",
-		perf_counter(&g.perf, PERF_TP_MM_PAGE_FREE));
-
+	if (!vm->opened)
+		return;
+	if (vm->fd_status >= 0)
+		(void)close(vm->fd_status);
+	if (vm->fd_stat >= 0)
+		(void)close(vm->fd_stat);
+	if (vm->fd_io >= 0)
+		(void)close(vm->fd_io);
+	if (vm->fd_oom >= 0)
+		(void)close(vm->fd_oom);
+	vm->opened = false;
 }
-#endif
 
 /*
- *  show_vm()
- *	show Virtual Memory stats
+ *  vm_parse_status()
+ *	parse the State, Vm and Rss lines of status
  */
-static void show_vm(void)
+static void vm_parse_status(vm_t *const vm, const size_t len)
 {
-	FILE *fp;
-	char buffer[4096];
-	int y = 2;
-	const int x = COLS - 26;
-	uint64_t major, minor, score;
+	const char *ptr = vm->status, *const end = vm->status + len;
 
-	fp = fopen(g.path_status, "r");
-	if (fp == NULL)
-		return;
+	vm->nfields = 0;
+	vm->state = NULL;
+	vm->state_len = 0;
 
-	(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
-	while (fgets(buffer, sizeof(buffer), fp) != NULL) {
-		char vmname[9], size[8];
-		char state[6], longstate[13];
-		uint64_t sz;
+	while (ptr < end) {
+		const char *eol = memchr(ptr, '\n', (size_t)(end - ptr));
+		const char *colon;
+		size_t name_len;
 
-		if (sscanf(buffer, "State: %5s %12s", state, longstate) == 2) {
-			(void)mvwprintw(g.mainwin, y++, x,
-				" State:    %-12.12s ", longstate);
-			continue;
+		if (!eol)
+			eol = end;
+		colon = memchr(ptr, ':', (size_t)(eol - ptr));
+		if (!colon)
+			goto next;
+		name_len = (size_t)(colon - ptr);
+
+		if ((name_len > 2) && (ptr[0] == 'V') && (ptr[1] == 'm')) {
+			const uint64_t kb = vm_u64(colon + 1);
+
+			if (vm->nfields < VM_FIELDS_MAX) {
+				vm_field_t *field = &vm->fields[vm->nfields++];
+
+				field->name = ptr + 2;
+				field->len = (uint32_t)name_len - 2;
+				field->value = kb;
+			}
+			if (FIELD_IS(ptr, name_len, "VmRSS"))
+				vm->rss = kb;
+			else if (FIELD_IS(ptr, name_len, "VmSwap"))
+				vm->swap = kb;
+		} else if (FIELD_IS(ptr, name_len, "RssAnon")) {
+			vm->anon = vm_u64(colon + 1);
+		} else if (FIELD_IS(ptr, name_len, "RssFile")) {
+			vm->file = vm_u64(colon + 1);
+		} else if (FIELD_IS(ptr, name_len, "State")) {
+			/* Long form of the state, e.g. (sleeping) */
+			const char *state = memchr(colon, '(', (size_t)(eol - colon));
+
+			if (state) {
+				vm->state = state;
+				vm->state_len = (uint32_t)(eol - state);
+			}
 		}
-		if (sscanf(buffer, "Vm%8s %" SCNu64 "%7s",
-		    vmname, &sz, size) == 3) {
-			(void)mvwprintw(g.mainwin, y++, x,
-				" Vm%-6.6s %10" PRIu64 " %s ",
-				vmname, sz, size);
+next:
+		ptr = eol + 1;
+	}
+}
+
+/*
+ *  vm_parse_stat()
+ *	parse the minor and major fault counts from stat. The
+ *	comm field can contain spaces and ) so the fields are
+ *	counted from the last )
+ */
+static bool vm_parse_stat(vm_t *const vm, const size_t len)
+{
+	const char *ptr = vm->stat + len;
+	int field;
+
+	while ((ptr > vm->stat) && (*ptr != ')'))
+		ptr--;
+	if (*ptr != ')')
+		return false;
+
+	/* Skip to field 10, minflt, from field 2, comm */
+	for (field = 2; field < 10; field++) {
+		ptr = strchr(ptr, ' ');
+		if (!ptr)
+			return false;
+		ptr++;
+	}
+	vm->minflt = vm_u64(ptr);
+
+	/* Skip cminflt to majflt */
+	for (; field < 12; field++) {
+		ptr = strchr(ptr, ' ');
+		if (!ptr)
+			return false;
+		ptr++;
+	}
+	vm->majflt = vm_u64(ptr);
+
+	return true;
+}
+
+/*
+ *  vm_parse_io()
+ *	parse the storage read and write bytes from io
+ */
+static void vm_parse_io(vm_t *const vm, const size_t len)
+{
+	const char *ptr = vm->io, *const end = vm->io + len;
+
+	while (ptr < end) {
+		const char *eol = memchr(ptr, '\n', (size_t)(end - ptr));
+		const char *colon;
+
+		if (!eol)
+			eol = end;
+		colon = memchr(ptr, ':', (size_t)(eol - ptr));
+		if (colon) {
+			const size_t name_len = (size_t)(colon - ptr);
+
+			if (FIELD_IS(ptr, name_len, "read_bytes"))
+				vm->read_bytes = vm_u64(colon + 1);
+			else if (FIELD_IS(ptr, name_len, "write_bytes"))
+				vm->write_bytes = vm_u64(colon + 1);
+		}
+		ptr = eol + 1;
+	}
+}
+
+/*
+ *  vm_read()
+ *	read and parse status, stat, io and oom_score,
+ *	returns -1 if status could not be read
+ */
+static int vm_read(vm_t *const vm)
+{
+	ssize_t len;
+
+	if (!vm->opened)
+		vm_open(vm);
+
+	len = vm_pread(vm->fd_stat, vm->stat, sizeof(vm->stat));
+	vm->have_stat = (len > 0) && vm_parse_stat(vm, (size_t)len);
+	len = vm_pread(vm->fd_io, vm->io, sizeof(vm->io));
+	vm->have_io = (len > 0);
+	if (vm->have_io)
+		vm_parse_io(vm, (size_t)len);
+	len = vm_pread(vm->fd_oom, vm->oom, sizeof(vm->oom));
+	vm->have_oom = (len > 0);
+	if (vm->have_oom)
+		vm->oom_score = vm_u64(vm->oom);
+
+	len = vm_pread(vm->fd_status, vm->status, sizeof(vm->status));
+	if (len < 0)
+		return -1;
+	vm_parse_status(vm, (size_t)len);
+
+	return 0;
+}
+
+/*
+ *  vm_sample()
+ *	sample the VM stats into the ring buffer, rates
+ *	are over the time since the previous sample
+ */
+static void vm_sample(vm_t *const vm)
+{
+	const uint64_t now = prof_time_ns();
+	vm_sample_t *sample;
+	double secs;
+	prof_t prof;
+
+	prof_begin(&prof, PROF_VM);
+	if (vm_read(vm) < 0) {
+		prof_end(&prof);
+		return;
+	}
+	secs = vm->sample_ns ? (double)(now - vm->sample_ns) / 1000000000.0 : 0.0;
+
+	sample = &vm->samples[vm->head];
+	sample->v[VM_RSS] = (double)vm->rss;
+	sample->v[VM_SWAP] = (double)vm->swap;
+	sample->v[VM_ANON] = (double)vm->anon;
+	sample->v[VM_FILE] = (double)vm->file;
+	sample->v[VM_MINFLT] = (secs > 0.0) ?
+		(double)(vm->minflt - vm->prev[0]) / secs : 0.0;
+	sample->v[VM_MAJFLT] = (secs > 0.0) ?
+		(double)(vm->majflt - vm->prev[1]) / secs : 0.0;
+	vm->read_rate = (secs > 0.0) ?
+		(double)(vm->read_bytes - vm->prev[2]) / secs : 0.0;
+	vm->write_rate = (secs > 0.0) ?
+		(double)(vm->write_bytes - vm->prev[3]) / secs : 0.0;
+
+	vm->prev[0] = vm->minflt;
+	vm->prev[1] = vm->majflt;
+	vm->prev[2] = vm->read_bytes;
+	vm->prev[3] = vm->write_bytes;
+	vm->sample_ns = now;
+	vm->head = (vm->head + 1) % VM_SAMPLES;
+	if (vm->count < VM_SAMPLES)
+		vm->count++;
+	prof_end(&prof);
+}
+
+/*
+ *  pressure_mount()
+ *	find where the cgroup v2 hierarchy is mounted,
+ *	returns false if it is not mounted
+ */
+static bool pressure_mount(char *const mnt, const size_t mnt_len)
+{
+	FILE *fp;
+	char line[4096];
+	bool found = false;
+
+	fp = fopen("/proc/self/mountinfo", "r");
+	if (!fp)
+		return false;
+	while (!found && fgets(line, sizeof(line), fp)) {
+		const char *sep = strstr(line, " - cgroup2 ");
+		const char *ptr = line;
+		size_t len;
+		int field;
+
+		if (!sep)
 			continue;
+		/* Mount point is field 5 */
+		for (field = 1; ptr && (field < 5); field++) {
+			ptr = strchr(ptr, ' ');
+			if (ptr)
+				ptr++;
 		}
+		if (!ptr)
+			continue;
+		len = strcspn(ptr, " ");
+		if (len >= mnt_len)
+			continue;
+		(void)memcpy(mnt, ptr, len);
+		mnt[len] = '\0';
+		found = true;
 	}
 	(void)fclose(fp);
 
-	if (!read_faults(&minor, &major)) {
-		(void)mvwprintw(g.mainwin, y++, x, " %-23s", "Page Faults:");
-		(void)mvwprintw(g.mainwin, y++, x,
-			" Minor: %12" PRIu64 "    ", minor);
-		(void)mvwprintw(g.mainwin, y++, x,
-			" Major: %12" PRIu64 "    ", major);
+	return found;
+}
+
+/*
+ *  pressure_open()
+ *	find the cgroup v2 directory of the process from
+ *	the 0:: line of its cgroup file and open the memory
+ *	controller files, they are kept open and re-read
+ *	from the start on each sample
+ */
+static void pressure_open(pressure_t *const pr)
+{
+	char mnt[PROCPATH_MAX];
+	char *cg, *eol;
+	int dir_fd;
+
+	pr->fd_pressure = -1;
+	pr->fd_stat = -1;
+	pr->fd_current = -1;
+	pr->fd_max = -1;
+	pr->opened = true;
+	pr->valid = false;
+
+	if (read_buf(g.path_cgroup, pr->buf, sizeof(pr->buf) - 1) < 0)
+		return;
+	if (!strncmp(pr->buf, "0::", 3)) {
+		cg = pr->buf;
+	} else {
+		cg = strstr(pr->buf, "\n0::");
+		if (!cg)
+			return;
+		cg++;
 	}
+	cg += 3;
+	eol = strchr(cg, '\n');
+	if (eol)
+		*eol = '\0';
+	if (!pressure_mount(mnt, sizeof(mnt)))
+		return;
+	(void)snprintf(pr->path, sizeof(pr->path), "%.*s%.*s",
+		(int)(sizeof(pr->path) / 2) - 1, mnt,
+		(int)(sizeof(pr->path) / 2) - 1, strcmp(cg, "/") ? cg : "");
 
-	if (!read_oom_score(&score)) {
-		(void)mvwprintw(g.mainwin, y, x,
-			" OOM Score: %8" PRIu64 "    ", score);
+	dir_fd = open(pr->path, O_RDONLY | O_DIRECTORY);
+	if (dir_fd < 0)
+		return;
+	pr->fd_pressure = openat(dir_fd, "memory.pressure", O_RDONLY);
+	pr->fd_stat = openat(dir_fd, "memory.stat", O_RDONLY);
+	pr->fd_current = openat(dir_fd, "memory.current", O_RDONLY);
+	pr->fd_max = openat(dir_fd, "memory.max", O_RDONLY);
+	(void)close(dir_fd);
+
+	/* The root cgroup has memory.stat and memory.pressure only */
+	pr->valid = (pr->fd_pressure >= 0) || (pr->fd_stat >= 0);
+}
+
+/*
+ *  pressure_close()
+ *	close the cgroup files, the next sample looks
+ *	up the cgroup again and the rates restart
+ */
+static void pressure_close(pressure_t *const pr)
+{
+	if (!pr->opened)
+		return;
+	if (pr->fd_pressure >= 0)
+		(void)close(pr->fd_pressure);
+	if (pr->fd_stat >= 0)
+		(void)close(pr->fd_stat);
+	if (pr->fd_current >= 0)
+		(void)close(pr->fd_current);
+	if (pr->fd_max >= 0)
+		(void)close(pr->fd_max);
+	pr->opened = false;
+	pr->sample_ns = 0;
+}
+
+/*
+ *  pressure_parse_psi()
+ *	parse the some and full avg10 and stall
+ *	totals from memory.pressure
+ */
+static void pressure_parse_psi(pressure_t *const pr, const size_t len)
+{
+	char *ptr = pr->buf, *const end = pr->buf + len;
+
+	while (ptr < end) {
+		char *eol = memchr(ptr, '\n', (size_t)(end - ptr));
+		const char *avg, *total;
+		const bool some = !strncmp(ptr, "some ", 5);
+
+		if (!eol)
+			eol = end;
+		*eol = '\0';
+		avg = strstr(ptr, "avg10=");
+		total = strstr(ptr, "total=");
+		if (avg && total && (some || !strncmp(ptr, "full ", 5))) {
+			const double avg10 = strtod(avg + 6, NULL);
+
+			if (some) {
+				pr->some_avg10 = avg10;
+				pr->some_total = vm_u64(total + 6);
+			} else {
+				pr->full_avg10 = avg10;
+				pr->full_total = vm_u64(total + 6);
+			}
+		}
+		ptr = eol + 1;
 	}
 }
 
 /*
- *  show_page_bits()
- *	show info based on the page bit pattern
+ *  pressure_parse_stat()
+ *	parse the refault, scan and steal counters
+ *	from memory.stat
  */
-static void show_page_bits(
-	const int fd,
-	map_t *const map,
-	const index_t idx)
+static void pressure_parse_stat(pressure_t *const pr, const size_t len)
 {
-	pagemap_t pagemap_info;
-	off_t offset;
-	char buf[16];
-	const int x = 2;
-	int kfd;
+	const char *ptr = pr->buf, *const end = pr->buf + len;
+
+	while (ptr < end) {
+		const char *eol = memchr(ptr, '\n', (size_t)(end - ptr));
+		const char *space;
+		size_t name_len;
+
+		if (!eol)
+			eol = end;
+		space = memchr(ptr, ' ', (size_t)(eol - ptr));
+		if (!space)
+			goto next;
+		name_len = (size_t)(space - ptr);
+
+		if (FIELD_IS(ptr, name_len, "workingset_refault_anon"))
+			pr->stat[PSTAT_REFAULT_ANON] = vm_u64(space);
+		else if (FIELD_IS(ptr, name_len, "workingset_refault_file") ||
+			 FIELD_IS(ptr, name_len, "workingset_refault"))
+			pr->stat[PSTAT_REFAULT_FILE] = vm_u64(space);
+		else if (FIELD_IS(ptr, name_len, "pgscan"))
+			pr->stat[PSTAT_PGSCAN] = vm_u64(space);
+		else if (FIELD_IS(ptr, name_len, "pgsteal"))
+			pr->stat[PSTAT_PGSTEAL] = vm_u64(space);
+next:
+		ptr = eol + 1;
+	}
+}
 
-	mem_to_str(map->end - map->begin, buf, sizeof(buf) - 1);
-	(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
-	(void)mvwprintw(g.mainwin, 2, x,
-		" Page:      0x%16.16" PRIx64 "%18s",
-		g.mem_info.pages[idx].addr, "");
-	(void)mvwprintw(g.mainwin, 3, x,
-		" Page Size: 0x%8.8" PRIx32 " bytes%20s",
-		g.page_size, "");
-	(void)mvwprintw(g.mainwin, 4, x,
-		" Map:       0x%16.16" PRIx64 "-%16.16" PRIx64 " ",
-		map->begin, map->end - 1);
-	(void)mvwprintw(g.mainwin, 5, x,
-		" Map Size:  %s%27s", buf, "");
-	(void)mvwprintw(g.mainwin, 6, x,
-		" Device:    %5.5s%31s",
-		map->dev, "");
-	(void)mvwprintw(g.mainwin, 7, x,
-		" Prot:      %4.4s%32s",
-		map->attr, "");
-	(void)mvwprintw(g.mainwin, 8, x,
-		" Map Name:  %-35.35s ", map->name[0] == '\0' ?
-			"[Anonymous]" : basename(map->name));
+/*
+ *  pressure_changes()
+ *	the transitions between in RAM and swapped or not
+ *	present seen by the pyramid, from the present and
+ *	swapped bits so soft dirty or file mapped pages
+ *	are counted the same as the rest
+ */
+static void pressure_changes(uint64_t changes[CHANGE_MAX])
+{
+	const pyramid_t *const py = &g.mem_info.pyramid;
+
+	changes[CHANGE_SWAP_OUT] =
+		py->changes[PAGE_STATE_PRESENT][PAGE_STATE_SWAPPED];
+	changes[CHANGE_SWAP_IN] =
+		py->changes[PAGE_STATE_SWAPPED][PAGE_STATE_PRESENT];
+	changes[CHANGE_DROPPED] =
+		py->changes[PAGE_STATE_PRESENT][PAGE_STATE_NOT_PRESENT];
+	changes[CHANGE_FAULTED] =
+		py->changes[PAGE_STATE_NOT_PRESENT][PAGE_STATE_PRESENT];
+}
 
-	offset = sizeof(pagemap_t) *
-		(g.mem_info.pages[idx].addr / g.page_size);
-	if (lseek(fd, offset, SEEK_SET) == (off_t)-1)
-		return;
-	if (read(fd, &pagemap_info, sizeof(pagemap_info)) != sizeof(pagemap_info))
+/*
+ *  pressure_sample()
+ *	sample the cgroup memory pressure once every
+ *	PRESSURE_SAMPLE_NS, the page state transitions
+ *	since the last sample are kept as an event when
+ *	the pressure is over the threshold
+ */
+static void pressure_sample(pressure_t *const pr)
+{
+	const uint64_t now = prof_time_ns();
+	double secs;
+	ssize_t len;
+	prof_t prof;
+	uint32_t i;
+
+	if (pr->sample_ns && (now - pr->sample_ns < PRESSURE_SAMPLE_NS))
 		return;
 
-	(void)mvwprintw(g.mainwin, 9, x,
-		" Flag:      0x%16.16" PRIx64 "%18s", pagemap_info, "");
-	if (pagemap_info & PAGE_SWAPPED) {
-		(void)mvwprintw(g.mainwin, 10, x,
-			" Swap Type:           0x%2.2" PRIx64 "%22s",
-			pagemap_info & 0x1f, "");
-		(void)mvwprintw(g.mainwin, 11, x,
-			" Swap Offset:         0x%16.16" PRIx64 "%8s",
-			(uint64_t)(pagemap_info & 0x00ffffffffffffffULL) >> 5, "");
-	} else {
-		(void)mvwprintw(g.mainwin, 10, x, "%48s", "");
-		if (pagemap_info & PAGE_PRESENT) {
-			(void)mvwprintw(g.mainwin, 11, x,
-				" Physical Address:    0x%16.16" PRIx64 "%8s",
-				(uint64_t)(pagemap_info & 0x00ffffffffffffffULL) * g.page_size, "");
-		} else {
-			(void)mvwprintw(g.mainwin, 11, x,
-				" Physical Address:    0x----------------%8s", "");
+	prof_begin(&prof, PROF_VM);
+	if (!pr->opened)
+		pressure_open(pr);
+	secs = pr->sample_ns ? (double)(now - pr->sample_ns) / 1000000000.0 : 0.0;
+
+	len = vm_pread(pr->fd_pressure, pr->buf, sizeof(pr->buf));
+	pr->have_psi = (len > 0);
+	if (pr->have_psi)
+		pressure_parse_psi(pr, (size_t)len);
+	len = vm_pread(pr->fd_stat, pr->buf, sizeof(pr->buf));
+	if (len > 0)
+		pressure_parse_stat(pr, (size_t)len);
+	len = vm_pread(pr->fd_current, pr->buf, sizeof(pr->buf));
+	pr->current = (len > 0) ? vm_u64(pr->buf) : 0;
+	len = vm_pread(pr->fd_max, pr->buf, sizeof(pr->buf));
+	pr->max = ((len > 0) && strncmp(pr->buf, "max", 3)) ? vm_u64(pr->buf) : 0;
+	pressure_changes(pr->changes);
+
+	if (secs > 0.0) {
+		for (i = 0; i < PSTAT_MAX; i++)
+			pr->stat_rate[i] =
+				(double)(pr->stat[i] - pr->prev_stat[i]) / secs;
+		for (i = 0; i < CHANGE_MAX; i++)
+			pr->change_rate[i] =
+				(double)(pr->changes[i] - pr->prev_changes[i]) / secs;
+		pr->some_rate = (double)(pr->some_total - pr->prev_some) / 1000.0 / secs;
+		pr->full_rate = (double)(pr->full_total - pr->prev_full) / 1000.0 / secs;
+
+		if (pr->have_psi && (pr->some_avg10 >= PRESSURE_THRESHOLD)) {
+			pressure_event_t *event = &pr->events[pr->head];
+
+			event->when = time(NULL);
+			event->some = pr->some_avg10;
+			event->full = pr->full_avg10;
+			for (i = 0; i < CHANGE_MAX; i++)
+				event->changes[i] = pr->changes[i] - pr->prev_changes[i];
+			pr->head = (pr->head + 1) % PRESSURE_EVENTS;
+			if (pr->count < PRESSURE_EVENTS)
+				pr->count++;
 		}
 	}
-	(void)mvwprintw(g.mainwin, 12, x,
-		" Soft-dirty PTE:      %3s%23s",
-		(pagemap_info & PAGE_PTE_SOFT_DIRTY) ? "Yes" : "No ", "");
-	(void)mvwprintw(g.mainwin, 13, x,
-		" Exclusively Mapped:  %3s%23s",
-		(pagemap_info & PAGE_EXCLUSIVE_MAPPED) ? "Yes" : "No ", "");
-	(void)mvwprintw(g.mainwin, 14, x,
-		" File or Shared Anon: %3s%23s",
-		(pagemap_info & PAGE_FILE_SHARED_ANON) ? "Yes" : "No ", "");
-	(void)mvwprintw(g.mainwin, 15, x,
-		" Present in Swap:     %3s%23s",
-		(pagemap_info & PAGE_SWAPPED) ? "Yes" : "No ", "");
-	(void)mvwprintw(g.mainwin, 16, x,
-		" Present in RAM:      %3s%23s",
-		(pagemap_info & PAGE_PRESENT) ? "Yes" : "No ", "");
 
-	kfd = open("/proc/kpagecount", O_RDONLY);
-	if (kfd > -1) {
-		uint64_t count;
+	(void)memcpy(pr->prev_stat, pr->stat, sizeof(pr->prev_stat));
+	(void)memcpy(pr->prev_changes, pr->changes, sizeof(pr->prev_changes));
+	pr->prev_some = pr->some_total;
+	pr->prev_full = pr->full_total;
+	pr->sample_ns = now;
+	prof_end(&prof);
+}
 
-		offset = sizeof(count) *
-			(pagemap_info & 0x00ffffffffffffffULL);
+/*
+ *  proc_follow_init()
+ *	follow a process given by pid by the name of argv[0]
+ */
+static int proc_follow_init(const pid_t pid)
+{
+	char path[PROCPATH_MAX], buf[4096], *arg0;
 
-		if (lseek(kfd, offset, SEEK_SET) == (off_t)-1)
-			goto close_kfd;
-		if (read(kfd, &count, sizeof(count)) != sizeof(count)) 
-			goto close_kfd;
-		(void)mvwprintw(g.mainwin, 16, x,
-			" KPageCount:          %-10" PRIu64 "%13s", count, "");
-		
-close_kfd:
-		(void)close(kfd);
+	if (g.match.pattern[0])
+		return 0;
+	(void)snprintf(path, sizeof(path), "/proc/%d/cmdline", pid);
+	if (read_buf(path, buf, sizeof(buf)) < 0) {
+		(void)fprintf(stderr, "Cannot follow kernel thread %d\n", pid);
+		return -1;
 	}
+	arg0 = strrchr(buf, '/');
+	return proc_match_init(&g.match, arg0 ? arg0 + 1 : buf, false);
 }
 
 /*
- *  banner()
- *	clear a banner across the window
+ *  proc_pidfd_open()
+ *	open a pidfd on the process to poll for its exit,
+ *	-1 if the kernel does not support pidfds
  */
-static inline void banner(const int y)
+static int proc_pidfd_open(const pid_t pid)
 {
-	(void)mvwprintw(g.mainwin, y, 0, "%*s", COLS, "");
+#if defined(__NR_pidfd_open)
+	return (int)syscall(__NR_pidfd_open, pid, 0);
+#else
+	(void)pid;
+	return -1;
+#endif
 }
 
 /*
- *  show_pages()
- *	show page mapping
+ *  proc_alive()
+ *	is the process still alive? A pidfd becomes
+ *	readable when the process exits
  */
-static int show_pages(
-	const index_t cursor_index,
-	const index_t page_index,
-	const position_t *const p,
-	const int32_t zoom)
+static inline bool proc_alive(void)
 {
-	int32_t i;
-	index_t idx;
-	const uint32_t shift = ((uint32_t)(8 * sizeof(pagemap_t) - 4 -
-		__builtin_clzll((g.page_size))));
-	int fd;
-	map_t *map;
-	const int32_t xmax = p->xmax, ymax = p->ymax;
-	pagemap_t pagemap_info_buf[xmax];
+	struct pollfd pfd;
 
-	if ((fd = open(g.path_pagemap, O_RDONLY)) < 0)
-		return ERR_NO_MAP_INFO;
+	if (g.offline)
+		return true;
+	if (g.pidfd < 0)
+		return kill(g.pid, 0) == 0;
 
-	idx = page_index;
-	for (i = 1; i <= ymax; i++) {
-		int32_t j;
-		addr_t addr, offset;
-		const size_t sz = sizeof(pagemap_info_buf);
+	pfd.fd = g.pidfd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	return poll(&pfd, 1, 0) == 0;
+}
 
-		if (idx >= (index_t)g.mem_info.npages) {
-			(void)wattrset(g.mainwin, COLOR_PAIR(BLACK_BLACK));
-			(void)mvwprintw(g.mainwin, i, 0, "---------------- ");
-		} else {
-			addr = g.mem_info.pages[idx].addr;
-			(void)wattrset(g.mainwin, COLOR_PAIR(BLACK_WHITE));
-			(void)mvwprintw(g.mainwin, i, 0, "%16.16" PRIx64 " ", addr);
-		}
+/*
+ *  proc_wait()
+ *	wait for wait_ns nanoseconds, returning early
+ *	if the process exits. The poll timeout is rounded
+ *	up to whole milliseconds so it never spins
+ */
+static void proc_wait(const uint64_t wait_ns)
+{
+	struct pollfd pfd;
 
-		/*
-		 *  Slurp up an entire row
-		 */
-		(void)memset(pagemap_info_buf, 0, sz);
+	if (g.pidfd < 0) {
+		struct timespec ts;
 
-		if (idx >= (index_t)g.mem_info.npages) {
-			map = NULL;
-		} else {
-			addr = g.mem_info.pages[idx].addr;
-			map = g.mem_info.pages[idx].map;
-			offset = (addr >> shift) & ~7ULL;
+		ts.tv_sec = (time_t)(wait_ns / 1000000000ULL);
+		ts.tv_nsec = (long)(wait_ns % 1000000000ULL);
+		(void)nanosleep(&ts, NULL);
+		return;
+	}
+	pfd.fd = g.pidfd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	(void)poll(&pfd, 1, (int)((wait_ns + 999999ULL) / 1000000ULL));
+}
 
-			if (lseek(fd, offset, SEEK_SET) != (off_t)-1) {
-				ssize_t ret = read(fd, pagemap_info_buf, sz);
-				(void)ret;
-			}
-		}
+/*
+ *  sched_frame()
+ *	true if the frame deadline *frame_ns has been reached,
+ *	the next deadline is then a whole period_ns on so the
+ *	frame rate keeps to the refresh delay however often
+ *	the loop is woken for sampling tasks, or a period from
+ *	now if drawing the frame fell behind
+ */
+static bool sched_frame(
+	uint64_t *const frame_ns,
+	const uint64_t period_ns,
+	const uint64_t now)
+{
+	if (now < *frame_ns)
+		return false;
+	*frame_ns = (now - *frame_ns >= period_ns) ?
+		now + period_ns : *frame_ns + period_ns;
+	return true;
+}
 
-		for (j = 0; j < xmax; j++) {
-			char state = '.';
-			int attr;
+/*
+ *  sched_wait()
+ *	wait until the next frame at frame_ns, or until the
+ *	earliest sampling task deadline or dirty rate timer
+ *	expiry if that is sooner. Deadlines that have already
+ *	passed belong to tasks the current view does not
+ *	run, so they are skipped
+ */
+static void sched_wait(const uint64_t frame_ns)
+{
+	const uint64_t now = prof_time_ns();
+	uint64_t wake_ns = frame_ns;
+	int i;
 
-			if (idx >= (index_t)g.mem_info.npages) {
-				attr = COLOR_PAIR(BLACK_BLACK);
-				state = '~';
-			} else {
-				map_t *new_map;
-				register pagemap_t pagemap_info;
-
-				new_map = g.mem_info.pages[idx].map;
-				/*
-				 *  On a different mapping? If so, slurp up
-				 *  the new mappings from here to end
-				 */
-				if (new_map != map) {
-					map = new_map;
-					addr = g.mem_info.pages[idx].addr;
-					offset = (addr >> shift) & ~7;
-					if (lseek(fd, offset, SEEK_SET) == (off_t)-1)
-						break;
-					if (read(fd, &pagemap_info_buf[j],
-					    (xmax - j) * sizeof(pagemap_t)) < 0)
-						break;
-				}
+	for (i = 0; i < SCHED_MAX; i++) {
+		const uint64_t next_ns = g.sched[i].next_ns;
 
-				__builtin_prefetch(&g.mem_info.pages[idx + zoom].addr, 1, 1);
+		if ((next_ns > now) && (next_ns < wake_ns))
+			wake_ns = next_ns;
+	}
+	if (g.dirty.started) {
+		struct itimerspec its;
 
-				pagemap_info = pagemap_info_buf[j];
-				attr = COLOR_PAIR(BLACK_WHITE);
-				if (pagemap_info & PAGE_PRESENT) {
-					attr = COLOR_PAIR(WHITE_YELLOW);
-					state = 'P';
-				}
-				if (pagemap_info & PAGE_SWAPPED) {
-					attr = COLOR_PAIR(WHITE_GREEN);
-					state = 'S';
-				}
-				if (pagemap_info & PAGE_FILE_SHARED_ANON) {
-					attr = COLOR_PAIR(WHITE_RED);
-					state = 'M';
-				}
-				if (pagemap_info & PAGE_PTE_SOFT_DIRTY) {
-					attr = COLOR_PAIR(WHITE_CYAN);
-					state = 'D';
-				}
-				idx += zoom;
-			}
-			(void)wattrset(g.mainwin, attr);
-			(void)mvwprintw(g.mainwin, i, ADDR_OFFSET + j, "%c", state);
+		/* it_value is the time left to the next expiry */
+		if (timerfd_gettime(g.dirty.timer_fd, &its) == 0) {
+			const uint64_t left_ns =
+				((uint64_t)its.it_value.tv_sec * 1000000000ULL) +
+				(uint64_t)its.it_value.tv_nsec;
+
+			wake_ns = MINIMUM(wake_ns, now + left_ns);
 		}
 	}
-	(void)wattrset(g.mainwin, A_NORMAL);
+	if (wake_ns > now)
+		proc_wait(wake_ns - now);
+}
 
-	map = g.mem_info.pages[cursor_index].map;
-	if (map && g.tab_view)
-		show_page_bits(fd, map, cursor_index);
-	if (g.vm_view)
-		show_vm();
-#if defined(PERF_ENABLED)
-	if (g.perf_view)
-		show_perf();
-#endif
+/*
+ *  read_thp_usage()
+ *	read anonymous and anonymous huge page sizes in kB
+ */
+static int read_thp_usage(
+	uint64_t *const anon,
+	uint64_t *const anon_huge)
+{
+	char buf[4096];
+	const char *ptr;
 
-	(void)close(fd);
+	*anon = 0;
+	*anon_huge = 0;
+
+	if (read_buf(g.path_smaps_rollup, buf, sizeof(buf)) < 0)
+		return -1;
+	if ((ptr = strstr(buf, "\nAnonymous:")) == NULL)
+		return -1;
+	if (sscanf(ptr, "\nAnonymous: %" SCNu64, anon) != 1)
+		return -1;
+	if ((ptr = strstr(buf, "\nAnonHugePages:")) == NULL)
+		return -1;
+	if (sscanf(ptr, "\nAnonHugePages: %" SCNu64, anon_huge) != 1)
+		return -1;
 	return 0;
 }
 
 /*
- *  show_memory()
- *	show memory contents
+ *  intern_hash()
+ *	FNV-1a hash of a string
  */
-static int show_memory(
-	const index_t page_index,
-	index_t data_index,
-	const position_t *const p)
+static inline uint32_t intern_hash(const char *str, const size_t len)
 {
-	addr_t addr;
+	uint32_t hash = 2166136261U;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (uint8_t)str[i];
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+/*
+ *  intern_reset()
+ *	empty the string arena
+ */
+static void intern_reset(intern_t *in)
+{
+	if (in->hash)
+		(void)memset(in->hash, 0, in->hash_size * sizeof(*in->hash));
+	in->used = 1;
+	in->count = 0;
+}
+
+/*
+ *  intern_grow_hash()
+ *	double the hash table size and rehash
+ */
+static int intern_grow_hash(intern_t *in)
+{
+	const uint32_t size = in->hash_size ? in->hash_size * 2 : INTERN_HASH_MIN;
+	uint32_t *hash, i;
+
+	hash = calloc(size, sizeof(*hash));
+	if (!hash)
+		return -1;
+	for (i = 0; i < in->hash_size; i++) {
+		const uint32_t offset = in->hash[i];
+		uint32_t h;
+
+		if (!offset)
+			continue;
+		h = intern_hash(in->buf + offset, strlen(in->buf + offset));
+		while (hash[h & (size - 1)])
+			h++;
+		hash[h & (size - 1)] = offset;
+	}
+	free(in->hash);
+	in->hash = hash;
+	in->hash_size = size;
+	return 0;
+}
+
+/*
+ *  intern()
+ *	return arena offset of a string, adding it to
+ *	the arena if it is not already there. Returns
+ *	0 (the empty string) on allocation failure
+ */
+static uint32_t intern(intern_t *in, const char *str, const size_t len)
+{
+	uint32_t h, offset;
+
+	if (!len)
+		return 0;
+	if (!in->used)
+		in->used = 1;
+	if ((in->count + 1) * 2 > in->hash_size) {
+		if (intern_grow_hash(in) < 0)
+			return 0;
+	}
+	h = intern_hash(str, len);
+	for (;;) {
+		offset = in->hash[h & (in->hash_size - 1)];
+		if (!offset)
+			break;
+		if (!strncmp(in->buf + offset, str, len) &&
+		    (in->buf[offset + len] == '\0'))
+			return offset;
+		h++;
+	}
+	if (in->used + len + 1 > in->size) {
+		const size_t size = MAXIMUM(in->size * 2, in->used + len + 1);
+		char *buf = realloc(in->buf, size);
+
+		if (!buf)
+			return 0;
+		if (!in->size)
+			buf[0] = '\0';
+		in->buf = buf;
+		in->size = size;
+	}
+	offset = (uint32_t)in->used;
+	(void)memcpy(in->buf + offset, str, len);
+	in->buf[offset + len] = '\0';
+	in->used += len + 1;
+	in->count++;
+	in->hash[h & (in->hash_size - 1)] = offset;
+
+	return offset;
+}
+
+/*
+ *  map_name()
+ *	name of a mapping, empty if anonymous
+ */
+static inline const char *map_name(const map_t *map)
+{
+	const map_info_t *info = &g.mem_info.map_info[map - g.mem_info.maps];
+
+	return info->name ? g.mem_info.names.buf + info->name : "";
+}
+
+/*
+ *  map_basename()
+ *	basename of a mapping name, [Anonymous] if no name
+ */
+static inline const char *map_basename(const map_t *map)
+{
+	const char *name = map_name(map);
+	const char *ptr = strrchr(name, '/');
+
+	if (*name == '\0')
+		return "[Anonymous]";
+	return ptr ? ptr + 1 : name;
+}
+
+/*
+ *  map_dev()
+ *	device of a mapping
+ */
+static inline const char *map_dev(const map_t *map)
+{
+	return g.mem_info.map_info[map - g.mem_info.maps].dev;
+}
+
+/*
+ *  maps_grow()
+ *	grow the mapping tables, the page table holds
+ *	pointers to the mappings so it has to be rebuilt
+ */
+static int maps_grow(void)
+{
+	const uint32_t size = g.mem_info.maps_size + MAPS_CHUNK;
+	map_t *maps;
+	map_info_t *map_info;
+
+	maps = realloc(g.mem_info.maps, size * sizeof(*maps));
+	if (!maps)
+		return -1;
+	g.mem_info.maps = maps;
+	map_info = realloc(g.mem_info.map_info, size * sizeof(*map_info));
+	if (!map_info)
+		return -1;
+	g.mem_info.map_info = map_info;
+	g.mem_info.maps_size = size;
+	g.prev_checksum = 0;
+
+	return 0;
+}
+
+/*
+ *  read_file()
+ *	read the whole of a file into a reusable buffer
+ *	that is grown as required, with as few large reads
+ *	as possible, returns length read, or -1 on failure
+ */
+static ssize_t read_file(const char *path, char **const buffer, size_t *const buffer_size)
+{
+	size_t len = 0;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return -1;
+	for (;;) {
+		ssize_t ret;
+
+		/* Always leave space for a terminating nul */
+		if (len + 1 >= *buffer_size) {
+			const size_t size = *buffer_size ?
+				*buffer_size * 2 : MAPS_BUF_MIN;
+			char *buf = realloc(*buffer, size);
+
+			if (!buf) {
+				(void)close(fd);
+				return -1;
+			}
+			*buffer = buf;
+			*buffer_size = size;
+		}
+		ret = read(fd, *buffer + len, *buffer_size - len - 1);
+		prof_syscall(ret);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			(void)close(fd);
+			return -1;
+		}
+		if (ret == 0)
+			break;
+		len += (size_t)ret;
+	}
+	(void)close(fd);
+	(*buffer)[len] = '\0';
+
+	return (ssize_t)len;
+}
+
+/*
+ *  maps_read()
+ *	read the whole of the maps file into the reusable
+ *	maps buffer, returns length read, or -1 on failure
+ */
+static inline ssize_t maps_read(void)
+{
+	return read_file(g.path_maps, &g.mem_info.buf, &g.mem_info.buf_size);
+}
+
+/*
+ *  maps_hash()
+ *	64 bit hash of the maps text, hashes 8 bytes at
+ *	a time with a multiply/rotate mix and a final
+ *	avalanche so any change in the maps is caught
+ */
+static checksum_t maps_hash(const char *buf, const size_t len)
+{
+	checksum_t hash = (checksum_t)len * 0x9e3779b97f4a7c15ULL;
+	uint64_t v;
+	size_t i;
+
+	for (i = 0; i + sizeof(v) <= len; i += sizeof(v)) {
+		(void)memcpy(&v, buf + i, sizeof(v));
+		v *= 0x87c37b91114253d5ULL;
+		v = (v << 31) | (v >> 33);
+		hash ^= v * 0x4cf5ad432745937fULL;
+		hash = ((hash << 27) | (hash >> 37)) * 5 + 0x52dce729;
+	}
+	if (i < len) {
+		v = 0;
+		(void)memcpy(&v, buf + i, len - i);
+		v *= 0x87c37b91114253d5ULL;
+		v = (v << 31) | (v >> 33);
+		hash ^= v * 0x4cf5ad432745937fULL;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
+
+	return hash;
+}
+
+/*
+ *  maps_hex()
+ *	parse a hex field, stops at the first non hex digit
+ */
+static inline const char *maps_hex(const char *ptr, uint64_t *val)
+{
+	uint64_t v = 0;
+
+	for (;;) {
+		const uint8_t ch = (uint8_t)*ptr;
+		uint8_t d = ch - '0';
+
+		if (d > 9) {
+			d = (uint8_t)((ch | 0x20) - 'a');
+			if (d > 5)
+				break;
+			d += 10;
+		}
+		v = (v << 4) | d;
+		ptr++;
+	}
+	*val = v;
+	return ptr;
+}
+
+/*
+ *  maps_field()
+ *	skip to the end of a space separated field
+ */
+static inline const char *maps_field(const char *ptr, const char *end)
+{
+	while ((ptr < end) && (*ptr != ' '))
+		ptr++;
+	return ptr;
+}
+
+/*
+ *  maps_parse()
+ *	parse maps text into the mapping tables, no
+ *	allocations are made unless the tables need to
+ *	grow or a new name is interned. Returns the
+ *	number of mappings or a negative error
+ */
+static int maps_parse(const char *buf, const size_t len)
+{
+	const char *ptr = buf, *const buf_end = buf + len;
+	uint32_t n = 0;
+
+	g.mem_info.npages = 0;
+	g.mem_info.last_addr = 0;
+
+	/* Names are all re-interned below, so it is safe to reset */
+	if (g.mem_info.names.used > INTERN_MAX)
+		intern_reset(&g.mem_info.names);
+
+	/*
+	 *  Each line is:
+	 *  begin-end attr offset dev inode [name]
+	 */
+	for (; ptr < buf_end; ptr++) {
+		const char *eol, *field;
+		map_t *map;
+		map_info_t *info;
+		size_t field_len;
+		addr_t length;
+
+		eol = memchr(ptr, '\n', (size_t)(buf_end - ptr));
+		if (!eol)
+			eol = buf_end;
+
+		if ((n >= g.mem_info.maps_size) && (maps_grow() < 0))
+			return ERR_ALLOC_NOMEM;
+		map = &g.mem_info.maps[n];
+		info = &g.mem_info.map_info[n];
+
+		ptr = maps_hex(ptr, &map->begin);
+		if (*ptr != '-')
+			goto next;
+		ptr = maps_hex(ptr + 1, &map->end);
+		if ((*ptr != ' ') || (eol - ptr < 6))
+			goto next;
+		(void)memcpy(map->attr, ptr + 1, 4);
+		map->attr[4] = '\0';
+
+		/* Offset, dev and inode */
+		ptr = maps_hex(ptr + 6, &info->offset);
+		field = ptr + 1;
+		ptr = maps_field(field, eol);
+		if (ptr >= eol)
+			goto next;
+		field_len = MINIMUM((size_t)(ptr - field), sizeof(info->dev) - 1);
+		(void)memcpy(info->dev, field, field_len);
+		info->dev[field_len] = '\0';
+		info->inode = vm_u64(ptr + 1);
+		ptr = maps_field(ptr + 1, eol);
+
+		/* Name is the rest of the line after the padding */
+		while ((ptr < eol) && (*ptr == ' '))
+			ptr++;
+		info->name = intern(&g.mem_info.names, ptr, (size_t)(eol - ptr));
+
+		/* Simple sanity check */
+		if (map->end < map->begin)
+			goto next;
+
+		length = map->end - map->begin;
+		/* Check for overflow */
+		if (g.mem_info.npages + length < g.mem_info.npages)
+			goto next;
+
+		if (g.mem_info.last_addr < map->end)
+			g.mem_info.last_addr = map->end;
+
+		g.mem_info.npages += length / g.page_size;
+		n++;
+next:
+		ptr = eol;
+	}
+	return (int)n;
+}
+
+/*
+ *  page_state()
+ *	state of a page from its pagemap entry
+ */
+static inline uint8_t page_state(const pagemap_t pagemap_info)
+{
+	if (pagemap_info & PAGE_PTE_SOFT_DIRTY)
+		return PAGE_STATE_DIRTY;
+	if (pagemap_info & PAGE_FILE_SHARED_ANON)
+		return PAGE_STATE_MAPPED;
+	if (pagemap_info & PAGE_SWAPPED)
+		return PAGE_STATE_SWAPPED;
+	if (pagemap_info & PAGE_PRESENT)
+		return PAGE_STATE_PRESENT;
+	return PAGE_STATE_NOT_PRESENT;
+}
+
+/*
+ *  page_residency()
+ *	where a page is from the present and swapped bits
+ *	alone, PAGE_STATE_PRESENT, SWAPPED or NOT_PRESENT.
+ *	Unlike page_state() a soft dirty or file mapped page
+ *	is not mistaken for one in RAM
+ */
+static inline uint8_t page_residency(const pagemap_t pagemap_info)
+{
+	if (pagemap_info & PAGE_PRESENT)
+		return PAGE_STATE_PRESENT;
+	if (pagemap_info & PAGE_SWAPPED)
+		return PAGE_STATE_SWAPPED;
+	return PAGE_STATE_NOT_PRESENT;
+}
+
+/*
+ *  pyramid_free()
+ *	free the page state pyramid
+ */
+static void pyramid_free(pyramid_t *const py)
+{
+	uint32_t l;
+
+	free(py->states);
+	py->states = NULL;
+	free(py->resident);
+	py->resident = NULL;
+	for (l = 0; l < PYRAMID_LEVELS; l++) {
+		free(py->counts[l]);
+		py->counts[l] = NULL;
+	}
+	py->levels = 0;
+	py->npages = 0;
+}
+
+/*
+ *  pages_carry()
+ *	copy the per page values of size bytes in old, indexed
+ *	like old_pages, to new for the pages that are still
+ *	mapped, the values of new pages are left as they are
+ */
+static void pages_carry(
+	const page_t *const old_pages,
+	const addr_t old_npages,
+	const void *const old,
+	void *const new,
+	const size_t size)
+{
+	const addr_t npages = g.mem_info.npages;
+	addr_t i, j;
+
+	if (!old_pages || !old)
+		return;
+
+	/* Both page tables are in address order */
+	for (i = 0, j = 0; i < npages; i++) {
+		const addr_t addr = g.mem_info.pages[i].addr;
+
+		while ((j < old_npages) && (old_pages[j].addr < addr))
+			j++;
+		if (j == old_npages)
+			break;
+		if (old_pages[j].addr == addr)
+			(void)memcpy((uint8_t *)new + (i * size),
+				(const uint8_t *)old + (j * size), size);
+	}
+}
+
+/*
+ *  pyramid_build()
+ *	build the page state pyramid for the current pages,
+ *	carrying over the states of pages that were in the
+ *	old pages so they do not have to be sampled again
+ */
+static int pyramid_build(const page_t *const old_pages, const addr_t old_npages)
+{
+	pyramid_t *const py = &g.mem_info.pyramid;
+	const addr_t npages = g.mem_info.npages;
+	const uint8_t *const old_states = py->states;
+	const uint8_t *const old_resident = py->resident;
+	uint8_t *states, *resident;
+	addr_t i, j, nblocks = npages;
+	uint32_t l;
+
+	states = malloc(npages);
+	resident = malloc(npages);
+	if (!states || !resident) {
+		free(states);
+		free(resident);
+		return ERR_ALLOC_NOMEM;
+	}
+
+	/* Both page tables are in address order */
+	for (i = 0, j = 0; i < npages; i++) {
+		const addr_t addr = g.mem_info.pages[i].addr;
+		bool carry;
+
+		while ((j < old_npages) && (old_pages[j].addr < addr))
+			j++;
+		carry = old_states && (j < old_npages) &&
+			(old_pages[j].addr == addr);
+		states[i] = carry ? old_states[j] : PAGE_STATE_NOT_PRESENT;
+		resident[i] = carry ? old_resident[j] : PAGE_STATE_NOT_PRESENT;
+	}
+	pyramid_free(py);
+	py->states = states;
+	py->resident = resident;
+	py->npages = npages;
+
+	for (l = 0; l < PYRAMID_LEVELS; l++) {
+		const uint32_t shift = (l + 1) * PYRAMID_SHIFT;
+		const addr_t prev_nblocks = nblocks;
+
+		/* No point in a level if the one below is one block */
+		if (l && (prev_nblocks == 1))
+			break;
+		nblocks = ((npages - 1) >> shift) + 1;
+		py->counts[l] = calloc(nblocks, sizeof(*py->counts[l]));
+		if (!py->counts[l])
+			return ERR_ALLOC_NOMEM;
+		if (l == 0) {
+			for (i = 0; i < npages; i++)
+				py->counts[0][i >> PYRAMID_SHIFT][states[i]]++;
+		} else {
+			for (i = 0; i < prev_nblocks; i++) {
+				for (j = 0; j < PAGE_STATE_MAX; j++)
+					py->counts[l][i >> PYRAMID_SHIFT][j] +=
+						py->counts[l - 1][i][j];
+			}
+		}
+		py->levels = l + 1;
+	}
+	if (py->next >= (index_t)npages)
+		py->next = 0;
+	if (py->view_next >= (index_t)npages)
+		py->view_next = 0;
+
+	return OK;
+}
+
+/*
+ *  pyramid_set()
+ *	set the state of a page from its pagemap entry,
+ *	updating the counts of the blocks it is in
+ */
+static inline void pyramid_set(const index_t idx, const pagemap_t pm)
+{
+	pyramid_t *const py = &g.mem_info.pyramid;
+	const uint8_t old = py->states[idx];
+	const uint8_t state = page_state(pm);
+	const uint8_t res = page_residency(pm);
+	uint32_t l;
+
+	if (py->resident[idx] != res) {
+		py->changes[py->resident[idx]][res]++;
+		py->resident[idx] = res;
+	}
+	if (old == state)
+		return;
+	py->states[idx] = state;
+	for (l = 0; l < py->levels; l++) {
+		uint32_t *n = py->counts[l][idx >> ((l + 1) * PYRAMID_SHIFT)];
+
+		n[old]--;
+		n[state]++;
+	}
+}
+
+/*
+ *  pyramid_count()
+ *	add the page state counts of pages begin..end-1,
+ *	using the largest aligned blocks that fit
+ */
+static void pyramid_count(
+	index_t begin,
+	const index_t end,
+	page_counts_t *const counts)
+{
+	const pyramid_t *const py = &g.mem_info.pyramid;
+
+	while (begin < end) {
+		uint32_t l = 0, s;
+
+		while (l < py->levels) {
+			const index_t size = (index_t)1 << ((l + 1) * PYRAMID_SHIFT);
+
+			if ((begin & (size - 1)) || (begin + size > end))
+				break;
+			l++;
+		}
+		if (l == 0) {
+			counts->n[py->states[begin]]++;
+			begin++;
+		} else {
+			const uint32_t shift = l * PYRAMID_SHIFT;
+			const uint32_t *n = py->counts[l - 1][begin >> shift];
+
+			for (s = 0; s < PAGE_STATE_MAX; s++)
+				counts->n[s] += n[s];
+			begin += (index_t)1 << shift;
+		}
+	}
+}
+
+/*
+ *  pyramid_sample()
+ *	read the pagemap of pages begin..end-1 and
+ *	update the page state pyramid
+ */
+static void pyramid_sample(const int fd, const index_t begin, const index_t end)
+{
+	pagemap_t buf[PYRAMID_READ];
+	index_t idx = begin;
+
+	while (idx < end) {
+		const page_t *page = &g.mem_info.pages[idx];
+		const map_t *map = page->map;
+		const index_t map_end = map->first +
+			(index_t)((map->end - map->begin) / g.page_size);
+		const index_t n = MINIMUM(MINIMUM(end, map_end) - idx,
+			PYRAMID_READ);
+		ssize_t ret;
+		index_t k;
+
+		ret = pread(fd, buf, (size_t)n * sizeof(pagemap_t),
+			(off_t)((page->addr / g.page_size) * sizeof(pagemap_t)));
+		prof_syscall(ret);
+		for (k = 0; k < (index_t)(ret / (ssize_t)sizeof(pagemap_t)); k++)
+			pyramid_set(idx + k, buf[k]);
+		idx += n;
+	}
+}
+
+/*
+ *  pyramid_sample_rr()
+ *	sample up to budget pages of begin..end-1 round
+ *	robin, carrying on from where we left off
+ */
+static void pyramid_sample_rr(
+	const int fd,
+	index_t *const next,
+	const index_t begin,
+	const index_t end,
+	const index_t budget)
+{
+	const index_t from = ((*next < begin) || (*next >= end)) ? begin : *next;
+	const index_t to = MINIMUM(end, from + budget);
+
+	pyramid_sample(fd, from, to);
+	*next = (to >= end) ? begin : to;
+}
+
+/*
+ *  numa_move_pages()
+ *	move n pages of a process to nodes, or with
+ *	no nodes just query the nodes they are on
+ */
+static long numa_move_pages(
+	const pid_t pid,
+	const unsigned long n,
+	void **const addrs,
+	const int *const nodes,
+	int *const status,
+	const int flags)
+{
+#if defined(__NR_move_pages)
+	return syscall(__NR_move_pages, pid, n, addrs, nodes, status, flags);
+#else
+	(void)pid;
+	(void)n;
+	(void)addrs;
+	(void)nodes;
+	(void)status;
+	(void)flags;
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/*
+ *  numa_free()
+ *	free the page nodes, they are re-queried
+ *	when the process changes
+ */
+static void numa_free(void)
+{
+	free(g.numa.nodes);
+	g.numa.nodes = NULL;
+	g.numa.npages = 0;
+}
+
+/*
+ *  numa_alloc()
+ *	allocate the node of each page, all unknown
+ */
+static int numa_alloc(void)
+{
+	numa_t *const numa = &g.numa;
+
+	if (numa->nodes && (numa->npages == g.mem_info.npages))
+		return 0;
+	numa_free();
+	numa->nodes = malloc(g.mem_info.npages);
+	if (!numa->nodes)
+		return -1;
+	(void)memset(numa->nodes, NUMA_NODE_NONE, g.mem_info.npages);
+	numa->npages = g.mem_info.npages;
+	numa->next = 0;
+	numa->view_next = 0;
+	return 0;
+}
+
+/*
+ *  numa_carry()
+ *	reallocate the page nodes for the current pages,
+ *	keeping the nodes of the pages that are still mapped
+ */
+static int numa_carry(const page_t *const old_pages, const addr_t old_npages)
+{
+	numa_t *const numa = &g.numa;
+	uint8_t *nodes;
+
+	if (!numa->nodes)
+		return 0;
+	nodes = malloc(g.mem_info.npages);
+	if (!nodes) {
+		numa_free();
+		return -1;
+	}
+	(void)memset(nodes, NUMA_NODE_NONE, g.mem_info.npages);
+	pages_carry(old_pages, old_npages, numa->nodes, nodes, sizeof(*nodes));
+	free(numa->nodes);
+	numa->nodes = nodes;
+	numa->npages = g.mem_info.npages;
+	return 0;
+}
+
+/*
+ *  numa_query()
+ *	query the nodes of pages begin..end-1 in batches,
+ *	pages the pyramid has as not in RAM are skipped
+ */
+static void numa_query(const index_t begin, const index_t end)
+{
+	const uint8_t *const states = g.mem_info.pyramid.states;
+	void *addrs[NUMA_BATCH];
+	int status[NUMA_BATCH];
+	index_t idxs[NUMA_BATCH], idx = begin;
+
+	while (idx < end) {
+		unsigned long n = 0, k;
+		long ret;
+
+		for (; (idx < end) && (n < NUMA_BATCH); idx++) {
+			if ((states[idx] == PAGE_STATE_NOT_PRESENT) ||
+			    (states[idx] == PAGE_STATE_SWAPPED)) {
+				g.numa.nodes[idx] = NUMA_NODE_NONE;
+				continue;
+			}
+			addrs[n] = (void *)(uintptr_t)g.mem_info.pages[idx].addr;
+			idxs[n++] = idx;
+		}
+		if (!n)
+			break;
+		ret = numa_move_pages(g.pid, n, addrs, NULL, status, 0);
+		prof_syscall(0);
+		for (k = 0; k < n; k++) {
+			g.numa.nodes[idxs[k]] =
+				((ret < 0) || (status[k] < 0) ||
+				 (status[k] >= NUMA_NODE_NONE)) ?
+				NUMA_NODE_NONE : (uint8_t)status[k];
+		}
+	}
+}
+
+/*
+ *  numa_query_rr()
+ *	query up to budget pages of begin..end-1 round
+ *	robin, carrying on from where we left off
+ */
+static void numa_query_rr(
+	index_t *const next,
+	const index_t begin,
+	const index_t end,
+	const index_t budget)
+{
+	const index_t from = ((*next < begin) || (*next >= end)) ? begin : *next;
+	const index_t to = MINIMUM(end, from + budget);
+
+	numa_query(from, to);
+	*next = (to >= end) ? begin : to;
+}
+
+/*
+ *  numa_sample_frame()
+ *	per frame NUMA node queries of the visible pages
+ *	begin..end-1 and then a few of the rest, bounded
+ *	like the page state sampling
+ */
+static void numa_sample_frame(const index_t begin, const index_t end)
+{
+	numa_t *const numa = &g.numa;
+	prof_t prof;
+
+	if (!g.numa_view || g.offline || (numa_alloc() < 0))
+		return;
+
+	prof_begin(&prof, PROF_NUMA);
+	if (end - begin <= NUMA_VIEW_BUDGET)
+		numa_query(begin, end);
+	else
+		numa_query_rr(&numa->view_next, begin, end, NUMA_VIEW_BUDGET);
+	numa_query_rr(&numa->next, 0, (index_t)g.mem_info.npages,
+		NUMA_BG_BUDGET);
+	prof_end(&prof);
+}
+
+/*
+ *  pyramid_sample_frame()
+ *	per frame sampling, the visible pages begin..end-1
+ *	are sampled first and then a few of the rest so
+ *	other zoom levels are kept up to date. Both are
+ *	bounded so a frame costs the same at any zoom
+ */
+static void pyramid_sample_frame(const index_t begin, const index_t end)
+{
+	pyramid_t *const py = &g.mem_info.pyramid;
+	prof_t prof;
+	int fd;
+
+	prof_begin(&prof, PROF_PAGEMAP);
+	if ((fd = open(g.path_pagemap, O_RDONLY)) < 0) {
+		prof_end(&prof);
+		return;
+	}
+	prof_syscall(0);
+	if (end - begin <= PYRAMID_VIEW_BUDGET)
+		pyramid_sample(fd, begin, end);
+	else
+		pyramid_sample_rr(fd, &py->view_next, begin, end,
+			PYRAMID_VIEW_BUDGET);
+	pyramid_sample_rr(fd, &py->next, 0, (index_t)g.mem_info.npages,
+		PYRAMID_BG_BUDGET);
+	(void)close(fd);
+	prof_syscall(0);
+	prof_end(&prof);
+
+	numa_sample_frame(begin, end);
+}
+
+/*
+ *  pyramid_sample_all()
+ *	sample all the pages
+ */
+static void pyramid_sample_all(void)
+{
+	int fd;
+
+	if ((fd = open(g.path_pagemap, O_RDONLY)) < 0)
+		return;
+	pyramid_sample(fd, 0, (index_t)g.mem_info.npages);
+	(void)close(fd);
+}
+
+#if defined(PERF_ENABLED)
+/*
+ *  faults_carry()
+ *	reallocate the fault counts for the current pages,
+ *	keeping the counts of the pages that are still mapped
+ */
+static int faults_carry(const page_t *const old_pages, const addr_t old_npages)
+{
+	uint32_t *faults;
+	addr_t i;
+
+	faults = calloc(g.mem_info.npages, sizeof(*faults));
+	if (!faults)
+		return -1;
+	pages_carry(old_pages, old_npages, g.faults, faults, sizeof(*faults));
+	free(g.faults);
+	g.faults = faults;
+
+	g.faults_max = 0;
+	for (i = 0; i < g.mem_info.npages; i++) {
+		if (faults[i] > g.faults_max)
+			g.faults_max = faults[i];
+	}
+	return 0;
+}
+#endif
+
+/*
+ *  read_maps()
+ *	read memory maps for a specific process
+ */
+static int read_maps(const bool force)
+{
+	uint32_t i, j;
+	ssize_t len;
+	int n, ret;
+	page_t *page, *old_pages;
+	const addr_t old_npages = g.mem_info.pyramid.npages;
+	checksum_t checksum;
+	map_t *map;
+
+	if (!proc_alive())
+		return ERR_NO_PROCESS;
+	if (force)
+		g.prev_checksum = 0;
+
+	len = maps_read();
+	if (len < 0)
+		return ERR_NO_MAP_INFO;
+	checksum = maps_hash(g.mem_info.buf, (size_t)len);
+	g.checksum = checksum;
+
+	/* No change in maps, so nothing to do */
+	if (g.checksum == g.prev_checksum)
+		return OK;
+
+	n = maps_parse(g.mem_info.buf, (size_t)len);
+	if (n < 0) {
+		g.mem_info.nmaps = 0;
+		g.mem_info.npages = 0;
+		return n;
+	}
+	g.mem_info.nmaps = (uint32_t)n;
+	g.prev_checksum = checksum;
+
+	/* Unlikely, but need to keep Coverity Scan happy */
+	if (g.mem_info.npages > g.max_pages)
+		return ERR_TOO_MANY_PAGES;
+	if (g.mem_info.npages == 0)
+		return ERR_TOO_FEW_PAGES;
+
+	/* Old pages are kept to carry over the sampled page states */
+	old_pages = g.mem_info.pages;
+	g.mem_info.pages = calloc(g.mem_info.npages, sizeof(page_t));
+	if (!g.mem_info.pages) {
+		free(old_pages);
+		g.mem_info.nmaps = 0;
+		return ERR_ALLOC_NOMEM;
+	}
+
+	map = g.mem_info.maps;
+	page = g.mem_info.pages;
+	for (i = 0; i < g.mem_info.nmaps; i++, map++) {
+		addr_t addr = map->begin;
+		addr_t count = (map->end - map->begin) / g.page_size;
+
+		map->first = page - g.mem_info.pages;
+		for (j = 0; j < count; j++, page++) {
+			page->addr = addr;
+			page->map = map;
+			page->index = i;
+			addr += g.page_size;
+		}
+	}
+
+#if defined(PERF_ENABLED)
+	/* Fault counts of the pages still mapped are carried over */
+	if (faults_carry(old_pages, old_npages) < 0) {
+		free(old_pages);
+		return ERR_ALLOC_NOMEM;
+	}
+#endif
+	/* Nodes of the pages still mapped are carried over */
+	if (numa_carry(old_pages, old_npages) < 0) {
+		free(old_pages);
+		return ERR_ALLOC_NOMEM;
+	}
+	ret = pyramid_build(old_pages, old_npages);
+	free(old_pages);
+	if (ret < 0)
+		return ret;
+	/* Nothing to carry over the first time, so sample everything */
+	if (!old_pages)
+		pyramid_sample_all();
+
+	return (n == 0) ? ERR_NO_MAP_INFO : OK;
+}
+
+/*
+ *  map_lookup()
+ *	find the first mapping that ends after addr,
+ *	nmaps if there are none
+ */
+static uint32_t map_lookup(const addr_t addr)
+{
+	uint32_t lo = 0, hi = g.mem_info.nmaps;
+
+	while (lo < hi) {
+		const uint32_t mid = lo + ((hi - lo) >> 1);
+
+		if (addr >= g.mem_info.maps[mid].end)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/*
+ *  addr_to_index()
+ *	find page index of an address, -1 if it
+ *	is not in any of the mappings
+ */
+static index_t addr_to_index(const addr_t addr)
+{
+	const uint32_t i = map_lookup(addr);
+	const map_t *map = &g.mem_info.maps[i];
+
+	if ((i >= g.mem_info.nmaps) || (addr < map->begin))
+		return -1;
+	return map->first + (index_t)((addr - map->begin) / g.page_size);
+}
+
+#if defined(PERF_ENABLED)
+
+/*
+ *  fault_bin()
+ *	perf sample callback, bin fault address into
+ *	the per page fault counters
+ */
+static void fault_bin(const uint64_t addr, void *arg)
+{
+	const index_t idx = addr_to_index((addr_t)addr);
+	uint32_t count;
+
+	(void)arg;
+
+	if ((idx < 0) || (idx >= (index_t)g.mem_info.npages))
+		return;
+	count = g.faults[idx];
+	if (count < UINT32_MAX)
+		count++;
+	g.faults[idx] = count;
+	if (count > g.faults_max)
+		g.faults_max = count;
+}
+
+/*
+ *  faults_decay()
+ *	halve the fault counts so the hottest pages
+ *	reflect recent fault activity
+ */
+static void faults_decay(void)
+{
+	index_t idx;
+
+	if (!g.faults || !g.faults_max)
+		return;
+	for (idx = 0; idx < (index_t)g.mem_info.npages; idx++)
+		g.faults[idx] >>= 1;
+	g.faults_max >>= 1;
+}
+
+/*
+ *  faults_count()
+ *	add the sampled faults of pages begin..end-1
+ */
+static inline void faults_count(
+	const index_t begin,
+	const index_t end,
+	page_counts_t *const counts)
+{
+	index_t idx;
+
+	if (!g.fault_view || !g.faults)
+		return;
+	for (idx = begin; idx < end; idx++)
+		counts->faults += g.faults[idx];
+}
+#endif
+
+/*
+ *  handle_winch()
+ *	handle SIGWINCH, flag a window resize
+ */
+static void handle_winch(int sig)
+{
+	(void)sig;
+
+	g.resized = true;
+}
+
+/*
+ *  handle_terminate()
+ *	handle termination signals
+ */
+static void handle_terminate(int sig)
+{
+	static bool already_handled = false;
+
+	(void)sig;
+
+	if (already_handled)
+		exit(EXIT_FAILURE);
+
+	g.terminate = true;
+	siglongjmp(g.env, 1);
+}
+
+/*
+ *  handle_stop()
+ *	stop serving metrics or the direct ANSI
+ *	output on SIGINT, SIGTERM or SIGHUP
+ */
+static void handle_stop(int sig)
+{
+	(void)sig;
+
+	g.terminate = true;
+}
+
+/*
+ *  show_usage()
+ *	mini help info
+ */
+static void show_usage(void)
+{
+	(void)printf(APP_NAME ", version " VERSION "\n\n"
+		"Usage: " APP_NAME " [options]\n"
+		" -a        enable automatic zoom mode\n"
+		" -A bytes  direct ANSI output of changed cells, at most bytes\n"
+		"           per frame, 0 for no limit\n"
+		" -d        delay in microseconds between refreshes, "
+			"default %u\n"
+#if defined(PERF_ENABLED)
+		" -e events comma separated perf events, default, all or\n"
+		"           system/event tracepoints, -e list to list events\n"
+#endif
+		" -h        help\n"
+		" -i ms     dirty rate interval in milliseconds, default %u\n"
+		" -L path   log the dirty rate of each interval to CSV file path\n"
+		" -B MB/s   link bandwidth for the pre-copy estimate, default %u\n"
+		" -p pid    process ID or name to monitor\n"
+		" -P regex  monitor a process with a matching command line\n"
+		" -F        follow the process, reattach when it restarts\n"
+		" -C dir    capture /proc files of process into dir and exit\n"
+		" -X        stop the process while capturing with -C\n"
+		" -f dir    read captured /proc files from dir\n"
+		" -r        read (page back in) pages at start\n"
+		" -S path   serve Prometheus metrics on Unix socket path\n"
+		" -M name   publish page states in shared memory /name\n"
+		" -D        serve metrics and snapshots only, no curses UI\n"
+		" -s        dump self profiling stats on exit\n"
+		" -t ticks  ticks between dirty page checks\n"
+		" -T list   sampling periods in milliseconds, e.g.\n"
+		"           maps=1000,pagemap=15,refs=900,vm=1000,perf=1000\n"
+		" -v        enable VM view\n"
+		" -z zoom   set page zoom scale\n",
+		DEFAULT_UDELAY, DIRTY_INTERVAL_MS, DIRTY_LINK_MBS);
+}
+
+#if defined(PERF_ENABLED)
+/*
+ *  show_perf()
+ *	show perf stats
+ */
+static void show_perf(void)
+{
+	int i, y = LINES - 3 - g.perf.perf_opened;
+	const int x = 2;
+	uint64_t anon, anon_huge;
+
+	if (g.perf_hw.perf_opened) {
+		y -= g.perf_hw.perf_opened + 2;
+		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
+		(void)mvwprintw(g.mainwin, y++, x,
+			" %-27s %15s %12s ", "", "Total", "Per Second");
+		for (i = 0; i < g.perf_hw.perf_events; i++) {
+			if (!perf_available(&g.perf_hw, i))
+				continue;
+			(void)mvwprintw(g.mainwin, y++, x,
+				" %-27.27s %15" PRIu64 " %12.1f ",
+				perf_label(&g.perf_hw, i),
+				perf_counter(&g.perf_hw, i),
+				perf_rate(&g.perf_hw, i));
+		}
+		if (!read_thp_usage(&anon, &anon_huge)) {
+			(void)mvwprintw(g.mainwin, y++, x,
+				" THP Anon Coverage:          %12" PRIu64
+				" kB %11.1f%% ", anon_huge,
+				anon ? 100.0 * anon_huge / anon : 0.0);
+		} else {
+			(void)mvwprintw(g.mainwin, y++, x,
+				" THP Anon Coverage:          %15s %12s ",
+				"-", "-");
+		}
+	}
+
+	(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_CYAN) | A_BOLD);
+	(void)mvwprintw(g.mainwin, y++, x,
+		" %-27s %15s %12s ", "", "Total", "Per Second");
+	for (i = 0; i < g.perf.perf_events; i++) {
+		if (!perf_available(&g.perf, i))
+			continue;
+		(void)mvwprintw(g.mainwin, y++, x,
+			" %-27.27s %15" PRIu64 " %12.1f ",
+			perf_label(&g.perf, i),
+			perf_counter(&g.perf, i),
+			perf_rate(&g.perf, i));
+	}
+}
+#endif
+
+/*
+ *  show_sparkline()
+ *	draw the last VM_SAMPLES samples of a series
+ *	as a sparkline, each column being the maximum
+ *	of the samples it covers, newest on the right
+ */
+static void show_sparkline(const int y, const int x, const int series)
+{
+	const vm_t *vm = &g.vm;
+	const uint32_t bucket = (VM_SAMPLES + SPARK_WIDTH - 1) / SPARK_WIDTH;
+	const chtype levels[] = {
+		ACS_S9, ACS_S7, ACS_HLINE, ACS_S3, ACS_S1
+	};
+	const int nlevels = (int)(sizeof(levels) / sizeof(levels[0]));
+	double col[SPARK_WIDTH], min = 0.0, max = 0.0;
+	bool used[SPARK_WIDTH];
+	uint32_t i;
+	int j;
+
+	(void)memset(used, 0, sizeof(used));
+	for (i = 0; i < vm->count; i++) {
+		const uint32_t idx = (vm->head + VM_SAMPLES - 1 - i) % VM_SAMPLES;
+		const double v = vm->samples[idx].v[series];
+		const int c = SPARK_WIDTH - 1 - (int)(i / bucket);
+
+		if (!used[c] || (v > col[c]))
+			col[c] = v;
+		if (!i || (v < min))
+			min = v;
+		if (!i || (v > max))
+			max = v;
+		used[c] = true;
+	}
+
+	(void)wmove(g.mainwin, y, x);
+	for (j = 0; j < SPARK_WIDTH; j++) {
+		int level = 0;
+
+		if (!used[j]) {
+			(void)waddch(g.mainwin, ' ');
+			continue;
+		}
+		if (max > min)
+			level = (int)(((col[j] - min) * (nlevels - 1)) / (max - min) + 0.5);
+		(void)waddch(g.mainwin, levels[level]);
+	}
+}
+
+/*
+ *  show_vm()
+ *	show process VM stats and their history
+ */
+static void show_vm(void)
+{
+	static const struct {
+		const char *label;
+		const char *unit;
+	} series[VM_SERIES] = {
+		{ "RSS",	"kB" },		/* VM_RSS */
+		{ "Swap",	"kB" },		/* VM_SWAP */
+		{ "Anon",	"kB" },		/* VM_ANON */
+		{ "File",	"kB" },		/* VM_FILE */
+		{ "Minor",	"/s" },		/* VM_MINFLT */
+		{ "Major",	"/s" },		/* VM_MAJFLT */
+	};
+	const vm_t *vm = &g.vm;
+	int y = 2;
+	const int x = COLS - 26, xh = COLS - 52;
+	uint32_t i;
+
+	if (!vm->count)
+		return;
+
+	(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
+	if (vm->state)
+		(void)mvwprintw(g.mainwin, y++, x,
+			" State:    %-12.*s ", (int)vm->state_len, vm->state);
+	for (i = 0; i < vm->nfields; i++) {
+		char name[8];
+
+		(void)snprintf(name, sizeof(name), "%.*s:",
+			(int)vm->fields[i].len, vm->fields[i].name);
+		(void)mvwprintw(g.mainwin, y++, x,
+			" Vm%-6.6s %10" PRIu64 " kB ",
+			name, vm->fields[i].value);
+	}
+	if (vm->have_stat) {
+		(void)mvwprintw(g.mainwin, y++, x, " %-23s", "Page Faults:");
+		(void)mvwprintw(g.mainwin, y++, x,
+			" Minor: %12" PRIu64 "    ", vm->minflt);
+		(void)mvwprintw(g.mainwin, y++, x,
+			" Major: %12" PRIu64 "    ", vm->majflt);
+	}
+	if (vm->have_io) {
+		(void)mvwprintw(g.mainwin, y++, x,
+			" I/O Read:  %8.1f K/s ", vm->read_rate / 1024.0);
+		(void)mvwprintw(g.mainwin, y++, x,
+			" I/O Write: %8.1f K/s ", vm->write_rate / 1024.0);
+	}
+	if (vm->have_oom) {
+		(void)mvwprintw(g.mainwin, y, x,
+			" OOM Score: %8" PRIu64 "    ", vm->oom_score);
+	}
+
+	/* History of the last few minutes, next to the stats */
+	y = 2;
+	(void)mvwprintw(g.mainwin, y++, xh, " Last %3d seconds:%7s",
+		(int)((VM_SAMPLES * g.sched[SCHED_VM].period_ns) / 1000000000ULL), "");
+	for (i = 0; i < VM_SERIES; i++) {
+		const uint32_t last = (vm->head + VM_SAMPLES - 1) % VM_SAMPLES;
+
+		(void)mvwprintw(g.mainwin, y++, xh, " %-6s %13.0f %-2s ",
+			series[i].label, vm->samples[last].v[i], series[i].unit);
+		(void)mvwprintw(g.mainwin, y, xh, " %24s", "");
+		show_sparkline(y++, xh + 1, (int)i);
+	}
+}
+
+/*
+ *  show_prof()
+ *	show pagemon self profiling stats
+ */
+static void show_prof(void)
+{
+	const int x = (COLS - 76) / 2;
+	int i, y = (LINES - PROF_MAX - SCHED_MAX - 4) / 2;
+
+	(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_GREEN) | A_BOLD);
+	(void)mvwprintw(g.mainwin, y++, x,
+		" %-10s %8s %8s %8s %8s %8s %9s %9s ",
+		"Stage", "Count", "Avg us", "p50 us", "p99 us", "Max us",
+		"Syscalls", "Bytes");
+	for (i = PROF_MAPS; i < PROF_MAX; i++) {
+		const prof_stat_t *ps = &g.prof[i];
+		const double count = ps->count ? (double)ps->count : 1.0;
+
+		(void)mvwprintw(g.mainwin, y++, x,
+			" %-10s %8" PRIu64 " %8.1f %8" PRIu64 " %8" PRIu64
+			" %8" PRIu64 " %9.1f %9.1f ",
+			prof_names[i], ps->count,
+			(double)ps->total_ns / count / 1000.0,
+			prof_percentile(ps, 50.0),
+			prof_percentile(ps, 99.0),
+			ps->max_ns / 1000,
+			(double)ps->syscalls / count,
+			(double)ps->bytes / count);
+	}
+
+	/* Requested against achieved sampling intervals */
+	(void)mvwprintw(g.mainwin, y++, x,
+		" %-10s %8s %8s %8s %8s %8s %9s %9s ",
+		"Task", "Every ms", "Avg ms", "Last ms", "Max ms", "Late ms",
+		"Runs", "Missed");
+	for (i = 0; i < SCHED_MAX; i++) {
+		const sched_task_t *t = &g.sched[i];
+		const double runs = t->runs ? (double)t->runs : 1.0;
+		const double intervals = (t->runs > 1) ? (double)(t->runs - 1) : 1.0;
+
+		(void)mvwprintw(g.mainwin, y++, x,
+			" %-10s %8.1f %8.1f %8.1f %8.1f %8.2f %9" PRIu64
+			" %9" PRIu64 " ",
+			sched_names[i], (double)t->period_ns / 1000000.0,
+			(double)t->interval_total_ns / intervals / 1000000.0,
+			(double)t->interval_ns / 1000000.0,
+			(double)t->interval_max_ns / 1000000.0,
+			(double)t->late_total_ns / runs / 1000000.0,
+			t->runs, t->missed);
+	}
+	if (g.ansi.enabled) {
+		const ansi_t *a = &g.ansi;
+		const double frames = a->frames ? (double)a->frames : 1.0;
+		const double intervals = (a->frames > 1) ? (double)(a->frames - 1) : 1.0;
+
+		(void)mvwprintw(g.mainwin, y++, x,
+			" %-10s %8s %8s %8s %8s %8s %9s %9s ",
+			"Output", "Frame ms", "Avg KB", "Last KB", "Skipped",
+			"KB/s", "Frames", "Capped");
+		(void)mvwprintw(g.mainwin, y, x,
+			" %-10s %8.1f %8.2f %8.2f %8" PRIu64 " %8.0f %9" PRIu64
+			" %9" PRIu64 " ",
+			"ANSI", (double)(a->last_ns - a->first_ns) / intervals / 1000000.0,
+			(double)a->bytes / frames / 1024.0,
+			(double)a->last_bytes / 1024.0,
+			a->skipped, a->rate / 1024.0,
+			a->frames, a->capped);
+	}
+}
+
+/*
+ *  dump_prof()
+ *	dump self profiling stats and latency
+ *	histograms to stdout
+ */
+static void dump_prof(void)
+{
+	int i, j;
+
+	(void)printf("%-10s %10s %10s %10s %10s %12s %14s\n",
+		"Stage", "Count", "Avg us", "p99 us", "Max us",
+		"Syscalls", "Bytes");
+	for (i = PROF_MAPS; i < PROF_MAX; i++) {
+		const prof_stat_t *ps = &g.prof[i];
+		const double count = ps->count ? (double)ps->count : 1.0;
+
+		(void)printf("%-10s %10" PRIu64 " %10.1f %10" PRIu64
+			" %10" PRIu64 " %12" PRIu64 " %14" PRIu64 "\n",
+			prof_names[i], ps->count,
+			(double)ps->total_ns / count / 1000.0,
+			prof_percentile(ps, 99.0),
+			ps->max_ns / 1000,
+			ps->syscalls, ps->bytes);
+	}
+	(void)printf("\n%-10s %10s %10s %10s %10s %12s %14s\n",
+		"Task", "Period ms", "Avg ms", "Max ms", "Late ms",
+		"Runs", "Missed");
+	for (i = 0; i < SCHED_MAX; i++) {
+		const sched_task_t *t = &g.sched[i];
+		const double runs = t->runs ? (double)t->runs : 1.0;
+		const double intervals = (t->runs > 1) ? (double)(t->runs - 1) : 1.0;
+
+		(void)printf("%-10s %10.1f %10.1f %10.1f %10.2f %12" PRIu64
+			" %14" PRIu64 "\n",
+			sched_names[i], (double)t->period_ns / 1000000.0,
+			(double)t->interval_total_ns / intervals / 1000000.0,
+			(double)t->interval_max_ns / 1000000.0,
+			(double)t->late_total_ns / runs / 1000000.0,
+			t->runs, t->missed);
+	}
+	for (i = PROF_MAPS; i < PROF_MAX; i++) {
+		const prof_stat_t *ps = &g.prof[i];
+
+		if (!ps->count)
+			continue;
+		(void)printf("\n%s latency histogram:\n", prof_names[i]);
+		for (j = 0; j < PROF_BUCKETS; j++) {
+			if (!ps->hist[j])
+				continue;
+			(void)printf("  < %8" PRIu64 " us %10" PRIu64 " %5.1f%%\n",
+				(uint64_t)1 << j, ps->hist[j],
+				100.0 * (double)ps->hist[j] / (double)ps->count);
+		}
+	}
+}
+
+/*
+ *  fcache_hash()
+ *	hash of a file's device and inode
+ */
+static inline uint32_t fcache_hash(const char *dev, const uint64_t inode)
+{
+	uint32_t h = (uint32_t)(inode ^ (inode >> 32)) * 2654435761U;
+
+	while (*dev)
+		h = (h * 31) + (uint8_t)*dev++;
+	return h & (FCACHE_HASH - 1);
+}
+
+/*
+ *  fcache_reset()
+ *	forget all the files
+ */
+static void fcache_reset(fcache_t *const fc)
+{
+	uint32_t i;
+
+	for (i = 0; i < fc->count; i++)
+		free(fc->files[i].resident);
+	free(fc->files);
+	fc->files = NULL;
+	fc->count = 0;
+	fc->size = 0;
+	fc->range_ns = 0;
+	(void)memset(fc->hash, 0xff, sizeof(fc->hash));
+}
+
+/*
+ *  fcache_query()
+ *	query the page cache of the file of a map, through
+ *	/proc/$PID/map_files so deleted files and files in
+ *	other mount namespaces work. cachestat() gives the
+ *	counts of the whole file and mincore() of a mapping
+ *	of the file gives the cached state of each page
+ */
+static void fcache_query(fcache_file_t *const file, const map_t *const map)
+{
+	char path[PROCPATH_MAX];
+	struct stat statbuf;
+	cachestat_range_t range = { 0, 0 };
+	void *addr;
+	uint64_t npages;
+	int fd;
+
+	file->query_ns = prof_time_ns();
+	file->valid = false;
+	(void)snprintf(path, sizeof(path), "/proc/%d/map_files/%" PRIx64 "-%" PRIx64,
+		g.pid, map->begin, map->end);
+	fd = open(path, O_RDONLY);
+	prof_syscall(0);
+	if (fd < 0)
+		return;
+	if (fstat(fd, &statbuf) < 0)
+		goto close_fd;
+	prof_syscall(0);
+
+	file->have_stat = (syscall(__NR_cachestat, fd, &range, &file->stat, 0) == 0);
+	prof_syscall(0);
+
+	npages = ((uint64_t)statbuf.st_size + g.page_size - 1) / g.page_size;
+	if (!npages || (npages > FCACHE_PAGES_MAX)) {
+		file->npages = 0;
+		file->valid = file->have_stat;
+		goto close_fd;
+	}
+	if (npages > file->npages) {
+		uint8_t *resident = realloc(file->resident, npages);
+
+		if (!resident)
+			goto close_fd;
+		file->resident = resident;
+	}
+	file->npages = npages;
+	addr = mmap(NULL, (size_t)statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	prof_syscall(0);
+	if (addr == MAP_FAILED) {
+		file->npages = 0;
+		file->valid = file->have_stat;
+		goto close_fd;
+	}
+	if (mincore(addr, (size_t)statbuf.st_size, file->resident) < 0)
+		file->npages = 0;
+	prof_syscall(0);
+	(void)munmap(addr, (size_t)statbuf.st_size);
+	prof_syscall(0);
+	file->valid = file->have_stat || file->npages;
+close_fd:
+	(void)close(fd);
+	prof_syscall(0);
+}
+
+/*
+ *  fcache_get()
+ *	page cache info of the file of a map, each file is
+ *	queried at most once every FCACHE_NS however many
+ *	maps it has. Returns NULL for maps without a file
+ */
+static fcache_file_t *fcache_get(const map_t *const map)
+{
+	fcache_t *const fc = &g.fcache;
+	const map_info_t *const info = &g.mem_info.map_info[map - g.mem_info.maps];
+	const uint32_t h = fcache_hash(info->dev, info->inode);
+	fcache_file_t *file;
+	uint32_t i;
+
+	if (!info->inode || g.offline)
+		return NULL;
+	if (!fc->size)
+		fcache_reset(fc);
+	for (i = fc->hash[h]; i != FCACHE_NONE; i = fc->files[i].next) {
+		file = &fc->files[i];
+		if ((file->inode == info->inode) && !strcmp(file->dev, info->dev))
+			goto found;
+	}
+	if (fc->count >= FCACHE_FILES_MAX)
+		fcache_reset(fc);
+	if (fc->count >= fc->size) {
+		const uint32_t size = fc->size ? fc->size * 2 : 64;
+		fcache_file_t *files = realloc(fc->files, size * sizeof(*files));
+
+		if (!files)
+			return NULL;
+		fc->files = files;
+		fc->size = size;
+	}
+	file = &fc->files[fc->count];
+	(void)memset(file, 0, sizeof(*file));
+	(void)memcpy(file->dev, info->dev, sizeof(file->dev));
+	file->inode = info->inode;
+	file->next = fc->hash[h];
+	fc->hash[h] = fc->count++;
+found:
+	if (!file->query_ns || (prof_time_ns() - file->query_ns >= FCACHE_NS))
+		fcache_query(file, map);
+	return file->valid ? file : NULL;
+}
+
+/*
+ *  fcache_count()
+ *	count the sampled pages of begin..end-1 that are not
+ *	in RAM in the process but whose file page is cached
+ */
+static inline void fcache_count(
+	const index_t begin,
+	const index_t end,
+	page_counts_t *const counts)
+{
+	const index_t stride = MAXIMUM(1, (end - begin) / FCACHE_CELL_SAMPLES);
+	const map_t *prev = NULL;
+	const fcache_file_t *file = NULL;
+	index_t idx;
+
+	if (!g.cache_view)
+		return;
+	for (idx = begin; idx < end; idx += stride) {
+		const page_t *const page = &g.mem_info.pages[idx];
+		uint64_t pgoff;
+
+		if (g.mem_info.pyramid.states[idx] != PAGE_STATE_NOT_PRESENT)
+			continue;
+		if (page->map != prev) {
+			prev = page->map;
+			file = fcache_get(prev);
+		}
+		if (!file)
+			continue;
+		/* File page of the map offset plus the page within the map */
+		pgoff = (g.mem_info.map_info[prev - g.mem_info.maps].offset /
+			 g.page_size) + (uint64_t)(idx - prev->first);
+		if ((pgoff < file->npages) && (file->resident[pgoff] & 1))
+			counts->cached++;
+	}
+}
+
+/*
+ *  fcache_range()
+ *	cachestat() of the file range of the Tab view map,
+ *	at most once every FCACHE_NS. Returns false if the
+ *	kernel has no cachestat()
+ */
+static bool fcache_range(const map_t *const map)
+{
+	fcache_t *const fc = &g.fcache;
+	const map_info_t *const info = &g.mem_info.map_info[map - g.mem_info.maps];
+	const uint64_t now = prof_time_ns();
+	cachestat_range_t range;
+	char path[PROCPATH_MAX];
+	int fd;
+
+	if ((fc->range_begin == map->begin) && (now - fc->range_ns < FCACHE_NS))
+		return fc->range_valid;
+	fc->range_begin = map->begin;
+	fc->range_ns = now;
+	fc->range_valid = false;
+
+	(void)snprintf(path, sizeof(path), "/proc/%d/map_files/%" PRIx64 "-%" PRIx64,
+		g.pid, map->begin, map->end);
+	fd = open(path, O_RDONLY);
+	prof_syscall(0);
+	if (fd < 0)
+		return false;
+	range.off = info->offset;
+	range.len = map->end - map->begin;
+	fc->range_valid = (syscall(__NR_cachestat, fd, &range, &fc->range_stat, 0) == 0);
+	prof_syscall(0);
+	(void)close(fd);
+	prof_syscall(0);
+
+	return fc->range_valid;
+}
+
+/*
+ *  show_page_cache()
+ *	show the page cache state of the file range of
+ *	a map and of the whole file, just the cached
+ *	pages from mincore() if there is no cachestat()
+ */
+static void show_page_cache(const map_t *const map, int y, const int x)
+{
+	const map_info_t *const info = &g.mem_info.map_info[map - g.mem_info.maps];
+	const fcache_file_t *const file = fcache_get(map);
+	const cachestat_t *const cs = &g.fcache.range_stat;
+	uint64_t i, cached = 0;
+
+	if (!info->inode)
+		return;
+	if (!file) {
+		(void)mvwprintw(g.mainwin, y, x, " %-46s ",
+			"Page Cache: not available");
+		return;
+	}
+
+	(void)mvwprintw(g.mainwin, y++, x,
+		" Page Cache:  Cached  Dirty  WBack  Evict Recent");
+	if (fcache_range(map)) {
+		(void)mvwprintw(g.mainwin, y++, x,
+			" Map Range: %8" PRIu64 " %6" PRIu64 " %6" PRIu64
+			" %6" PRIu64 " %6" PRIu64,
+			cs->nr_cache, cs->nr_dirty, cs->nr_writeback,
+			cs->nr_evicted, cs->nr_recently_evicted);
+	} else {
+		const uint64_t first = info->offset / g.page_size;
+		const uint64_t end = first + (map->end - map->begin) / g.page_size;
+
+		for (i = first; (i < end) && (i < file->npages); i++)
+			cached += file->resident[i] & 1;
+		(void)mvwprintw(g.mainwin, y++, x,
+			" Map Range: %8" PRIu64 " %6s %6s %6s %6s",
+			cached, "-", "-", "-", "-");
+	}
+	if (file->have_stat) {
+		(void)mvwprintw(g.mainwin, y, x,
+			" File:      %8" PRIu64 " %6" PRIu64 " %6" PRIu64
+			" %6" PRIu64 " %6" PRIu64,
+			file->stat.nr_cache, file->stat.nr_dirty,
+			file->stat.nr_writeback, file->stat.nr_evicted,
+			file->stat.nr_recently_evicted);
+	} else {
+		for (cached = 0, i = 0; i < file->npages; i++)
+			cached += file->resident[i] & 1;
+		(void)mvwprintw(g.mainwin, y, x,
+			" File:      %8" PRIu64 " %6s %6s %6s %6s",
+			cached, "-", "-", "-", "-");
+	}
+}
+
+/*
+ *  physmap_count()
+ *	add the run classes of up to PHYSMAP_CELL_SAMPLES
+ *	evenly spaced pages of begin..end-1
+ */
+static inline void physmap_count(
+	const index_t begin,
+	const index_t end,
+	page_counts_t *const counts)
+{
+	const index_t stride = MAXIMUM(1, (end - begin) / PHYSMAP_CELL_SAMPLES);
+	const index_t last = MINIMUM(end, (index_t)g.physmap.runs_npages);
+	index_t idx;
+
+	if (!g.phys_view || !g.physmap.runs)
+		return;
+	for (idx = begin; idx < last; idx += stride)
+		counts->runs[g.physmap.runs[idx]]++;
+}
+
+/*
+ *  physmap_stat_cmp()
+ *	order map stats by map address
+ */
+static int physmap_stat_cmp(const void *p1, const void *p2)
+{
+	const phys_map_stat_t *s1 = (const phys_map_stat_t *)p1;
+	const phys_map_stat_t *s2 = (const phys_map_stat_t *)p2;
+
+	return (s1->begin > s2->begin) - (s1->begin < s2->begin);
+}
+
+/*
+ *  show_physmap()
+ *	show the physical contiguity of the pages in RAM
+ *	of a map and the zones they are in
+ */
+static void show_physmap(const map_t *const map, int y, const int x)
+{
+	const physmap_t *const pm = &g.physmap;
+	const phys_map_stat_t *stat;
+	phys_map_stat_t key;
+	uint32_t i;
+
+	key.begin = map->begin;
+	stat = bsearch(&key, pm->stats, pm->nstats, sizeof(*pm->stats),
+		physmap_stat_cmp);
+	if (!stat) {
+		(void)mvwprintw(g.mainwin, y, x, " %-46s ",
+			(pm->no_pfn && !pm->pages) ?
+			"Phys Pages:  PFNs need CAP_SYS_ADMIN" :
+			"Phys Pages:  none in RAM");
+		return;
+	}
+	(void)mvwprintw(g.mainwin, y++, x,
+		" Phys Pages:  %10" PRIu64 "  Frag:     %5.1f%%%6s",
+		stat->pages, (stat->pages > 1) ? 100.0 * (double)(stat->runs - 1) /
+			(double)(stat->pages - 1) : 0.0, "");
+	(void)mvwprintw(g.mainwin, y++, x,
+		" Phys Runs:   %10" PRIu64 "  Max Run:  %10" PRIu64 "  ",
+		stat->runs, stat->max_run);
+	(void)mvwprintw(g.mainwin, y++, x,
+		" THP Mapped:  %10" PRIu64 "  Eligible: %10" PRIu64 "  ",
+		stat->thp_mapped, stat->thp_eligible);
+	for (i = 0; (i < pm->nzones) && (y < LINES - 1); i++) {
+		if (!stat->zones[i])
+			continue;
+		(void)mvwprintw(g.mainwin, y++, x,
+			" Zone %-8.8s Node %-3" PRIu32 "%10" PRIu64 " pages%9s",
+			pm->zones[i].name, pm->zones[i].node, stat->zones[i], "");
+	}
+}
+
+/*
+ *  counts_to_cell()
+ *	colour and character of a cell from the page
+ *	state counts, the most common state wins and
+ *	ties go to the state with higher precedence.
+ *	Returns false if no pages are mapped in the cell
+ */
+static bool counts_to_cell(
+	const page_counts_t *const counts,
+	int *const attr,
+	char *const ch)
+{
+	uint64_t total = 0, max = 0;
+	int i, state = PAGE_STATE_NOT_PRESENT;
+
+	for (i = PAGE_STATE_MAX - 1; i >= 0; i--) {
+		total += counts->n[i];
+		if (counts->n[i] > max) {
+			max = counts->n[i];
+			state = i;
+		}
+	}
+	if (!total)
+		return false;
+	*attr = COLOR_PAIR(page_states[state].pair);
+	*ch = page_states[state].ch;
+	if (g.cache_view && (state == PAGE_STATE_NOT_PRESENT) && counts->cached) {
+		*attr = COLOR_PAIR(BLUE_WHITE) | A_BOLD;
+		*ch = 'c';
+	}
+	if (g.numa_view && (state != PAGE_STATE_NOT_PRESENT) &&
+	    (state != PAGE_STATE_SWAPPED)) {
+		int node = -1;
+
+		for (max = 0, i = 0; i < NUMA_NODES_MAX; i++) {
+			if (counts->nodes[i] > max) {
+				max = counts->nodes[i];
+				node = i;
+			}
+		}
+		if (node >= 0) {
+			*attr = COLOR_PAIR(numa_pairs[node % NUMA_PAIRS]);
+			*ch = "0123456789abcdef"[node];
+		}
+	}
+	if (g.phys_view && (state != PAGE_STATE_NOT_PRESENT) &&
+	    (state != PAGE_STATE_SWAPPED)) {
+		int run = PHYS_RUN_NONE;
+
+		for (max = 0, i = PHYS_RUN_SINGLE; i < PHYS_RUN_MAX; i++) {
+			if (counts->runs[i] > max) {
+				max = counts->runs[i];
+				run = i;
+			}
+		}
+		if (run != PHYS_RUN_NONE) {
+			*attr = COLOR_PAIR(phys_runs[run].pair);
+			*ch = phys_runs[run].ch;
+		}
+	}
+#if defined(PERF_ENABLED)
+	if (g.fault_view && g.faults_max) {
+		if (counts->faults * 2 >= g.faults_max) {
+			*attr = COLOR_PAIR(WHITE_RED) | A_BOLD;
+			*ch = 'F';
+		} else if (counts->faults) {
+			*attr = COLOR_PAIR(WHITE_MAGENTA);
+			*ch = 'f';
+		}
+	}
+#endif
+	return true;
+}
+
+/*
+ *  numa_count()
+ *	add the nodes of up to NUMA_CELL_SAMPLES evenly
+ *	spaced pages of begin..end-1, enough to find the
+ *	majority node of a cell
+ */
+static inline void numa_count(
+	const index_t begin,
+	const index_t end,
+	page_counts_t *const counts)
+{
+	const index_t stride = MAXIMUM(1, (end - begin) / NUMA_CELL_SAMPLES);
+	index_t idx;
+
+	if (!g.numa_view || !g.numa.nodes)
+		return;
+	for (idx = begin; idx < end; idx += stride) {
+		const uint8_t node = g.numa.nodes[idx];
+
+		if (node != NUMA_NODE_NONE)
+			counts->nodes[MINIMUM(node, NUMA_NODES_MAX - 1)]++;
+	}
+}
+
+/*
+ *  numa_maps_read()
+ *	read the per node page counts of a map from
+ *	numa_maps, at most once every NUMA_MAPS_NS as
+ *	the kernel walks all of the process to make it
+ */
+static void numa_maps_read(const map_t *const map)
+{
+	numa_t *const numa = &g.numa;
+	const uint64_t now = prof_time_ns();
+	char key[24], *ptr;
+	ssize_t len;
+	int n;
+
+	if ((numa->maps_begin == map->begin) &&
+	    (now - numa->maps_ns < NUMA_MAPS_NS))
+		return;
+	numa->maps_begin = map->begin;
+	numa->maps_ns = now;
+	numa->maps_valid = false;
+	(void)memset(numa->maps_nodes, 0, sizeof(numa->maps_nodes));
+
+	len = read_file(g.path_numa_maps, &numa->buf, &numa->buf_size);
+	if (len < 0)
+		return;
+
+	/* Find the line of the map, lines start with the address */
+	n = snprintf(key, sizeof(key), "%" PRIx64 " ", map->begin);
+	for (ptr = numa->buf; ptr && *ptr; ptr = strchr(ptr, '\n')) {
+		if (*ptr == '\n')
+			ptr++;
+		if (!strncmp(ptr, key, (size_t)n))
+			break;
+	}
+	if (!ptr || !*ptr)
+		return;
+
+	/* Then the N<node>=<pages> fields */
+	numa->maps_valid = true;
+	for (ptr += n; *ptr && (*ptr != '\n'); ptr++) {
+		char *end;
+		unsigned long node;
+
+		if ((ptr[0] != 'N') || (ptr[-1] != ' ') || !isdigit(ptr[1]))
+			continue;
+		node = strtoul(ptr + 1, &end, 10);
+		if (*end != '=')
+			continue;
+		numa->maps_nodes[MINIMUM(node, NUMA_NODES_MAX - 1)] +=
+			strtoull(end + 1, &end, 10);
+		ptr = end - 1;
+	}
+}
+
+/*
+ *  show_numa()
+ *	show the per node histogram of the pages of a map
+ *	from the queried nodes and from numa_maps
+ */
+static void show_numa(const map_t *const map, int y, const int x)
+{
+	const index_t begin = map->first;
+	const index_t end = begin +
+		(index_t)((map->end - map->begin) / g.page_size);
+	uint64_t nodes[NUMA_NODES_MAX];
+	index_t idx;
+	int i;
+
+	if (!g.numa.nodes)
+		return;
+	(void)memset(nodes, 0, sizeof(nodes));
+	for (idx = begin; idx < end; idx++) {
+		const uint8_t node = g.numa.nodes[idx];
+
+		if (node != NUMA_NODE_NONE)
+			nodes[MINIMUM(node, NUMA_NODES_MAX - 1)]++;
+	}
+	numa_maps_read(map);
+
+	(void)mvwprintw(g.mainwin, y++, x,
+		" NUMA Node:       Pages   numa_maps Pages%7s", "");
+	for (i = 0; (i < NUMA_NODES_MAX) && (y < LINES - 1); i++) {
+		if (!nodes[i] && !g.numa.maps_nodes[i])
+			continue;
+		if (g.numa.maps_valid)
+			(void)mvwprintw(g.mainwin, y++, x,
+				" %-5d %18" PRIu64 " %21" PRIu64 " ",
+				i, nodes[i], g.numa.maps_nodes[i]);
+		else
+			(void)mvwprintw(g.mainwin, y++, x,
+				" %-5d %18" PRIu64 " %21s ", i, nodes[i], "-");
+	}
+}
+
+/*
+ *  show_page_bits()
+ *	show info based on the page bit pattern
+ */
+static void show_page_bits(
+	map_t *const map,
+	const index_t idx)
+{
+	pagemap_t pagemap_info;
+	off_t offset;
+	char buf[16];
+	const int x = 2;
+	int fd, kfd;
+	ssize_t ret;
+
+	mem_to_str(map->end - map->begin, buf, sizeof(buf) - 1);
+	(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
+	(void)mvwprintw(g.mainwin, 2, x,
+		" Page:      0x%16.16" PRIx64 "%18s",
+		g.mem_info.pages[idx].addr, "");
+	(void)mvwprintw(g.mainwin, 3, x,
+		" Page Size: 0x%8.8" PRIx32 " bytes%20s",
+		g.page_size, "");
+	(void)mvwprintw(g.mainwin, 4, x,
+		" Map:       0x%16.16" PRIx64 "-%16.16" PRIx64 " ",
+		map->begin, map->end - 1);
+	(void)mvwprintw(g.mainwin, 5, x,
+		" Map Size:  %s%27s", buf, "");
+	(void)mvwprintw(g.mainwin, 6, x,
+		" Device:    %-7.7s%29s",
+		map_dev(map), "");
+	(void)mvwprintw(g.mainwin, 7, x,
+		" Prot:      %4.4s%32s",
+		map->attr, "");
+	(void)mvwprintw(g.mainwin, 8, x,
+		" Map Name:  %-35.35s ", map_basename(map));
+
+	offset = sizeof(pagemap_t) *
+		(g.mem_info.pages[idx].addr / g.page_size);
+	if ((fd = open(g.path_pagemap, O_RDONLY)) < 0)
+		return;
+	ret = pread(fd, &pagemap_info, sizeof(pagemap_info), offset);
+	(void)close(fd);
+	if (ret != sizeof(pagemap_info))
+		return;
+
+	(void)mvwprintw(g.mainwin, 9, x,
+		" Flag:      0x%16.16" PRIx64 "%18s", pagemap_info, "");
+	if (pagemap_info & PAGE_SWAPPED) {
+		(void)mvwprintw(g.mainwin, 10, x,
+			" Swap Type:           0x%2.2" PRIx64 "%22s",
+			pagemap_info & 0x1f, "");
+		(void)mvwprintw(g.mainwin, 11, x,
+			" Swap Offset:         0x%16.16" PRIx64 "%8s",
+			(uint64_t)(pagemap_info & 0x00ffffffffffffffULL) >> 5, "");
+	} else {
+		(void)mvwprintw(g.mainwin, 10, x, "%48s", "");
+		if (pagemap_info & PAGE_PRESENT) {
+			(void)mvwprintw(g.mainwin, 11, x,
+				" Physical Address:    0x%16.16" PRIx64 "%8s",
+				(uint64_t)(pagemap_info & 0x00ffffffffffffffULL) * g.page_size, "");
+		} else {
+			(void)mvwprintw(g.mainwin, 11, x,
+				" Physical Address:    0x----------------%8s", "");
+		}
+	}
+	(void)mvwprintw(g.mainwin, 12, x,
+		" Soft-dirty PTE:      %3s%23s",
+		(pagemap_info & PAGE_PTE_SOFT_DIRTY) ? "Yes" : "No ", "");
+	(void)mvwprintw(g.mainwin, 13, x,
+		" Exclusively Mapped:  %3s%23s",
+		(pagemap_info & PAGE_EXCLUSIVE_MAPPED) ? "Yes" : "No ", "");
+	(void)mvwprintw(g.mainwin, 14, x,
+		" File or Shared Anon: %3s%23s",
+		(pagemap_info & PAGE_FILE_SHARED_ANON) ? "Yes" : "No ", "");
+	(void)mvwprintw(g.mainwin, 15, x,
+		" Present in Swap:     %3s%23s",
+		(pagemap_info & PAGE_SWAPPED) ? "Yes" : "No ", "");
+	(void)mvwprintw(g.mainwin, 16, x,
+		" Present in RAM:      %3s%23s",
+		(pagemap_info & PAGE_PRESENT) ? "Yes" : "No ", "");
+
+	kfd = open("/proc/kpagecount", O_RDONLY);
+	if (kfd > -1) {
+		uint64_t count;
+
+		offset = sizeof(count) *
+			(pagemap_info & 0x00ffffffffffffffULL);
+
+		if (lseek(kfd, offset, SEEK_SET) == (off_t)-1)
+			goto close_kfd;
+		if (read(kfd, &count, sizeof(count)) != sizeof(count)) 
+			goto close_kfd;
+		(void)mvwprintw(g.mainwin, 16, x,
+			" KPageCount:          %-10" PRIu64 "%13s", count, "");
+		
+close_kfd:
+		(void)close(kfd);
+	}
+	if (g.numa_view)
+		show_numa(map, 17, x);
+	else if (g.phys_view)
+		show_physmap(map, 17, x);
+	else
+		show_page_cache(map, 17, x);
+}
+
+/*
+ *  banner()
+ *	clear a banner across the window
+ */
+static inline void banner(const int y)
+{
+	(void)mvwprintw(g.mainwin, y, 0, "%*s", COLS, "");
+}
+
+/*
+ *  show_pages()
+ *	show page mapping
+ */
+static int show_pages(
+	const index_t cursor_index,
+	const index_t page_index,
+	const position_t *const p,
+	const int32_t zoom)
+{
+	int32_t i;
+	index_t idx;
+	map_t *map;
+	const int32_t xmax = p->xmax, ymax = p->ymax;
+	const addr_t sel_lo = MINIMUM(g.sel_begin, g.sel_end);
+	const addr_t sel_hi = MAXIMUM(g.sel_begin, g.sel_end);
+
+	idx = page_index;
+	for (i = 1; i <= ymax; i++) {
+		int32_t j;
+
+		if (idx >= (index_t)g.mem_info.npages) {
+			(void)wattrset(g.mainwin, COLOR_PAIR(BLACK_BLACK));
+			(void)mvwprintw(g.mainwin, i, 0, "---------------- ");
+		} else {
+			(void)wattrset(g.mainwin, COLOR_PAIR(BLACK_WHITE));
+			(void)mvwprintw(g.mainwin, i, 0, "%16.16" PRIx64 " ",
+				g.mem_info.pages[idx].addr);
+		}
+
+		/*
+		 *  Each cell is summarised from the page state
+		 *  pyramid, so there is no pagemap reading here
+		 */
+		for (j = 0; j < xmax; j++) {
+			char state = '~';
+			int attr = COLOR_PAIR(BLACK_BLACK);
+
+			if (idx < (index_t)g.mem_info.npages) {
+				const index_t end = MINIMUM(idx + zoom,
+					(index_t)g.mem_info.npages);
+				page_counts_t counts;
+
+				(void)memset(&counts, 0, sizeof(counts));
+				pyramid_count(idx, end, &counts);
+				numa_count(idx, end, &counts);
+				fcache_count(idx, end, &counts);
+				physmap_count(idx, end, &counts);
+#if defined(PERF_ENABLED)
+				faults_count(idx, end, &counts);
+#endif
+				(void)counts_to_cell(&counts, &attr, &state);
+				if (g.selection &&
+				    (g.mem_info.pages[idx].addr <= sel_hi) &&
+				    (g.mem_info.pages[end - 1].addr >= sel_lo))
+					attr |= A_REVERSE;
+				idx += zoom;
+			}
+			(void)wattrset(g.mainwin, attr);
+			(void)mvwprintw(g.mainwin, i, ADDR_OFFSET + j, "%c", state);
+		}
+	}
+	(void)wattrset(g.mainwin, A_NORMAL);
+
+	map = g.mem_info.pages[cursor_index].map;
+	if (map && g.tab_view)
+		show_page_bits(map, cursor_index);
+	if (g.vm_view)
+		show_vm();
+#if defined(PERF_ENABLED)
+	if (g.perf_view)
+		show_perf();
+#endif
+
+	return 0;
+}
+
+/*
+ *  va_count()
+ *	count the states of the mapped pages in
+ *	the address range begin..last inclusive
+ */
+static void va_count(
+	const addr_t begin,
+	const addr_t last,
+	page_counts_t *const counts)
+{
+	uint32_t i;
+
+	(void)memset(counts, 0, sizeof(*counts));
+	for (i = map_lookup(begin); i < g.mem_info.nmaps; i++) {
+		const map_t *map = &g.mem_info.maps[i];
+		index_t first, end;
+
+		if (map->begin > last)
+			break;
+		first = map->first + (index_t)((MAXIMUM(map->begin, begin) -
+			map->begin) / g.page_size);
+		end = map->first + (index_t)((MINIMUM(map->end - 1, last) -
+			map->begin) / g.page_size) + 1;
+		pyramid_count(first, end, counts);
+		numa_count(first, end, counts);
+#if defined(PERF_ENABLED)
+		faults_count(first, end, counts);
+#endif
+	}
+}
+
+/*
+ *  va_bits()
+ *	log2 of the size of the address space to show,
+ *	enough to cover the last user space mapping. Kernel
+ *	half mappings such as [vsyscall] are not shown as
+ *	they would squash user space into the first cell
+ */
+static uint32_t va_bits(void)
+{
+	const uint32_t page_shift = (uint32_t)__builtin_ctz(g.page_size);
+	addr_t last = 0;
+	uint32_t i, bits;
+
+	for (i = g.mem_info.nmaps; i > 0; i--) {
+		const map_t *map = &g.mem_info.maps[i - 1];
+
+		if (!(map->begin & (1ULL << 63))) {
+			last = map->end;
+			break;
+		}
+	}
+	bits = (last > 1) ? 64 - (uint32_t)__builtin_clzll(last - 1) : 0;
+
+	return MAXIMUM(bits, page_shift);
+}
+
+/*
+ *  va_shift_max()
+ *	cell size shift that shows the whole
+ *	address space on one screen
+ */
+static uint32_t va_shift_max(const position_t *const p)
+{
+	const uint32_t page_shift = (uint32_t)__builtin_ctz(g.page_size);
+	const uint64_t cells = (uint64_t)p->xmax * (uint64_t)p->ymax;
+	const uint32_t cells_bits = cells ?
+		63 - (uint32_t)__builtin_clzll(cells) : 0;
+	const uint32_t bits = va_bits();
+
+	return (bits > cells_bits + page_shift) ?
+		bits - cells_bits : page_shift;
+}
+
+/*
+ *  va_cells()
+ *	number of cells covering the address space
+ */
+static inline uint64_t va_cells(void)
+{
+	const uint32_t bits = va_bits();
+
+	return (bits > g.va_shift) ? 1ULL << (bits - g.va_shift) : 1;
+}
+
+/*
+ *  va_cursor_cell()
+ *	cell the cursor is on
+ */
+static inline uint64_t va_cursor_cell(const position_t *const p)
+{
+	return ((g.va_row + (uint64_t)p->ypos) * (uint64_t)p->xmax) +
+		(uint64_t)p->xpos;
+}
+
+/*
+ *  va_cell_index()
+ *	page index of the first mapped page in a
+ *	cell, -1 if nothing is mapped in the cell
+ */
+static index_t va_cell_index(const uint64_t cell)
+{
+	const addr_t begin = cell << g.va_shift;
+	const addr_t last = begin + ((1ULL << g.va_shift) - 1);
+	const uint32_t i = map_lookup(begin);
+	const map_t *map = &g.mem_info.maps[i];
+
+	if ((i >= g.mem_info.nmaps) || (map->begin > last))
+		return -1;
+	if (map->begin >= begin)
+		return map->first;
+	return map->first + (index_t)((begin - map->begin) / g.page_size);
+}
+
+/*
+ *  va_index_range()
+ *	page indexes begin..end-1 of the pages
+ *	that are visible in the address view
+ */
+static void va_index_range(
+	const position_t *const p,
+	index_t *const begin,
+	index_t *const end)
+{
+	const uint64_t cells = va_cells();
+	const uint64_t cell_first = g.va_row * (uint64_t)p->xmax;
+	const uint64_t cell_end = MINIMUM(cells,
+		cell_first + ((uint64_t)p->xmax * (uint64_t)p->ymax));
+	const addr_t first = cell_first << g.va_shift;
+	const addr_t last = ((cell_end - 1) << g.va_shift) +
+		((1ULL << g.va_shift) - 1);
+	uint32_t i;
+
+	i = map_lookup(first);
+	if (i >= g.mem_info.nmaps)
+		*begin = (index_t)g.mem_info.npages;
+	else if (first <= g.mem_info.maps[i].begin)
+		*begin = g.mem_info.maps[i].first;
+	else
+		*begin = g.mem_info.maps[i].first + (index_t)
+			((first - g.mem_info.maps[i].begin) / g.page_size);
+
+	i = map_lookup(last);
+	if (i >= g.mem_info.nmaps)
+		*end = (index_t)g.mem_info.npages;
+	else if (last < g.mem_info.maps[i].begin)
+		*end = g.mem_info.maps[i].first;
+	else
+		*end = g.mem_info.maps[i].first + (index_t)
+			((last - g.mem_info.maps[i].begin) / g.page_size) + 1;
+}
+
+/*
+ *  va_move()
+ *	keep the address view cursor in range,
+ *	scrolling the view if need be
+ */
+static void va_move(position_t *const p)
+{
+	const uint32_t page_shift = (uint32_t)__builtin_ctz(g.page_size);
+	uint64_t cells, rows;
+
+	g.va_shift = MINIMUM(g.va_shift, va_shift_max(p));
+	g.va_shift = MAXIMUM(g.va_shift, page_shift);
+	cells = va_cells();
+	rows = (cells + (uint64_t)p->xmax - 1) / (uint64_t)p->xmax;
+
+	if (p->xpos >= p->xmax) {
+		p->xpos = 0;
+		p->ypos++;
+	}
+	if (p->xpos < 0) {
+		p->xpos = p->xmax - 1;
+		p->ypos--;
+	}
+	if (p->ypos > p->ymax - 1) {
+		g.va_row += (uint64_t)(p->ypos - (p->ymax - 1));
+		p->ypos = p->ymax - 1;
+	}
+	if (p->ypos < 0) {
+		const uint64_t up = (uint64_t)-p->ypos;
+
+		if (g.va_row < up) {
+			g.va_row = 0;
+			p->xpos = 0;
+		} else {
+			g.va_row -= up;
+		}
+		p->ypos = 0;
+	}
+	if (g.va_row + (uint64_t)p->ymax > rows)
+		g.va_row = (rows > (uint64_t)p->ymax) ? rows - (uint64_t)p->ymax : 0;
+	if (g.va_row + (uint64_t)p->ypos >= rows)
+		p->ypos = (int32_t)(rows - 1 - g.va_row);
+	if (va_cursor_cell(p) >= cells)
+		p->xpos = (int32_t)((cells - 1) % (uint64_t)p->xmax);
+}
+
+/*
+ *  va_goto()
+ *	set the address view cell size and move
+ *	the cursor to the cell containing addr
+ */
+static void va_goto(position_t *const p, const addr_t addr, const uint32_t shift)
+{
+	const uint32_t page_shift = (uint32_t)__builtin_ctz(g.page_size);
+	uint64_t cell, row;
+
+	g.va_shift = MINIMUM(shift, va_shift_max(p));
+	g.va_shift = MAXIMUM(g.va_shift, page_shift);
+	cell = addr >> g.va_shift;
+	row = cell / (uint64_t)p->xmax;
+
+	/* Put the cursor mid screen where possible */
+	p->xpos = (int32_t)(cell % (uint64_t)p->xmax);
+	p->ypos = (int32_t)MINIMUM(row, (uint64_t)p->ymax / 2);
+	g.va_row = row - (uint64_t)p->ypos;
+	va_move(p);
+}
+
+/*
+ *  va_cell_str()
+ *	address view cell size as a short string
+ */
+static void va_cell_str(char *const buf, const size_t buflen)
+{
+	static const char units[] = "KMGTPE";
+	const uint32_t unit = (g.va_shift / 10) - 1;
+
+	(void)snprintf(buf, buflen, "%" PRIu64 "%c",
+		(uint64_t)1 << (g.va_shift % 10), units[MINIMUM(unit, 5U)]);
+}
+
+/*
+ *  show_va()
+ *	show the virtual address space, each cell covers
+ *	a fixed power of 2 sized range of addresses
+ */
+static int show_va(const index_t cursor_index, const position_t *const p)
+{
+	const uint64_t cells = va_cells();
+	const int32_t xmax = p->xmax, ymax = p->ymax;
+	int32_t i;
+
+	for (i = 1; i <= ymax; i++) {
+		const uint64_t row = g.va_row + (uint64_t)(i - 1);
+		uint64_t cell = row * (uint64_t)xmax;
+		int32_t j;
+
+		if (cell >= cells) {
+			(void)wattrset(g.mainwin, COLOR_PAIR(BLACK_BLACK));
+			(void)mvwprintw(g.mainwin, i, 0, "---------------- ");
+		} else {
+			(void)wattrset(g.mainwin, COLOR_PAIR(BLACK_WHITE));
+			(void)mvwprintw(g.mainwin, i, 0, "%16.16" PRIx64 " ",
+				(addr_t)(cell << g.va_shift));
+		}
+		for (j = 0; j < xmax; j++, cell++) {
+			int attr = COLOR_PAIR(BLACK_BLACK);
+			char state = '~';
+
+			if (cell < cells) {
+				const addr_t begin = cell << g.va_shift;
+				page_counts_t counts;
+
+				va_count(begin,
+					begin + ((1ULL << g.va_shift) - 1), &counts);
+				if (!counts_to_cell(&counts, &attr, &state)) {
+					/* Unmapped gap */
+					attr = COLOR_PAIR(WHITE_BLUE);
+					state = ' ';
+				}
+			}
+			(void)wattrset(g.mainwin, attr);
+			(void)mvwprintw(g.mainwin, i, ADDR_OFFSET + j, "%c", state);
+		}
+	}
+	(void)wattrset(g.mainwin, A_NORMAL);
+
+	if ((cursor_index >= 0) && g.tab_view)
+		show_page_bits(g.mem_info.pages[cursor_index].map,
+			cursor_index);
+	if (g.vm_view)
+		show_vm();
+#if defined(PERF_ENABLED)
+	if (g.perf_view)
+		show_perf();
+#endif
+
+	return 0;
+}
+
+/*
+ *  show_memory()
+ *	show memory contents
+ */
+static int show_memory(
+	const index_t page_index,
+	index_t data_index,
+	const position_t *const p)
+{
+	addr_t addr;
 	index_t idx = page_index;
 	int32_t i;
 	const int32_t xmax = p->xmax, ymax = p->ymax;
 	int fd;
+	prof_t prof;
+
+	prof_begin(&prof, PROF_MEMORY);
+	if ((fd = open(g.path_mem, O_RDONLY)) < 0) {
+		prof_end(&prof);
+		return ERR_NO_MEM_INFO;
+	}
+	prof_syscall(0);
+
+	for (i = 1; i <= ymax; i++) {
+		int32_t j;
+		uint8_t bytes[xmax];
+		ssize_t nread = 0;
+
+		addr = g.mem_info.pages[idx].addr + data_index;
+		prof_syscall(0);
+		if (lseek(fd, (off_t)addr, SEEK_SET) == (off_t)-1) {
+			nread = -1;
+		} else {
+			nread = read(fd, bytes, (size_t)xmax);
+			prof_syscall(nread);
+			if (nread < 0)
+				nread = -1;
+		}
+
+		(void)wattrset(g.mainwin, COLOR_PAIR(BLACK_WHITE));
+		if (idx >= (index_t)g.mem_info.npages)
+			(void)mvwprintw(g.mainwin, i, 0, "---------------- ");
+		else
+			(void)mvwprintw(g.mainwin, i, 0, "%16.16" PRIx64 " ", addr);
+		(void)mvwprintw(g.mainwin, i, COLS - 3, "   ");
+
+		for (j = 0; j < xmax; j++) {
+			uint8_t byte;
+
+			addr = g.mem_info.pages[idx].addr + data_index;
+			if ((idx >= (index_t)g.mem_info.npages) ||
+			    (addr > g.mem_info.last_addr)) {
+				/* End of memory */
+				(void)wattrset(g.mainwin, COLOR_PAIR(BLACK_BLACK));
+				(void)mvwprintw(g.mainwin, i, ADDR_OFFSET +
+					(HEX_WIDTH * j), "   ");
+				(void)mvwprintw(g.mainwin, i, ADDR_OFFSET +
+					(HEX_WIDTH * xmax) + j, " ");
+				goto do_border;
+			}
+			if (j > nread) {
+				/* Failed to read data */
+				(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE));
+				(void)mvwprintw(g.mainwin, i, ADDR_OFFSET +
+					(HEX_WIDTH * j), "?? ");
+				(void)wattrset(g.mainwin, COLOR_PAIR(BLACK_WHITE));
+				(void)mvwprintw(g.mainwin, i, ADDR_OFFSET +
+					(HEX_WIDTH * xmax) + j, "?");
+				goto do_border;
+			}
+
+			/* We have some legimate data to display */
+ 			byte = bytes[j];
+			(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE));
+			(void)mvwprintw(g.mainwin, i, ADDR_OFFSET +
+				(HEX_WIDTH * j), "%2.2" PRIx8 " ", byte);
+			(void)wattrset(g.mainwin, COLOR_PAIR(BLACK_WHITE));
+			byte &= 0x7f;
+			(void)mvwprintw(g.mainwin, i, ADDR_OFFSET +
+				(HEX_WIDTH * xmax) + j, "%c",
+				(byte < 32 || byte > 126) ? '.' : byte);
+do_border:
+			(void)wattrset(g.mainwin, COLOR_PAIR(BLACK_WHITE));
+			(void)mvwprintw(g.mainwin, i, 16 + (HEX_WIDTH * xmax), " ");
+			data_index++;
+			if (data_index >= g.page_size) {
+				data_index -= g.page_size;
+				idx++;
+			}
+		}
+	}
+	(void)close(fd);
+	prof_syscall(0);
+	prof_end(&prof);
+
+	return 0;
+}
+
+/*
+ *  read_all_pages()
+ *	read in all pages into memory, this
+ *	will force swapped out pages back into
+ *	memory
+ */
+static int read_all_pages(void)
+{
+	int fd;
+	index_t idx;
+
+	if ((fd = open(g.path_mem, O_RDONLY)) < 0)
+		return ERR_NO_MEM_INFO;
+
+	for (idx = 0; idx < (index_t)g.mem_info.npages; idx++) {
+		const off_t addr = g.mem_info.pages[idx].addr;
+		uint8_t byte;
+
+		if (lseek(fd, addr, SEEK_SET) == (off_t)-1)
+			continue;
+		if (read(fd, &byte, sizeof(byte)) < 0)
+			continue;
+	}
+	(void)close(fd);
+
+	return 0;
+}
+
+/*
+ *  selection_range()
+ *	the page indexes first..end-1 of the selected
+ *	address range, false if nothing is selected
+ */
+static bool selection_range(index_t *const first, index_t *const end)
+{
+	const addr_t lo = MINIMUM(g.sel_begin, g.sel_end);
+	const addr_t hi = MAXIMUM(g.sel_begin, g.sel_end);
+	const uint32_t i = map_lookup(lo);
+	const map_t *map = &g.mem_info.maps[i];
+	index_t idx;
+
+	if (!g.selection || (i >= g.mem_info.nmaps))
+		return false;
+	idx = (lo < map->begin) ? map->first :
+		map->first + (index_t)((lo - map->begin) / g.page_size);
+	*first = idx;
+	while ((idx < (index_t)g.mem_info.npages) &&
+	       (g.mem_info.pages[idx].addr <= hi))
+		idx++;
+	*end = idx;
+	return *end > *first;
+}
+
+/*
+ *  migrate_worker()
+ *	move the pages to the node in batches,
+ *	the progress is read by the main loop
+ */
+static void *migrate_worker(void *arg)
+{
+	migrate_t *const m = (migrate_t *)arg;
+	void *addrs[MIGRATE_BATCH];
+	int nodes[MIGRATE_BATCH], status[MIGRATE_BATCH];
+	uint64_t done = 0;
+
+	while ((done < m->npages) &&
+	       !__atomic_load_n(&m->stop, __ATOMIC_RELAXED)) {
+		const uint64_t n = MINIMUM(m->npages - done, MIGRATE_BATCH);
+		uint64_t k, moved = 0;
+		long ret;
+
+		for (k = 0; k < n; k++) {
+			addrs[k] = (void *)(uintptr_t)m->addrs[done + k];
+			nodes[k] = m->node;
+		}
+		ret = numa_move_pages(m->pid, n, addrs, nodes, status,
+			MPOL_MF_MOVE);
+		for (k = 0; (ret >= 0) && (k < n); k++) {
+			if (status[k] == m->node)
+				moved++;
+		}
+		done += n;
+		__atomic_add_fetch(&m->moved, moved, __ATOMIC_RELAXED);
+		__atomic_store_n(&m->done, done, __ATOMIC_RELEASE);
+	}
+	__atomic_store_n(&m->end_ns, prof_time_ns(), __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+/*
+ *  migrate_stop()
+ *	stop and reap the migration worker
+ */
+static void migrate_stop(migrate_t *const m)
+{
+	if (!m->started)
+		return;
+	__atomic_store_n(&m->stop, true, __ATOMIC_RELAXED);
+	(void)pthread_join(m->thread, NULL);
+	free(m->addrs);
+	m->addrs = NULL;
+	m->started = false;
+}
+
+/*
+ *  migrate_start()
+ *	start moving the pages in RAM of the selection
+ *	to a node on a worker thread
+ */
+static void migrate_start(migrate_t *const m, const int node)
+{
+	const uint8_t *const states = g.mem_info.pyramid.states;
+	index_t first, end, idx;
+
+	if (m->started && !__atomic_load_n(&m->end_ns, __ATOMIC_ACQUIRE))
+		return;
+	migrate_stop(m);
+	if (!selection_range(&first, &end))
+		return;
+
+	m->addrs = malloc((size_t)(end - first) * sizeof(*m->addrs));
+	if (!m->addrs)
+		return;
+	m->npages = 0;
+	for (idx = first; idx < end; idx++) {
+		if ((states[idx] != PAGE_STATE_NOT_PRESENT) &&
+		    (states[idx] != PAGE_STATE_SWAPPED))
+			m->addrs[m->npages++] = g.mem_info.pages[idx].addr;
+	}
+	m->done = 0;
+	m->moved = 0;
+	m->end_ns = 0;
+	m->stop = false;
+	m->pid = g.pid;
+	m->node = node;
+	m->start_ns = prof_time_ns();
+	if (pthread_create(&m->thread, NULL, migrate_worker, m) != 0) {
+		free(m->addrs);
+		m->addrs = NULL;
+		return;
+	}
+	m->started = true;
+	/* Show the pages moving */
+	g.numa_view = true;
+}
+
+/*
+ *  show_migrate()
+ *	show the migration progress and throughput
+ *	on the key line
+ */
+static void show_migrate(const migrate_t *const m)
+{
+	const uint64_t done = __atomic_load_n(&m->done, __ATOMIC_ACQUIRE);
+	const uint64_t moved = __atomic_load_n(&m->moved, __ATOMIC_RELAXED);
+	const uint64_t end_ns = __atomic_load_n(&m->end_ns, __ATOMIC_ACQUIRE);
+	const double secs = (double)((end_ns ? end_ns : prof_time_ns()) -
+		m->start_ns) / 1000000000.0;
+	const double mb = (double)moved * g.page_size / (double)MB;
+
+	(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
+	banner(LINES - 1);
+	(void)mvwprintw(g.mainwin, LINES - 1, 0,
+		"%s to node %d: %" PRIu64 "/%" PRIu64 " pages %5.1f%%, "
+		"%" PRIu64 " moved, %.1f MB/s",
+		end_ns ? "Migrated" : "Migrating", m->node, done, m->npages,
+		m->npages ? 100.0 * (double)done / (double)m->npages : 100.0,
+		moved, (secs > 0.0) ? mb / secs : 0.0);
+}
+
+/*
+ *  reclaim_scan()
+ *	read the residency of n page addresses in
+ *	ascending order, contiguous pages are read with
+ *	one pread, returns number of pages in RAM
+ */
+static uint64_t reclaim_scan(
+	const addr_t *const addrs,
+	const uint64_t n,
+	uint8_t *const states)
+{
+	pagemap_t buf[PYRAMID_READ];
+	uint64_t i = 0, present = 0;
+	int fd;
+
+	if ((fd = open(g.path_pagemap, O_RDONLY)) < 0)
+		return 0;
+	while (i < n) {
+		uint64_t run = 1, k;
+		ssize_t ret;
+
+		while ((i + run < n) && (run < PYRAMID_READ) &&
+		       (addrs[i + run] == addrs[i] + run * g.page_size))
+			run++;
+		ret = pread(fd, buf, run * sizeof(pagemap_t),
+			(off_t)((addrs[i] / g.page_size) * sizeof(pagemap_t)));
+		for (k = 0; k < run; k++) {
+			states[i + k] = (ret == (ssize_t)(run * sizeof(pagemap_t))) ?
+				page_residency(buf[k]) : PAGE_STATE_NOT_PRESENT;
+			if (states[i + k] == PAGE_STATE_PRESENT)
+				present++;
+		}
+		i += run;
+	}
+	(void)close(fd);
+
+	return present;
+}
+
+/*
+ *  reclaim_faults()
+ *	user space page faults counted by perf,
+ *	0 if the tracepoint is not available
+ */
+static uint64_t reclaim_faults(void)
+{
+#if defined(PERF_ENABLED)
+	const int id = perf_find(&g.perf, "page_fault_user");
+
+	(void)perf_read(&g.perf);
+	return perf_counter(&g.perf, id);
+#else
+	return 0;
+#endif
+}
+
+/*
+ *  reclaim_advise()
+ *	apply advice to the selection with process_madvise,
+ *	one iovec per map in the selection, batched up to
+ *	RECLAIM_IOV iovecs per call. Returns 0 or an errno
+ */
+static int reclaim_advise(const addr_t lo, const addr_t hi, const int advice)
+{
+#if defined(__NR_process_madvise)
+	struct iovec iov[RECLAIM_IOV];
+	uint32_t i = map_lookup(lo);
+	int pidfd = g.pidfd, err = 0;
+
+	if (pidfd < 0)
+		pidfd = proc_pidfd_open(g.pid);
+	if (pidfd < 0)
+		return errno;
+
+	while ((i < g.mem_info.nmaps) && (g.mem_info.maps[i].begin <= hi)) {
+		size_t n = 0;
+
+		for (; (i < g.mem_info.nmaps) && (g.mem_info.maps[i].begin <= hi) &&
+		       (n < RECLAIM_IOV); i++) {
+			const map_t *map = &g.mem_info.maps[i];
+			const addr_t begin = MAXIMUM(lo, map->begin);
+			const addr_t end = MINIMUM(hi + g.page_size, map->end);
+
+			iov[n].iov_base = (void *)(uintptr_t)begin;
+			iov[n].iov_len = (size_t)(end - begin);
+			n++;
+		}
+		if (syscall(__NR_process_madvise, pidfd, iov, n, advice, 0) < 0) {
+			err = errno;
+			break;
+		}
+	}
+	if (pidfd != g.pidfd)
+		(void)close(pidfd);
+	return err;
+#else
+	(void)lo;
+	(void)hi;
+	(void)advice;
+	return ENOSYS;
+#endif
+}
+
+/*
+ *  reclaim_free()
+ *	free the reclaim experiment
+ */
+static void reclaim_free(reclaim_t *const r)
+{
+	free(r->addrs);
+	free(r->left);
+	free(r->states);
+	r->addrs = NULL;
+	r->left = NULL;
+	r->states = NULL;
+	r->active = false;
+}
+
+/*
+ *  reclaim_start()
+ *	push the selection out with MADV_COLD or MADV_PAGEOUT
+ *	and measure how many of its pages in RAM left it
+ */
+static void reclaim_start(reclaim_t *const r, const int advice)
+{
+	const addr_t lo = MINIMUM(g.sel_begin, g.sel_end);
+	const addr_t hi = MAXIMUM(g.sel_begin, g.sel_end);
+	index_t first, end, idx;
+	uint64_t i, n, t;
+
+	reclaim_free(r);
+	if (!selection_range(&first, &end))
+		return;
+	r->selected = (uint64_t)(end - first);
+	r->addrs = malloc(r->selected * sizeof(*r->addrs));
+	r->states = malloc(r->selected);
+	r->left = calloc(r->selected, 1);
+	if (!r->addrs || !r->states || !r->left) {
+		reclaim_free(r);
+		return;
+	}
+
+	/* The pages in RAM now are the ones that can leave it */
+	for (idx = first; idx < end; idx++)
+		r->addrs[idx - first] = g.mem_info.pages[idx].addr;
+	(void)reclaim_scan(r->addrs, r->selected, r->states);
+	for (i = 0, n = 0; i < r->selected; i++) {
+		if (r->states[i] == PAGE_STATE_PRESENT)
+			r->addrs[n++] = r->addrs[i];
+	}
+	r->before = n;
+
+	t = prof_time_ns();
+	r->err = reclaim_advise(lo, hi, advice);
+	r->start_ns = prof_time_ns();
+	r->advise_ns = r->start_ns - t;
+
+	r->resident = reclaim_scan(r->addrs, r->before, r->states);
+	r->swapped = 0;
+	for (i = 0; i < r->before; i++) {
+		r->left[i] = (r->states[i] != PAGE_STATE_PRESENT);
+		if (r->states[i] == PAGE_STATE_SWAPPED)
+			r->swapped++;
+	}
+	r->refaulted = 0;
+	r->half_ns = 0;
+	r->scan_ns = r->start_ns;
+	r->faults = reclaim_faults();
+	r->majflt = g.vm.majflt;
+	r->minflt = g.vm.minflt;
+	r->advice = advice;
+	r->active = true;
+}
+
+/*
+ *  reclaim_update()
+ *	count the pages that left RAM and have been
+ *	faulted back in, every RECLAIM_SCAN_NS
+ */
+static void reclaim_update(reclaim_t *const r)
+{
+	const uint64_t now = prof_time_ns();
+	const uint64_t left = r->before - r->resident;
+	uint64_t i, refaulted = 0;
+
+	if (!r->active || (now - r->scan_ns < RECLAIM_SCAN_NS))
+		return;
+	r->scan_ns = now;
+	(void)reclaim_scan(r->addrs, r->before, r->states);
+	for (i = 0; i < r->before; i++) {
+		if (r->left[i] && (r->states[i] == PAGE_STATE_PRESENT))
+			refaulted++;
+	}
+	r->refaulted = refaulted;
+	if (!r->half_ns && left && (refaulted * 2 >= left))
+		r->half_ns = now - r->start_ns;
+}
+
+/*
+ *  show_reclaim()
+ *	show the reclaim cost report
+ */
+static void show_reclaim(const reclaim_t *const r)
+{
+	const uint64_t left = r->before - r->resident;
+	const double secs = (double)(prof_time_ns() - r->start_ns) / 1000000000.0;
+	const double advise_secs = (double)r->advise_ns / 1000000000.0;
+	const int x = COLS - 50;
+	int y = 2;
+	char buf[16];
+
+	(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
+	(void)mvwprintw(g.mainwin, y++, x, " Reclaim: %-12s %25s",
+		(r->advice == MADV_PAGEOUT) ? "MADV_PAGEOUT" : "MADV_COLD",
+		r->err ? strerror(r->err) : "");
+	(void)mvwprintw(g.mainwin, y++, x, " Selected Pages:     %10" PRIu64 "%17s",
+		r->selected, "");
+	(void)mvwprintw(g.mainwin, y++, x, " In RAM Before:      %10" PRIu64 "%17s",
+		r->before, "");
+	(void)mvwprintw(g.mainwin, y++, x, " Left RAM:           %10" PRIu64
+		" %5.1f%%%10s", left,
+		r->before ? 100.0 * (double)left / (double)r->before : 0.0, "");
+	(void)mvwprintw(g.mainwin, y++, x, "   Swapped Out:      %10" PRIu64 "%17s",
+		r->swapped, "");
+	(void)mvwprintw(g.mainwin, y++, x, "   Dropped:          %10" PRIu64 "%17s",
+		left - r->swapped, "");
+	mem_to_str((addr_t)(left * g.page_size), buf, sizeof(buf));
+	(void)mvwprintw(g.mainwin, y++, x, " Advice Took:        %10.3f ms %7.0f MB/s ",
+		advise_secs * 1000.0, (advise_secs > 0.0) ?
+		(double)(left * g.page_size) / (double)MB / advise_secs : 0.0);
+	(void)mvwprintw(g.mainwin, y++, x, " Reclaimed:          %s%18s", buf, "");
+	(void)mvwprintw(g.mainwin, y++, x, " Refaulted:          %10" PRIu64
+		" %5.1f%%%10s", r->refaulted,
+		left ? 100.0 * (double)r->refaulted / (double)left : 0.0, "");
+	if (r->half_ns)
+		(void)mvwprintw(g.mainwin, y++, x, " Half Refaulted In:  %10.3f s%15s",
+			(double)r->half_ns / 1000000000.0, "");
+	else
+		(void)mvwprintw(g.mainwin, y++, x, " Half Refaulted In:  %10s s%15s",
+			"-", "");
+#if defined(PERF_ENABLED)
+	(void)mvwprintw(g.mainwin, y++, x, " User Faults Since:  %10" PRIu64 "%17s",
+		reclaim_faults() - r->faults, "");
+#endif
+	(void)mvwprintw(g.mainwin, y++, x, " Major Faults Since: %10" PRIu64 "%17s",
+		g.vm.majflt - r->majflt, "");
+	(void)mvwprintw(g.mainwin, y++, x, " Minor Faults Since: %10" PRIu64 "%17s",
+		g.vm.minflt - r->minflt, "");
+	(void)mvwprintw(g.mainwin, y, x, " Time Since Advice:  %10.1f s%15s",
+		secs, "");
+}
+
+/*
+ *  show_pressure()
+ *	show the cgroup memory pressure, the page state
+ *	transition rates and the transitions seen while
+ *	the pressure was over the threshold
+ */
+static void show_pressure(const pressure_t *const pr)
+{
+	const size_t path_len = strlen(pr->path);
+	const int x = 2;
+	int y = 2;
+	uint32_t i;
+	char current[16], max[16];
+
+	(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
+	if (!pr->valid) {
+		(void)mvwprintw(g.mainwin, y++, x, " %-56s ",
+			"No cgroup v2 memory controller found");
+	} else {
+		(void)mvwprintw(g.mainwin, y++, x, " cgroup: %-48s ",
+			pr->path + ((path_len > 48) ? path_len - 48 : 0));
+		mem_to_str((addr_t)pr->current, current, sizeof(current));
+		if (pr->max)
+			mem_to_str((addr_t)pr->max, max, sizeof(max));
+		else
+			(void)snprintf(max, sizeof(max), "%9s", "unlimited");
+		if (pr->fd_current >= 0)
+			(void)mvwprintw(g.mainwin, y++, x,
+				" Current: %s    Max: %s%21s", current, max, "");
+		if (pr->have_psi) {
+			(void)mvwprintw(g.mainwin, y++, x,
+				" PSI Some avg10: %6.2f%%  Stall: %10.2f ms/s%10s",
+				pr->some_avg10, pr->some_rate, "");
+			(void)mvwprintw(g.mainwin, y++, x,
+				" PSI Full avg10: %6.2f%%  Stall: %10.2f ms/s%10s",
+				pr->full_avg10, pr->full_rate, "");
+		}
+		(void)mvwprintw(g.mainwin, y++, x,
+			" Refaults Anon: %10.0f /s  File: %10.0f /s%8s",
+			pr->stat_rate[PSTAT_REFAULT_ANON],
+			pr->stat_rate[PSTAT_REFAULT_FILE], "");
+		(void)mvwprintw(g.mainwin, y++, x,
+			" Scanned:       %10.0f /s  Stolen: %8.0f /s%8s",
+			pr->stat_rate[PSTAT_PGSCAN],
+			pr->stat_rate[PSTAT_PGSTEAL], "");
+	}
+	(void)mvwprintw(g.mainwin, y++, x,
+		" Swapped Out:   %10.0f /s  In:   %10.0f /s%8s",
+		pr->change_rate[CHANGE_SWAP_OUT],
+		pr->change_rate[CHANGE_SWAP_IN], "");
+	(void)mvwprintw(g.mainwin, y++, x,
+		" Dropped:       %10.0f /s  Faulted In: %4.0f /s%8s",
+		pr->change_rate[CHANGE_DROPPED],
+		pr->change_rate[CHANGE_FAULTED], "");
+	(void)mvwprintw(g.mainwin, y++, x,
+		" Pages moved when PSI some avg10 >= %4.1f%%:%16s",
+		PRESSURE_THRESHOLD, "");
+	(void)mvwprintw(g.mainwin, y++, x,
+		" Time       Some%%   Full%% SwapOut  SwapIn Dropped Faulted ");
+	for (i = 0; i < pr->count; i++) {
+		const pressure_event_t *event =
+			&pr->events[(pr->head + PRESSURE_EVENTS - 1 - i) % PRESSURE_EVENTS];
+		struct tm tm;
+		char when[16];
+
+		(void)localtime_r(&event->when, &tm);
+		(void)strftime(when, sizeof(when), "%H:%M:%S", &tm);
+		(void)mvwprintw(g.mainwin, y++, x,
+			" %-8s  %6.2f  %6.2f %7" PRIu64 " %7" PRIu64
+			" %7" PRIu64 " %7" PRIu64 " ", when,
+			event->some, event->full,
+			event->changes[CHANGE_SWAP_OUT],
+			event->changes[CHANGE_SWAP_IN],
+			event->changes[CHANGE_DROPPED],
+			event->changes[CHANGE_FAULTED]);
+	}
+	if (!pr->count)
+		(void)mvwprintw(g.mainwin, y, x, " %-56s ", "None");
+}
+
+/*
+ *  swapmap_devs()
+ *	look up the swap devices in /proc/swaps, swap type n
+ *	is the nth entry. The cost of a swap-in I/O is guessed
+ *	from the kind of device the swap area is on
+ */
+static void swapmap_devs(swapmap_t *const sm)
+{
+	FILE *fp;
+	char line[PROCPATH_MAX + 128], buf[32];
+
+	sm->ndevs = 0;
+	sm->page_cluster = (read_buf("/proc/sys/vm/page-cluster", buf,
+		sizeof(buf)) < 0) ? 3 : (uint32_t)atoi(buf);
+	if (sm->page_cluster > 10)
+		sm->page_cluster = 10;
+
+	fp = fopen("/proc/swaps", "r");
+	if (!fp)
+		return;
+	/* Skip the heading */
+	if (!fgets(line, sizeof(line), fp))
+		goto close_fp;
+	while ((sm->ndevs < SWAPMAP_DEVS_MAX) && fgets(line, sizeof(line), fp)) {
+		swap_dev_t *const dev = &sm->devs[sm->ndevs++];
+		char path[PROCPATH_MAX], rot[8];
+		const char *name;
+		struct stat statbuf;
+		dev_t devno;
+
+		line[strcspn(line, " \t")] = '\0';
+		name = strrchr(line, '/');
+		name = name ? name + 1 : line;
+		(void)snprintf(dev->name, sizeof(dev->name), "%.*s",
+			(int)sizeof(dev->name) - 1, name);
+		dev->kind = SWAP_DEV_SSD;
+		dev->pages = 0;
+		if (!strncmp(name, "zram", 4)) {
+			dev->kind = SWAP_DEV_ZRAM;
+			continue;
+		}
+		if (stat(line, &statbuf) < 0)
+			continue;
+		/* The device itself, or the one a swap file is on */
+		devno = S_ISBLK(statbuf.st_mode) ? statbuf.st_rdev : statbuf.st_dev;
+		(void)snprintf(path, sizeof(path),
+			"/sys/dev/block/%u:%u/queue/rotational",
+			major(devno), minor(devno));
+		if (read_buf(path, rot, sizeof(rot)) < 0) {
+			/* A partition, the queue is its disk's */
+			(void)snprintf(path, sizeof(path),
+				"/sys/dev/block/%u:%u/../queue/rotational",
+				major(devno), minor(devno));
+			if (read_buf(path, rot, sizeof(rot)) < 0)
+				continue;
+		}
+		if (rot[0] == '1')
+			dev->kind = SWAP_DEV_HDD;
+	}
+close_fp:
+	(void)fclose(fp);
+}
+
+/*
+ *  swapmap_cmp()
+ *	order swap slots by type and offset
+ */
+static int swapmap_cmp(const void *p1, const void *p2)
+{
+	const uint64_t s1 = *(const uint64_t *)p1;
+	const uint64_t s2 = *(const uint64_t *)p2;
+
+	return (s1 > s2) - (s1 < s2);
+}
+
+/*
+ *  swapmap_map()
+ *	sort the swap slots of a map and find the runs of
+ *	consecutive slots. Swap-in reads the aligned cluster
+ *	of 2^page-cluster slots around a faulting slot, so
+ *	each distinct cluster touched is one I/O
+ */
+static void swapmap_map(
+	swapmap_t *const sm,
+	const map_t *const map,
+	uint64_t *const slots,
+	const size_t n)
+{
+	swap_map_stat_t *stat;
+	uint64_t run = 0, prev = 0, prev_cluster = ~0ULL;
+	size_t i;
+
+	if (sm->nstats >= sm->stats_size) {
+		const size_t size = sm->stats_size ? sm->stats_size * 2 : 64;
+		swap_map_stat_t *stats = realloc(sm->stats, size * sizeof(*stats));
+
+		if (!stats)
+			return;
+		sm->stats = stats;
+		sm->stats_size = size;
+	}
+	stat = &sm->stats[sm->nstats++];
+	(void)memset(stat, 0, sizeof(*stat));
+	stat->begin = map->begin;
+	(void)snprintf(stat->name, sizeof(stat->name), "%.*s",
+		(int)sizeof(stat->name) - 1, map_basename(map));
+	stat->pages = n;
+
+	qsort(slots, n, sizeof(*slots), swapmap_cmp);
+	for (i = 0; i < n; i++) {
+		const uint64_t slot = slots[i];
+		const uint32_t type = (uint32_t)(slot >> SWAPMAP_TYPE_SHIFT);
+		const uint64_t cluster = slot >> sm->page_cluster;
+
+		if (i && (slot == prev + 1)) {
+			run++;
+		} else {
+			stat->runs++;
+			run = 1;
+		}
+		stat->max_run = MAXIMUM(stat->max_run, run);
+		if (cluster != prev_cluster) {
+			static const uint32_t io_us[] = {
+				SWAP_IO_SSD_US,		/* SWAP_DEV_SSD */
+				SWAP_IO_HDD_US,		/* SWAP_DEV_HDD */
+				SWAP_IO_ZRAM_US,	/* SWAP_DEV_ZRAM */
+			};
+
+			stat->ios++;
+			stat->est_us += io_us[(type < sm->ndevs) ?
+				sm->devs[type].kind : SWAP_DEV_SSD];
+			prev_cluster = cluster;
+		}
+		if (type < sm->ndevs)
+			sm->devs[type].pages++;
+		if (type < 32)
+			stat->types |= 1U << type;
+		prev = slot;
+	}
+}
+
+/*
+ *  swapmap_stat_cmp()
+ *	order maps by estimated swap-in time, slowest first
+ */
+static int swapmap_stat_cmp(const void *p1, const void *p2)
+{
+	const swap_map_stat_t *s1 = (const swap_map_stat_t *)p1;
+	const swap_map_stat_t *s2 = (const swap_map_stat_t *)p2;
+
+	return (s1->est_us < s2->est_us) - (s1->est_us > s2->est_us);
+}
+
+/*
+ *  swapmap_scan()
+ *	read the pagemap of every page in one pass, collecting
+ *	the swap type and offset of each swapped page map by
+ *	map, and work out the swap layout of each map. The
+ *	page states seen are fed back into the pyramid too
+ */
+static void swapmap_scan(swapmap_t *const sm)
+{
+	pagemap_t buf[PYRAMID_READ];
+	prof_t prof;
+	uint32_t i;
+	int fd;
+
+	sm->nstats = 0;
+	sm->pages = 0;
+	swapmap_devs(sm);
+
+	prof_begin(&prof, PROF_PAGEMAP);
+	fd = open(g.path_pagemap, O_RDONLY);
+	if (fd < 0)
+		goto done;
+	prof_syscall(0);
+
+	for (i = 0; i < g.mem_info.nmaps; i++) {
+		const map_t *const map = &g.mem_info.maps[i];
+		const index_t end = map->first +
+			(index_t)((map->end - map->begin) / g.page_size);
+		index_t idx = map->first;
+		size_t n = 0;
+
+		while (idx < end) {
+			const index_t count = MINIMUM(end - idx, PYRAMID_READ);
+			const addr_t addr = g.mem_info.pages[idx].addr;
+			ssize_t ret;
+			index_t k;
+
+			ret = pread(fd, buf, (size_t)count * sizeof(pagemap_t),
+				(off_t)((addr / g.page_size) * sizeof(pagemap_t)));
+			prof_syscall(ret);
+			if (ret <= 0)
+				break;
+			for (k = 0; k < (index_t)(ret / (ssize_t)sizeof(pagemap_t)); k++) {
+				const pagemap_t pm = buf[k];
+
+				pyramid_set(idx + k, pm);
+				if (!(pm & PAGE_SWAPPED))
+					continue;
+				if (n >= sm->slots_size) {
+					const size_t size = sm->slots_size ?
+						sm->slots_size * 2 : 4096;
+					uint64_t *slots = realloc(sm->slots,
+						size * sizeof(*slots));
+
+					if (!slots)
+						goto close_fd;
+					sm->slots = slots;
+					sm->slots_size = size;
+				}
+				/* Type in bits 0-4, offset in bits 5-54 */
+				sm->slots[n++] = ((pm & 0x1f) << SWAPMAP_TYPE_SHIFT) |
+					((pm & PAGE_PFN_MASK) >> 5);
+			}
+			idx += count;
+		}
+		if (n) {
+			swapmap_map(sm, map, sm->slots, n);
+			sm->pages += n;
+		}
+	}
+	qsort(sm->stats, sm->nstats, sizeof(*sm->stats), swapmap_stat_cmp);
+close_fd:
+	(void)close(fd);
+	prof_syscall(0);
+done:
+	prof_end(&prof);
+	sm->scan_ns = prof_time_ns();
+	sm->scan_time_ns = sm->scan_ns - prof.start_ns;
+}
+
+/*
+ *  swapmap_free()
+ *	free the swap layout analysis
+ */
+static void swapmap_free(swapmap_t *const sm)
+{
+	free(sm->slots);
+	free(sm->stats);
+	(void)memset(sm, 0, sizeof(*sm));
+}
+
+/*
+ *  physmap_zone_cmp()
+ *	order zones by first PFN
+ */
+static int physmap_zone_cmp(const void *p1, const void *p2)
+{
+	const phys_zone_t *z1 = (const phys_zone_t *)p1;
+	const phys_zone_t *z2 = (const phys_zone_t *)p2;
+
+	return (z1->start > z2->start) - (z1->start < z2->start);
+}
+
+/*
+ *  physmap_zones()
+ *	read the PFN span of each populated zone
+ *	from /proc/zoneinfo
+ */
+static void physmap_zones(physmap_t *const pm)
+{
+	FILE *fp;
+	char line[256];
+	phys_zone_t *zone = NULL;
+	uint64_t spanned[PHYSMAP_ZONES_MAX];
+	uint32_t i, n;
+
+	pm->nzones = 0;
+	if (g.offline)
+		return;
+	fp = fopen("/proc/zoneinfo", "r");
+	if (!fp)
+		return;
+	while (fgets(line, sizeof(line), fp)) {
+		unsigned long long val;
+		unsigned int node;
+		char name[sizeof(zone->name)];
+
+		if (sscanf(line, "Node %u, zone %11s", &node, name) == 2) {
+			zone = NULL;
+			if (pm->nzones >= PHYSMAP_ZONES_MAX)
+				continue;
+			spanned[pm->nzones] = 0;
+			zone = &pm->zones[pm->nzones++];
+			(void)memset(zone, 0, sizeof(*zone));
+			(void)memcpy(zone->name, name, sizeof(zone->name));
+			zone->node = node;
+		} else if (!zone) {
+			continue;
+		} else if (sscanf(line, " spanned %llu", &val) == 1) {
+			spanned[zone - pm->zones] = val;
+		} else if (sscanf(line, " start_pfn: %llu", &val) == 1) {
+			zone->start = val;
+		}
+	}
+	(void)fclose(fp);
+
+	/* Drop the empty zones */
+	for (n = 0, i = 0; i < pm->nzones; i++) {
+		if (!spanned[i])
+			continue;
+		pm->zones[n] = pm->zones[i];
+		pm->zones[n].end = pm->zones[n].start + spanned[i];
+		n++;
+	}
+	pm->nzones = n;
+	qsort(pm->zones, n, sizeof(*pm->zones), physmap_zone_cmp);
+}
+
+/*
+ *  physmap_sort()
+ *	LSD radix sort of n PFNs, only as many passes as
+ *	the highest PFN needs, so sorting is linear in the
+ *	number of pages. Returns a or tmp, whichever ends
+ *	up holding the sorted PFNs
+ */
+static uint64_t *physmap_sort(
+	uint64_t *a,
+	uint64_t *tmp,
+	const size_t n,
+	const uint64_t max)
+{
+	const uint64_t mask = (1ULL << PHYSMAP_RADIX_BITS) - 1;
+	size_t count[1U << PHYSMAP_RADIX_BITS];
+	uint32_t shift;
+
+	for (shift = 0; (shift < 64) && (max >> shift); shift += PHYSMAP_RADIX_BITS) {
+		uint64_t *swap;
+		size_t i, sum = 0;
+
+		(void)memset(count, 0, sizeof(count));
+		for (i = 0; i < n; i++)
+			count[(a[i] >> shift) & mask]++;
+		for (i = 0; i <= mask; i++) {
+			const size_t c = count[i];
+
+			count[i] = sum;
+			sum += c;
+		}
+		for (i = 0; i < n; i++)
+			tmp[count[(a[i] >> shift) & mask]++] = a[i];
+		swap = a;
+		a = tmp;
+		tmp = swap;
+	}
+	return a;
+}
+
+/*
+ *  physmap_map()
+ *	sort the PFNs of a map to find the runs of consecutive
+ *	PFNs however the pages are mapped, and count the pages
+ *	in each zone with one walk along the sorted zones
+ */
+static void physmap_map(
+	physmap_t *const pm,
+	phys_map_stat_t *const stat,
+	const size_t n,
+	const bool sorted,
+	const uint64_t max)
+{
+	const uint64_t *pfns = sorted ? pm->pfns :
+		physmap_sort(pm->pfns, pm->tmp, n, max);
+	uint64_t run = 0;
+	uint32_t z = 0;
+	size_t i;
+
+	stat->pages = n;
+	for (i = 0; i < n; i++) {
+		const uint64_t pfn = pfns[i];
+
+		if (i && (pfn == pfns[i - 1] + 1)) {
+			run++;
+		} else {
+			stat->runs++;
+			run = 1;
+		}
+		stat->max_run = MAXIMUM(stat->max_run, run);
+
+		while ((z < pm->nzones) && (pfn >= pm->zones[z].end))
+			z++;
+		if ((z < pm->nzones) && (pfn >= pm->zones[z].start)) {
+			stat->zones[z]++;
+			pm->zones[z].pages++;
+		}
+	}
+}
+
+/*
+ *  physmap_run()
+ *	mark the pages of a run of virtually and physically
+ *	contiguous pages with its length class, and count the
+ *	huge page aligned stretches in it, the ones a PMD can
+ *	map. Those need ascending PFNs and the virtual and
+ *	physical addresses the same distance from a huge page
+ *	boundary. Runs of descending PFNs are contiguous too,
+ *	the page allocator often hands out pages that way
+ */
+static void physmap_run(
+	physmap_t *const pm,
+	phys_map_stat_t *const stat,
+	const index_t start,
+	const uint64_t len,
+	const uint64_t pfn,
+	const int64_t dir)
+{
+	const uint64_t thp_pages = PHYSMAP_THP_SIZE / g.page_size;
+	const uint64_t vpn = g.mem_info.pages[start].addr / g.page_size;
+	uint8_t run;
+
+	if (!len)
+		return;
+	if (len == 1)
+		run = PHYS_RUN_SINGLE;
+	else if (len < 16)
+		run = PHYS_RUN_SHORT;
+	else if (len < thp_pages)
+		run = PHYS_RUN_LONG;
+	else
+		run = PHYS_RUN_HUGE;
+	(void)memset(pm->runs + start, run, (size_t)len);
+
+	if ((dir > 0) && (len >= thp_pages) && !((vpn - pfn) & (thp_pages - 1))) {
+		const uint64_t skip = (thp_pages - (pfn & (thp_pages - 1))) &
+				      (thp_pages - 1);
+
+		if (len >= skip + thp_pages)
+			stat->thp_mapped += (len - skip) / thp_pages;
+	}
+}
+
+/*
+ *  physmap_stat()
+ *	a new map stat, or NULL if out of memory
+ */
+static phys_map_stat_t *physmap_stat(physmap_t *const pm, const map_t *const map)
+{
+	phys_map_stat_t *stat;
+
+	if (pm->nstats >= pm->stats_size) {
+		const size_t size = pm->stats_size ? pm->stats_size * 2 : 64;
+		phys_map_stat_t *stats = realloc(pm->stats, size * sizeof(*stats));
+
+		if (!stats)
+			return NULL;
+		pm->stats = stats;
+		pm->stats_size = size;
+	}
+	stat = &pm->stats[pm->nstats++];
+	(void)memset(stat, 0, sizeof(*stat));
+	stat->begin = map->begin;
+	return stat;
+}
+
+/*
+ *  physmap_pfns()
+ *	grow the PFN and radix sort buffers, false if out of memory
+ */
+static bool physmap_pfns(physmap_t *const pm)
+{
+	const size_t size = pm->pfns_size ? pm->pfns_size * 2 : 4096;
+	uint64_t *pfns, *tmp;
+
+	pfns = realloc(pm->pfns, size * sizeof(*pfns));
+	if (!pfns)
+		return false;
+	pm->pfns = pfns;
+	tmp = realloc(pm->tmp, size * sizeof(*tmp));
+	if (!tmp)
+		return false;
+	pm->tmp = tmp;
+	pm->pfns_size = size;
+	return true;
+}
+
+/*
+ *  physmap_scan()
+ *	read the pagemap of every page in one pass, collecting
+ *	the PFNs of the pages in RAM map by map. The virtually
+ *	contiguous runs of consecutive PFNs give the run class
+ *	of each page and the huge page mapped stretches, the
+ *	huge page aligned ranges of a map with pages in RAM
+ *	that are not huge page mapped are left for khugepaged
+ *	to collapse. The page states seen go into the pyramid
+ */
+static void physmap_scan(physmap_t *const pm)
+{
+	pagemap_t buf[PYRAMID_READ];
+	prof_t prof;
+	uint32_t i;
+	int fd;
+
+	pm->nstats = 0;
+	pm->pages = 0;
+	pm->no_pfn = 0;
+	physmap_zones(pm);
+
+	if (pm->runs_npages != g.mem_info.npages) {
+		uint8_t *runs = realloc(pm->runs, (size_t)MAXIMUM(1, g.mem_info.npages));
+
+		if (!runs)
+			return;
+		pm->runs = runs;
+		pm->runs_npages = g.mem_info.npages;
+	}
+	(void)memset(pm->runs, PHYS_RUN_NONE, (size_t)pm->runs_npages);
+
+	prof_begin(&prof, PROF_PAGEMAP);
+	fd = open(g.path_pagemap, O_RDONLY);
+	if (fd < 0)
+		goto done;
+	prof_syscall(0);
+
+	for (i = 0; i < g.mem_info.nmaps; i++) {
+		const map_t *const map = &g.mem_info.maps[i];
+		const index_t end = map->first +
+			(index_t)((map->end - map->begin) / g.page_size);
+		const uint64_t block_first = (map->begin + PHYSMAP_THP_SIZE - 1) /
+			PHYSMAP_THP_SIZE;
+		const uint64_t block_end = map->end / PHYSMAP_THP_SIZE;
+		phys_map_stat_t *stat = physmap_stat(pm, map);
+		index_t idx = map->first, run_start = 0;
+		uint64_t run_len = 0, run_pfn = 0, prev_pfn = 0, max = 0;
+		int64_t run_dir = 0;
+		uint64_t block = ~0ULL, block_present = 0;
+		bool sorted = true;
+		size_t n = 0;
+
+		if (!stat)
+			break;
+		while (idx < end) {
+			const index_t count = MINIMUM(end - idx, PYRAMID_READ);
+			const addr_t addr = g.mem_info.pages[idx].addr;
+			ssize_t ret;
+			index_t k;
+
+			ret = pread(fd, buf, (size_t)count * sizeof(pagemap_t),
+				(off_t)((addr / g.page_size) * sizeof(pagemap_t)));
+			prof_syscall(ret);
+			if (ret <= 0)
+				break;
+			for (k = 0; k < (index_t)(ret / (ssize_t)sizeof(pagemap_t)); k++) {
+				const pagemap_t pmi = buf[k];
+				const uint64_t pfn = pmi & PAGE_PFN_MASK;
+				const uint64_t b = (addr + (uint64_t)k * g.page_size) /
+					PHYSMAP_THP_SIZE;
+
+				pyramid_set(idx + k, pmi);
+				if (b != block) {
+					if (block_present && (block >= block_first) &&
+					    (block < block_end))
+						stat->thp_eligible++;
+					block = b;
+					block_present = 0;
+				}
+				if (!(pmi & PAGE_PRESENT) || !pfn) {
+					if (pmi & PAGE_PRESENT)
+						pm->no_pfn++;
+					physmap_run(pm, stat, run_start, run_len,
+						run_pfn, run_dir);
+					run_len = 0;
+					continue;
+				}
+				block_present++;
+				if ((n >= pm->pfns_size) && !physmap_pfns(pm))
+					goto close_fd;
+				pm->pfns[n++] = pfn;
+				if (pfn < max)
+					sorted = false;
+				max = MAXIMUM(max, pfn);
+				if ((run_len == 1) && ((pfn == prev_pfn + 1) ||
+				    (pfn == prev_pfn - 1))) {
+					run_dir = (int64_t)(pfn - prev_pfn);
+					run_len++;
+				} else if ((run_len > 1) &&
+					   (pfn == prev_pfn + (uint64_t)run_dir)) {
+					run_len++;
+				} else {
+					physmap_run(pm, stat, run_start, run_len,
+						run_pfn, run_dir);
+					run_start = idx + k;
+					run_pfn = pfn;
+					run_len = 1;
+					run_dir = 0;
+				}
+				prev_pfn = pfn;
+			}
+			idx += count;
+		}
+		physmap_run(pm, stat, run_start, run_len, run_pfn, run_dir);
+		if (block_present && (block >= block_first) && (block < block_end))
+			stat->thp_eligible++;
+		if (!n) {
+			pm->nstats--;
+			continue;
+		}
+		stat->thp_eligible -= MINIMUM(stat->thp_eligible, stat->thp_mapped);
+		physmap_map(pm, stat, n, sorted, max);
+		pm->pages += n;
+	}
+close_fd:
+	(void)close(fd);
+	prof_syscall(0);
+done:
+	prof_end(&prof);
+	pm->scan_ns = prof_time_ns();
+	pm->scan_time_ns = pm->scan_ns - prof.start_ns;
+}
+
+/*
+ *  physmap_free()
+ *	free the physical contiguity analysis
+ */
+static void physmap_free(physmap_t *const pm)
+{
+	free(pm->pfns);
+	free(pm->tmp);
+	free(pm->runs);
+	free(pm->stats);
+	(void)memset(pm, 0, sizeof(*pm));
+}
+
+/*
+ *  show_swapmap()
+ *	show the swap devices and the swap layout of the
+ *	maps that would take longest to swap back in
+ */
+static void show_swapmap(const swapmap_t *const sm)
+{
+	static const char *const kinds[] = {
+		"SSD",		/* SWAP_DEV_SSD */
+		"HDD",		/* SWAP_DEV_HDD */
+		"zram",		/* SWAP_DEV_ZRAM */
+	};
+	const int x = (COLS - 76) / 2;
+	int y = 2;
+	uint64_t ios = 0, est_us = 0;
+	size_t i;
+
+	for (i = 0; i < sm->nstats; i++) {
+		ios += sm->stats[i].ios;
+		est_us += sm->stats[i].est_us;
+	}
+
+	(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
+	(void)mvwprintw(g.mainwin, y++, x,
+		" Swapped Pages: %10" PRIu64 "  Swap-in I/Os: %10" PRIu64
+		"  Est: %10.1f ms%3s", sm->pages, ios, (double)est_us / 1000.0, "");
+	(void)mvwprintw(g.mainwin, y++, x,
+		" Page Cluster: %3" PRIu32 " pages%14sScan Took: %10.3f ms%14s",
+		1U << sm->page_cluster, "",
+		(double)sm->scan_time_ns / 1000000.0, "");
+	for (i = 0; i < sm->ndevs; i++)
+		(void)mvwprintw(g.mainwin, y++, x,
+			" Type %2zu: %-24.24s %-4s %10" PRIu64 " pages%20s",
+			i, sm->devs[i].name, kinds[sm->devs[i].kind],
+			sm->devs[i].pages, "");
+	(void)mvwprintw(g.mainwin, y++, x,
+		" %-18s %9s %4s %8s %7s %5s %8s %8s ",
+		"Map", "Swapped", "Type", "Runs", "MaxRun", "Frag", "I/Os", "Est ms");
+	for (i = 0; (i < sm->nstats) && (y < LINES - 2); i++) {
+		const swap_map_stat_t *stat = &sm->stats[i];
+		char type[8];
+
+		/* Lowest swap type, + if on more than one */
+		(void)snprintf(type, sizeof(type), "%u%s",
+			(unsigned int)__builtin_ctz(stat->types | 0x80000000U),
+			(stat->types & (stat->types - 1)) ? "+" : "");
+		(void)mvwprintw(g.mainwin, y++, x,
+			" %-18.18s %9" PRIu64 " %4s %8" PRIu64 " %7" PRIu64
+			" %4.0f%% %8" PRIu64 " %8.1f ",
+			stat->name, stat->pages, type, stat->runs, stat->max_run,
+			(stat->pages > 1) ? 100.0 * (double)(stat->runs - 1) /
+				(double)(stat->pages - 1) : 0.0,
+			stat->ios, (double)stat->est_us / 1000.0);
+	}
+	if (!sm->nstats)
+		(void)mvwprintw(g.mainwin, y, x, " %-74s ", "No pages in swap");
+}
+
+/*
+ *  show_key()
+ *	show key for mapping info
+ */
+static inline void show_key(void)
+{
+	banner(LINES - 1);
+	if (g.view == VIEW_PAGE) {
+		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
+		(void)mvwprintw(g.mainwin, LINES - 1, 0,
+			g.va_view ? "Addr View: " : "Page View: ");
+		if (g.phys_view) {
+			int i;
+
+			for (i = PHYS_RUN_SINGLE; i < PHYS_RUN_MAX; i++) {
+				(void)wattrset(g.mainwin, COLOR_PAIR(phys_runs[i].pair));
+				(void)wprintw(g.mainwin, "%c", phys_runs[i].ch);
+			}
+			(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
+			(void)wprintw(g.mainwin, " PFN Run 1, <16, <2M, 2M+, ");
+			goto swap;
+		}
+		if (g.numa_view) {
+			size_t i;
+
+			for (i = 0; i < NUMA_PAIRS; i++) {
+				(void)wattrset(g.mainwin, COLOR_PAIR(numa_pairs[i]));
+				(void)wprintw(g.mainwin, "%zu", i);
+			}
+			(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
+			(void)wprintw(g.mainwin, " NUMA Node of pages in RAM, ");
+			goto swap;
+		}
+		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_RED));
+		(void)wprintw(g.mainwin, "A");
+		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
+		(void)wprintw(g.mainwin, " Anon/File, ");
+		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_YELLOW));
+		(void)wprintw(g.mainwin, "P");
+		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
+		(void)wprintw(g.mainwin, " Present in RAM, ");
+		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_CYAN));
+		(void)wprintw(g.mainwin, "D");
+		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
+		(void)wprintw(g.mainwin, " Dirty, ");
+swap:
+		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_GREEN));
+		(void)wprintw(g.mainwin, "S");
+		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
+		(void)wprintw(g.mainwin, " Swap, ");
+		(void)wattrset(g.mainwin, COLOR_PAIR(BLACK_WHITE));
+		(void)wprintw(g.mainwin, ".");
+		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
+		(void)wprintw(g.mainwin, " not in RAM");
+		if (g.cache_view) {
+			(void)wprintw(g.mainwin, ", ");
+			(void)wattrset(g.mainwin, COLOR_PAIR(BLUE_WHITE) | A_BOLD);
+			(void)wprintw(g.mainwin, "c");
+			(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
+			(void)wprintw(g.mainwin, " File Cached");
+		}
+#if defined(PERF_ENABLED)
+		if (g.fault_view) {
+			(void)wprintw(g.mainwin, ", ");
+			(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_RED) | A_BOLD);
+			(void)wprintw(g.mainwin, "F");
+			(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
+			(void)wprintw(g.mainwin, " Faulting");
+		}
+#endif
+		(void)wattrset(g.mainwin, COLOR_PAIR(BLACK_WHITE) | A_BOLD);
+	} else {
+		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
+		(void)mvwprintw(g.mainwin, LINES - 1, 0, "%-*s", COLS, "Memory View");
+	}
+
+	if (g.prompt != PROMPT_NONE) {
+		index_t first = 0, end = 0;
+
+		(void)selection_range(&first, &end);
+		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_RED) | A_BOLD);
+		banner(LINES - 1);
+		if (g.prompt == PROMPT_MIGRATE)
+			(void)mvwprintw(g.mainwin, LINES - 1, 0,
+				"Migrate the %" PRId64 " selected pages to "
+				"NUMA node [0-9]: ", (int64_t)(end - first));
+		else
+			(void)mvwprintw(g.mainwin, LINES - 1, 0,
+				"Reclaim the %" PRId64 " selected pages with "
+				"c MADV_COLD or p MADV_PAGEOUT: ",
+				(int64_t)(end - first));
+	} else if (g.migrate.started) {
+		show_migrate(&g.migrate);
+	}
+}
+
+/*
+ *  show_help()
+ *	show pop-up help info
+ */
+static inline void show_help(void)
+{
+	const int x = (COLS - 45) / 2;
+	int y = (LINES - 27) / 2;
+
+	(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_RED) | A_BOLD);
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" Pagemon Process Memory Monitor Quick Help ");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		"%43s", "");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" ? or h     This help information%10s", "");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" Esc or q   Quit%27s", "");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" Tab        Toggle page information%8s", "");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" Enter      Toggle map/memory views%8s", "");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" + or z     Zoom in memory map%13s", "");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" - or Z     Zoom out memory map%12s", "");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" R or r     Read pages (swap in all pages) ");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" A or a     Toggle Auto Zoom on/off        ");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" V or v     Toggle Virtual Memory Stats    ");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" O or o     Toggle Pagemon Overhead Stats  ");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" X or x     Toggle Address Space View      ");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" N or n     Toggle NUMA Node View          ");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" U or u     Toggle cgroup Memory Pressure  ");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" W or w     Toggle Swap Layout Analysis    ");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" B or b     Toggle Page Cache of File Pages");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" Y or y     Toggle Physical Contiguity View");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" I or i     Toggle Dirty Rate Tracking     ");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" m / M      Mark selection / Select map    ");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" G or g     Migrate selection to NUMA node ");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" K or k     Reclaim selection, cost report ");
+#if defined(PERF_ENABLED)
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" P or p     Toggle Perf Page Stats         ");
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" F or f     Toggle Page Fault Sampling     ");
+#endif
+	(void)mvwprintw(g.mainwin, y++,  x,
+		" PgUp/Down  Scroll up/down 1/2 page%8s", "");
+	(void)mvwprintw(g.mainwin, y++, x,
+		" Home/End   Move cursor back to top/bottom ");
+	(void)mvwprintw(g.mainwin, y, x,
+		" [ / ]      Zoom 1 / Zoom 999              ");
+	(void)mvwprintw(g.mainwin, y, x,
+		" Cursor keys move Up/Down/Left/Right%7s", "");
+}
+
+/*
+ *  ansi_write()
+ *	write all of buf to the terminal
+ */
+static int ansi_write(const int fd, const char *buf, size_t len)
+{
+	while (len) {
+		const ssize_t ret = write(fd, buf, len);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += ret;
+		len -= (size_t)ret;
+	}
+	return 0;
+}
+
+/*
+ *  ansi_puts()
+ *	append len bytes of str to the frame
+ */
+static inline void ansi_puts(ansi_t *const a, const char *str, const size_t len)
+{
+	(void)memcpy(a->buf + a->len, str, len);
+	a->len += len;
+}
+
+/* Terminal set up and put back by the direct ANSI output */
+static const char ansi_init[] =
+	"\033[?1049h"		/* Alternate screen */
+	"\033[?25l"		/* Hide cursor */
+	"\033[?1h\033=";	/* Application cursor keys and keypad */
+static const char ansi_fini[] =
+	"\033[0m\033(B"
+	"\033[?1l\033>"		/* Normal cursor keys and keypad */
+	"\033[?25h"		/* Show cursor */
+	"\033[?1049l";		/* Main screen */
+
+/*
+ *  ansi_modes()
+ *	save the terminal modes and turn off line editing
+ *	and echo, curses sets the modes of its output so it
+ *	is done here. Async signal safe for ansi_resume()
+ */
+static void ansi_modes(ansi_t *const a)
+{
+	struct termios tio;
+
+	if (tcgetattr(STDIN_FILENO, &a->saved) < 0)
+		return;
+	tio = a->saved;
+	tio.c_lflag &= ~(tcflag_t)(ICANON | ECHO);
+	tio.c_cc[VMIN] = 1;
+	tio.c_cc[VTIME] = 0;
+	(void)tcsetattr(STDIN_FILENO, TCSANOW, &tio);
+}
+
+/*
+ *  ansi_start()
+ *	set the terminal up for direct output, curses
+ *	still reads and decodes the keys but everything
+ *	it writes goes to /dev/null
+ */
+static int ansi_start(ansi_t *const a)
+{
+	a->fd = STDOUT_FILENO;
+	a->null = fopen("/dev/null", "w");
+	if (!a->null) {
+		(void)fprintf(stderr, "Cannot open /dev/null\n");
+		return -1;
+	}
+	a->screen = newterm(NULL, a->null, stdin);
+	if (!a->screen) {
+		(void)fprintf(stderr, "Cannot set up terminal '%s'\n",
+			getenv("TERM") ? getenv("TERM") : "");
+		(void)fclose(a->null);
+		a->null = NULL;
+		return -1;
+	}
+	(void)set_term(a->screen);
+
+	ansi_modes(a);
+	(void)ansi_write(a->fd, ansi_init, sizeof(ansi_init) - 1);
+	a->started = true;
+
+	return 0;
+}
+
+/*
+ *  ansi_stop()
+ *	put the terminal back as it was
+ */
+static void ansi_stop(ansi_t *const a)
+{
+	if (a->started) {
+		(void)ansi_write(a->fd, ansi_fini, sizeof(ansi_fini) - 1);
+		(void)tcsetattr(STDIN_FILENO, TCSANOW, &a->saved);
+		a->started = false;
+	}
+	if (a->screen) {
+		delscreen(a->screen);
+		a->screen = NULL;
+	}
+	if (a->null) {
+		(void)fclose(a->null);
+		a->null = NULL;
+	}
+	free(a->cells);
+	free(a->line);
+	free(a->buf);
+	a->cells = NULL;
+	a->line = NULL;
+	a->buf = NULL;
+}
+
+/*
+ *  ansi_suspend()
+ *	put the terminal back as it was before SIGTSTP
+ *	stops pagemon, called from the signal handler
+ */
+static void ansi_suspend(ansi_t *const a)
+{
+	if (!a->started)
+		return;
+	(void)ansi_write(a->fd, ansi_fini, sizeof(ansi_fini) - 1);
+	(void)tcsetattr(STDIN_FILENO, TCSANOW, &a->saved);
+}
+
+/*
+ *  ansi_resume()
+ *	set the terminal up again on SIGCONT, the next
+ *	frame writes the whole screen as the shell has
+ *	been using it meanwhile
+ */
+static void ansi_resume(ansi_t *const a)
+{
+	if (!a->started)
+		return;
+	ansi_modes(a);
+	(void)ansi_write(a->fd, ansi_init, sizeof(ansi_init) - 1);
+	a->redraw = 1;
+}
+
+/*
+ *  handle_tstp()
+ *	restore the terminal of the direct ANSI
+ *	output before stopping on SIGTSTP
+ */
+static void handle_tstp(int sig)
+{
+	const int saved_errno = errno;
+
+	(void)sig;
+
+	ansi_suspend(&g.ansi);
+	(void)kill(getpid(), SIGSTOP);
+	errno = saved_errno;
+}
+
+/*
+ *  handle_cont()
+ *	set the terminal up again for the direct
+ *	ANSI output on SIGCONT
+ */
+static void handle_cont(int sig)
+{
+	const int saved_errno = errno;
+
+	(void)sig;
+
+	ansi_resume(&g.ansi);
+	errno = saved_errno;
+}
+
+/*
+ *  ansi_resize()
+ *	size the cells to the screen and start the
+ *	next frame from a cleared terminal
+ */
+static int ansi_resize(ansi_t *const a)
+{
+	static const char clear[] = "\033[0m\033[2J";
+	const size_t ncells = (size_t)LINES * (size_t)COLS;
+	const size_t buf_size = (size_t)LINES *
+		(((size_t)COLS * ANSI_CELL_MAX) + ANSI_ROW_MAX) + sizeof(clear);
+	chtype *cells, *line;
+	const char *rep;
+	char *buf;
+	size_t i;
+
+	cells = realloc(a->cells, ncells * sizeof(*cells));
+	if (!cells)
+		return -1;
+	a->cells = cells;
+	line = realloc(a->line, ((size_t)COLS + 1) * sizeof(*line));
+	if (!line)
+		return -1;
+	a->line = line;
+	buf = realloc(a->buf, buf_size);
+	if (!buf)
+		return -1;
+	a->buf = buf;
+	a->buf_size = buf_size;
+
+	/* What the terminal holds once it has been cleared */
+	for (i = 0; i < ncells; i++)
+		a->cells[i] = ' ';
+	a->lines = LINES;
+	a->cols = COLS;
+	a->row = 0;
+	a->cur_y = -1;
+	a->attr = (chtype)~0;
+	a->len = 0;
+	a->bce = (tigetflag("bce") > 0);
+	rep = tigetstr("rep");
+	a->rep = (rep != NULL) && (rep != (char *)-1);
+	ansi_puts(a, clear, sizeof(clear) - 1);
+
+	return 0;
+}
+
+/*
+ *  ansi_attr()
+ *	switch the terminal to the colour pair, bold
+ *	and character set of attr
+ */
+static void ansi_attr(ansi_t *const a, const chtype attr)
+{
+	const chtype changed = attr ^ a->attr;
+	const bool unknown = (a->attr == (chtype)~0);
+
+	if (unknown || (changed & ~(chtype)A_ALTCHARSET)) {
+		short fg = -1, bg = -1;
+		char sgr[32];
+		int n;
+
+		/* Pair 0 is the terminal's own colours */
+		if (PAIR_NUMBER(attr) &&
+		    (pair_content((short)PAIR_NUMBER(attr), &fg, &bg) == ERR)) {
+			fg = -1;
+			bg = -1;
+		}
+		n = snprintf(sgr, sizeof(sgr), "\033[0%s%s;%d;%dm",
+			(attr & A_BOLD) ? ";1" : "",
+			(attr & A_REVERSE) ? ";7" : "",
+			((fg >= 0) && (fg < 8)) ? 30 + fg : 39,
+			((bg >= 0) && (bg < 8)) ? 40 + bg : 49);
+		ansi_puts(a, sgr, (size_t)n);
+	}
+	if (unknown || (changed & A_ALTCHARSET)) {
+		if (attr & A_ALTCHARSET)
+			ansi_puts(a, "\033(0", 3);
+		else
+			ansi_puts(a, "\033(B", 3);
+	}
+	a->attr = attr;
+}
+
+/*
+ *  ansi_cell()
+ *	write a cell at the terminal cursor
+ */
+static inline void ansi_cell(ansi_t *const a, const chtype ch)
+{
+	const chtype attr = ch & A_ATTRIBUTES;
+	char c = (char)(ch & A_CHARTEXT);
+
+	if (attr != a->attr)
+		ansi_attr(a, attr);
+	if (!isprint((unsigned char)c))
+		c = ' ';
+	a->buf[a->len++] = c;
+	a->cur_x++;
+}
+
+/*
+ *  ansi_run()
+ *	length of the run of cells the same as row[x]
+ */
+static inline int ansi_run(const chtype *row, const int x, const int cols)
+{
+	int i;
+
+	for (i = x + 1; (i < cols) && (row[i] == row[x]); i++)
+		;
+	return i - x;
+}
+
+/*
+ *  ansi_row()
+ *	write the cells of row y that changed, runs of
+ *	cells of the same colour share one attribute
+ *	change, short runs of unchanged cells of the
+ *	current colour are rewritten rather than moved
+ *	over and long runs of blanks are erased when the
+ *	terminal erases with the background colour and
+ *	other runs repeated when it can repeat, as these
+ *	take fewer bytes. Returns false if it stopped at
+ *	max_bytes, the cells not written yet still differ
+ *	so they are picked up on the next frame
+ */
+static bool ansi_row(ansi_t *const a, const int y, const chtype *row)
+{
+	chtype *const prev = a->cells + ((size_t)y * (size_t)a->cols);
+	int x;
+
+	for (x = 0; x < a->cols; x++) {
+		const chtype ch = row[x];
+		bool move = true;
+
+		if (ch == prev[x])
+			continue;
+		if (a->max_bytes && (a->len >= a->max_bytes))
+			return false;
+		if ((a->cur_y == y) && (a->cur_x <= x) &&
+		    (x - a->cur_x <= ANSI_GAP_MAX)) {
+			int i;
+
+			for (i = a->cur_x; i < x; i++) {
+				if ((prev[i] & A_ATTRIBUTES) != a->attr)
+					break;
+			}
+			if (i == x) {
+				for (i = a->cur_x; i < x; i++)
+					ansi_cell(a, prev[i]);
+				move = false;
+			}
+		}
+		if (move) {
+			char cup[24];
+			const int n = snprintf(cup, sizeof(cup), "\033[%d;%dH",
+				y + 1, x + 1);
+
+			ansi_puts(a, cup, (size_t)n);
+			a->cur_y = y;
+			a->cur_x = x;
+		}
+		if (a->bce && ((ch & A_CHARTEXT) == ' ') &&
+		    !(ch & (A_ALTCHARSET | A_REVERSE))) {
+			const int blanks = ansi_run(row, x, a->cols);
+
+			/* Erasing fills with the background, the cursor stays put */
+			if ((x + blanks == a->cols) && (blanks > 3)) {
+				if ((ch & A_ATTRIBUTES) != a->attr)
+					ansi_attr(a, ch & A_ATTRIBUTES);
+				ansi_puts(a, "\033[K", 3);
+				for (; x < a->cols; x++)
+					prev[x] = ch;
+				break;
+			} else if (blanks >= ANSI_RUN_MIN) {
+				char ech[16];
+				const int n = snprintf(ech, sizeof(ech), "\033[%dX", blanks);
+				int i;
+
+				if ((ch & A_ATTRIBUTES) != a->attr)
+					ansi_attr(a, ch & A_ATTRIBUTES);
+				ansi_puts(a, ech, (size_t)n);
+				for (i = 0; i < blanks; i++)
+					prev[x + i] = ch;
+				x += blanks - 1;
+				continue;
+			}
+		} else if (a->rep && isprint((int)(ch & A_CHARTEXT))) {
+			const int same = ansi_run(row, x, a->cols);
+
+			if (same >= ANSI_RUN_MIN) {
+				char rep[16];
+				const int n = snprintf(rep, sizeof(rep), "\033[%db", same - 1);
+				int i;
+
+				ansi_cell(a, ch);
+				ansi_puts(a, rep, (size_t)n);
+				for (i = 0; i < same; i++)
+					prev[x + i] = ch;
+				a->cur_x += same - 1;
+				x += same - 1;
+				continue;
+			}
+		}
+		ansi_cell(a, ch);
+		prev[x] = ch;
+	}
+	return true;
+}
+
+/*
+ *  ansi_flush()
+ *	write the frame and measure how fast the terminal
+ *	takes it, a write only blocks once the terminal has
+ *	fallen behind so that is when the rate is sampled,
+ *	otherwise it is raised until frames go unthrottled
+ */
+static void ansi_flush(ansi_t *const a)
+{
+	const uint64_t start = prof_time_ns();
+	uint64_t end;
+
+	if (!a->len)
+		return;
+	if (ansi_write(a->fd, a->buf, a->len) < 0) {
+		a->len = 0;
+		return;
+	}
+	end = prof_time_ns();
+
+	if (end - start >= ANSI_BLOCK_NS) {
+		const double rate = (double)a->len * 1000000000.0 /
+			(double)(end - start);
+
+		a->rate = (a->rate > 0.0) ? a->rate + ((rate - a->rate) / 8.0) : rate;
+	} else if (a->rate > 0.0) {
+		a->rate *= 1.25;
+		if (a->rate > ANSI_RATE_MAX)
+			a->rate = 0.0;
+	}
+	/* Hold the next frame until the terminal should have taken this one */
+	a->next_ns = (a->rate > 0.0) ?
+		end + (uint64_t)((double)a->len * 1000000000.0 / a->rate) : 0;
+
+	if (!a->frames)
+		a->first_ns = end;
+	a->last_ns = end;
+	a->frames++;
+	a->bytes += a->len;
+	a->last_bytes = a->len;
+	a->len = 0;
+}
+
+/*
+ *  ansi_refresh()
+ *	write the cells of g.mainwin that changed since the
+ *	last frame, stopping once max_bytes have been written
+ *	and carrying on from there on the next frame. Frames
+ *	are held back until the terminal has taken the last
+ */
+static void ansi_refresh(ansi_t *const a)
+{
+	bool force = false;
+	int i, oy, ox;
+
+	if ((a->lines != LINES) || (a->cols != COLS) || a->redraw) {
+		a->redraw = 0;
+		if (ansi_resize(a) < 0)
+			return;
+		force = true;
+	}
+	if (!force) {
+		struct pollfd pfd;
+
+		pfd.fd = a->fd;
+		pfd.events = POLLOUT;
+		pfd.revents = 0;
+		if ((prof_time_ns() < a->next_ns) || (poll(&pfd, 1, 0) == 0)) {
+			a->skipped++;
+			return;
+		}
+	}
+
+	getyx(g.mainwin, oy, ox);
+	for (i = 0; i < a->lines; i++) {
+		const int y = (a->row + i) % a->lines;
+
+		(void)mvwinchnstr(g.mainwin, y, 0, a->line, a->cols);
+		if (!ansi_row(a, y, a->line)) {
+			a->row = y;
+			a->capped++;
+			break;
+		}
+	}
+	if (i == a->lines)
+		a->row = 0;
+	(void)wmove(g.mainwin, oy, ox);
+	ansi_flush(a);
+}
+
+/*
+ *  screen_refresh()
+ *	update the terminal from g.mainwin
+ */
+static void screen_refresh(void)
+{
+	if (g.ansi.enabled) {
+		ansi_refresh(&g.ansi);
+		return;
+	}
+	(void)wrefresh(g.mainwin);
+	(void)refresh();
+}
+
+/*
+ *  show_follow_wait()
+ *	show that the followed process has exited
+ *	and a restarted instance is being looked for
+ */
+static void show_follow_wait(void)
+{
+	char msg[64];
+	const int len = snprintf(msg, sizeof(msg),
+		" PID %d exited, waiting for %.24s ", g.pid, g.match.pattern);
+
+	(void)werase(g.mainwin);
+	(void)wbkgd(g.mainwin, COLOR_PAIR(RED_BLUE));
+	(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_RED) | A_BOLD);
+	(void)mvwprintw(g.mainwin, LINES / 2, MAXIMUM(0, (COLS - len) / 2),
+		"%s", msg);
+	screen_refresh();
+}
+
+/*
+ *  update_xymax()
+ *	set the xymax scale for a specific view v
+ *	based on column width and scaling factor for
+ *	page or mem (hex) views
+ */
+static inline void update_xymax(position_t *const position, const int v)
+{
+	static const int32_t xmax_scale[] = {
+		1,	/* VIEW_PAGE */
+		4	/* VIEW_MEM */
+	};
+
+	position[v].xmax = (COLS - ADDR_OFFSET) / xmax_scale[v];
+	position[v].ymax = LINES - 2;
+}
+
+/*
+ *  proc_paths_init()
+ *	set up the paths of the files pagemon reads, dir is
+ *	either /proc/$PID or a directory of captured files
+ */
+static void proc_paths_init(const char *dir)
+{
+	(void)snprintf(g.path_refs, sizeof(g.path_refs),
+		"%s/clear_refs", dir);
+	(void)snprintf(g.path_pagemap, sizeof(g.path_pagemap),
+		"%s/pagemap", dir);
+	(void)snprintf(g.path_maps, sizeof(g.path_maps),
+		"%s/maps", dir);
+	(void)snprintf(g.path_mem, sizeof(g.path_mem),
+		"%s/mem", dir);
+	(void)snprintf(g.path_status, sizeof(g.path_status),
+		"%s/status", dir);
+	(void)snprintf(g.path_stat, sizeof(g.path_stat),
+		"%s/stat", dir);
+	(void)snprintf(g.path_oom, sizeof(g.path_oom),
+		"%s/oom_score", dir);
+	(void)snprintf(g.path_io, sizeof(g.path_io),
+		"%s/io", dir);
+	(void)snprintf(g.path_smaps_rollup, sizeof(g.path_smaps_rollup),
+		"%s/smaps_rollup", dir);
+	(void)snprintf(g.path_smaps, sizeof(g.path_smaps),
+		"%s/smaps", dir);
+	(void)snprintf(g.path_numa_maps, sizeof(g.path_numa_maps),
+		"%s/numa_maps", dir);
+	(void)snprintf(g.path_cgroup, sizeof(g.path_cgroup),
+		"%s/cgroup", dir);
+}
+
+/*
+ *  proc_pid_paths_init()
+ *	set up the /proc paths for a live process
+ */
+static void proc_pid_paths_init(const pid_t pid)
+{
+	char dir[PROCPATH_MAX];
+
+	(void)snprintf(dir, sizeof(dir), "/proc/%i", pid);
+	proc_paths_init(dir);
+}
+
+/*
+ *  proc_attach()
+ *	monitor a new process
+ */
+static void proc_attach(const pid_t pid)
+{
+	g.pid = pid;
+	proc_pid_paths_init(pid);
+	if (g.pidfd >= 0)
+		(void)close(g.pidfd);
+	g.pidfd = proc_pidfd_open(pid);
+}
+
+/*
+ *  proc_follow()
+ *	look for a restarted instance of a followed process
+ *	and reattach to it, the VM history is kept going.
+ *	Returns true if reattached
+ */
+static bool proc_follow(void)
+{
+	proc_cand_t cands[PROC_MATCH_MAX];
+	size_t n;
+
+	n = proc_find(&g.match, cands, PROC_MATCH_MAX, g.pid);
+	if (!n)
+		return false;
+	proc_attach(proc_newest(cands, n));
+	g.restarts++;
+
+	/* New fds for the VM stats, the rates restart from zero */
+	vm_close(&g.vm);
+	g.vm.sample_ns = 0;
+	pressure_close(&g.pressure);
+	fcache_reset(&g.fcache);
+	/* Nodes of the old process are not carried over */
+	numa_free();
+#if defined(PERF_ENABLED)
+	(void)perf_stop(&g.perf);
+	(void)perf_stop(&g.perf_hw);
+	(void)perf_start(&g.perf, g.pid);
+	(void)perf_start(&g.perf_hw, g.pid);
+	if (g.fault_view) {
+		perf_sample_stop(&g.sample);
+		g.fault_view = (perf_sample_start(&g.sample, g.pid) == 0);
+	}
+	/* Faults of the old process are not carried over */
+	free(g.faults);
+	g.faults = NULL;
+	g.faults_max = 0;
+#endif
+	/* Sampled states of the old process are stale */
+	if (read_maps(true) < 0)
+		return false;
+	pyramid_sample_all();
+	sched_reset();
+
+	return true;
+}
+
+/*
+ *  clear_refs()
+ *	clear the soft dirty bits of the process so the
+ *	pages written from now on show up as dirty
+ */
+static void clear_refs(void)
+{
+	prof_t prof;
+	ssize_t ret;
+	int fd;
+
+	prof_begin(&prof, PROF_CLEAR_REFS);
+	fd = g.offline ? -1 : open(g.path_refs, O_RDWR);
+	if (fd > -1) {
+		ret = write(fd, "4", 1);
+		(void)ret;
+		(void)close(fd);
+		prof_syscall(0);
+		prof_syscall(0);
+	}
+	prof_syscall(0);
+	prof_end(&prof);
+}
+
+/*
+ *  dirty_rate()
+ *	bytes dirtied per second in the last interval
+ */
+static inline double dirty_rate(const dirty_t *const d)
+{
+	return d->actual_ns ? (double)d->pages * (double)g.page_size *
+		1000000000.0 / (double)d->actual_ns : 0.0;
+}
+
+/*
+ *  dirty_precopy()
+ *	estimate an iterative pre-copy migration of the memory
+ *	in RAM over the link. Each round copies what was dirtied
+ *	while the previous round was being copied, at the last
+ *	measured dirty rate, until what is left can be copied
+ *	within the downtime target with the process stopped.
+ *	It does not converge if a round dirties as much as it
+ *	copies
+ */
+static void dirty_precopy(const dirty_t *const d, precopy_t *const pc)
+{
+	const double link = d->link_mbs * (double)MB;
+	const double memory = (double)d->resident * (double)g.page_size;
+	const double target = link * (double)DIRTY_DOWNTIME_MS / 1000.0;
+	const double rate = dirty_rate(d);
+	double left = memory;
+
+	(void)memset(pc, 0, sizeof(*pc));
+	while (pc->rounds < DIRTY_ROUNDS_MAX) {
+		const double t = left / link;
+		const double next = MINIMUM(rate * t, memory);
+
+		pc->total_s += t;
+		pc->rounds++;
+		if (next <= target) {
+			pc->converges = true;
+			left = next;
+			break;
+		}
+		if (next >= left)
+			break;
+		left = next;
+	}
+	pc->downtime_ms = 1000.0 * left / link;
+	if (pc->converges)
+		pc->total_s += left / link;
+}
+
+/*
+ *  dirty_map_cmp()
+ *	order maps by pages dirtied, most first
+ */
+static int dirty_map_cmp(const void *p1, const void *p2)
+{
+	const dirty_map_t *m1 = (const dirty_map_t *)p1;
+	const dirty_map_t *m2 = (const dirty_map_t *)p2;
+
+	return (m1->dirty < m2->dirty) - (m1->dirty > m2->dirty);
+}
+
+/*
+ *  dirty_log()
+ *	append the last interval to the CSV log, a row for
+ *	the process with the pre-copy estimate and a row for
+ *	each map with dirtied pages
+ */
+static void dirty_log(const dirty_t *const d)
+{
+	const double interval_s = (double)d->actual_ns / 1000000000.0;
+	struct timespec ts;
+	precopy_t pc;
+	double now;
+	size_t i;
+
+	if (!d->log)
+		return;
+	(void)clock_gettime(CLOCK_REALTIME, &ts);
+	now = (double)ts.tv_sec + ((double)ts.tv_nsec / 1000000000.0);
+	dirty_precopy(d, &pc);
+	(void)fprintf(d->log, "%.3f,%.3f,,total,%" PRIu64 ",%" PRIu64
+		",%.0f,%s,%" PRIu32 ",%.1f,%.1f\n",
+		now, interval_s, d->resident, d->pages, dirty_rate(d),
+		pc.converges ? "yes" : "no", pc.rounds, pc.total_s,
+		pc.downtime_ms);
+	for (i = 0; i < d->nmaps; i++) {
+		const dirty_map_t *const map = &d->maps[i];
+
+		(void)fprintf(d->log, "%.3f,%.3f,%" PRIx64 ",%s,%" PRIu64
+			",%" PRIu64 ",%.0f,,,,\n",
+			now, interval_s, map->begin, map->name, map->resident,
+			map->dirty, (double)map->dirty * (double)g.page_size /
+			interval_s);
+	}
+	(void)fflush(d->log);
+}
+
+/*
+ *  dirty_sample()
+ *	read the pagemap of every page in one pass, count the
+ *	soft dirty pages map by map and clear soft dirty again
+ *	straight away to start the next interval. The interval
+ *	is timed from clear to clear
+ */
+static void dirty_sample(dirty_t *const d)
+{
+	pagemap_t buf[PYRAMID_READ];
+	prof_t prof;
+	uint64_t now;
+	uint32_t i;
+	int fd;
+
+	d->nmaps = 0;
+	d->pages = 0;
+	d->resident = 0;
+
+	prof_begin(&prof, PROF_PAGEMAP);
+	fd = open(g.path_pagemap, O_RDONLY);
+	if (fd < 0)
+		goto done;
+	prof_syscall(0);
+
+	for (i = 0; i < g.mem_info.nmaps; i++) {
+		const map_t *const map = &g.mem_info.maps[i];
+		const index_t end = map->first +
+			(index_t)((map->end - map->begin) / g.page_size);
+		index_t idx = map->first;
+		uint64_t resident = 0, dirty = 0;
+		dirty_map_t *dm;
+
+		while (idx < end) {
+			const index_t count = MINIMUM(end - idx, PYRAMID_READ);
+			const addr_t addr = g.mem_info.pages[idx].addr;
+			ssize_t ret;
+			index_t k;
+
+			ret = pread(fd, buf, (size_t)count * sizeof(pagemap_t),
+				(off_t)((addr / g.page_size) * sizeof(pagemap_t)));
+			prof_syscall(ret);
+			if (ret <= 0)
+				break;
+			for (k = 0; k < (index_t)(ret / (ssize_t)sizeof(pagemap_t)); k++) {
+				const pagemap_t pm = buf[k];
+
+				pyramid_set(idx + k, pm);
+				resident += !!(pm & PAGE_PRESENT);
+				dirty += ((pm & (PAGE_PRESENT | PAGE_SWAPPED)) &&
+					  (pm & PAGE_PTE_SOFT_DIRTY));
+			}
+			idx += count;
+		}
+		d->resident += resident;
+		d->pages += dirty;
+		if (!dirty)
+			continue;
+		if (d->nmaps >= d->maps_size) {
+			const size_t size = d->maps_size ? d->maps_size * 2 : 64;
+			dirty_map_t *maps = realloc(d->maps, size * sizeof(*maps));
+
+			if (!maps)
+				break;
+			d->maps = maps;
+			d->maps_size = size;
+		}
+		dm = &d->maps[d->nmaps++];
+		dm->begin = map->begin;
+		(void)snprintf(dm->name, sizeof(dm->name), "%.*s",
+			(int)sizeof(dm->name) - 1, map_basename(map));
+		dm->resident = resident;
+		dm->dirty = dirty;
+	}
+	(void)close(fd);
+	prof_syscall(0);
+done:
+	prof_end(&prof);
+
+	clear_refs();
+	now = prof_time_ns();
+	d->actual_ns = now - d->reset_ns;
+	d->reset_ns = now;
+	d->intervals++;
+	qsort(d->maps, d->nmaps, sizeof(*d->maps), dirty_map_cmp);
+	dirty_log(d);
+}
+
+/*
+ *  dirty_start()
+ *	clear soft dirty and start the interval timer,
+ *	opening the log the first time
+ */
+static int dirty_start(dirty_t *const d)
+{
+	struct itimerspec its;
+
+	if (d->started)
+		return 0;
+	if (d->log_path && !d->log) {
+		d->log = fopen(d->log_path, "w");
+		if (!d->log) {
+			(void)fprintf(stderr, "Cannot open dirty rate log %s: %s\n",
+				d->log_path, strerror(errno));
+			return -1;
+		}
+		(void)fprintf(d->log, "time,interval_s,begin,map,resident_pages,"
+			"dirty_pages,dirty_bytes_per_sec,converges,rounds,"
+			"total_s,downtime_ms\n");
+	}
+	d->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (d->timer_fd < 0)
+		return -1;
+	its.it_value.tv_sec = (time_t)(d->interval_ms / 1000);
+	its.it_value.tv_nsec = (long)((d->interval_ms % 1000) * 1000000);
+	its.it_interval = its.it_value;
+	if (timerfd_settime(d->timer_fd, 0, &its, NULL) < 0) {
+		(void)close(d->timer_fd);
+		return -1;
+	}
+	clear_refs();
+	d->reset_ns = prof_time_ns();
+	d->actual_ns = 0;
+	d->pages = 0;
+	d->nmaps = 0;
+	d->started = true;
+	return 0;
+}
+
+/*
+ *  dirty_stop()
+ *	stop the interval timer
+ */
+static void dirty_stop(dirty_t *const d)
+{
+	if (!d->started)
+		return;
+	(void)close(d->timer_fd);
+	d->started = false;
+}
+
+/*
+ *  dirty_update()
+ *	sample the dirtied pages if the interval timer has
+ *	expired, counting any expirations that were missed
+ *	because a frame took longer than the interval
+ */
+static void dirty_update(dirty_t *const d)
+{
+	uint64_t expirations;
+
+	if (!d->started)
+		return;
+	if (read(d->timer_fd, &expirations, sizeof(expirations)) !=
+	    sizeof(expirations))
+		return;
+	prof_syscall(0);
+	d->missed += expirations - 1;
+	dirty_sample(d);
+}
+
+/*
+ *  dirty_free()
+ *	stop dirty rate tracking and close the log
+ */
+static void dirty_free(dirty_t *const d)
+{
+	dirty_stop(d);
+	if (d->log)
+		(void)fclose(d->log);
+	free(d->maps);
+	d->log = NULL;
+	d->maps = NULL;
+	d->nmaps = 0;
+	d->maps_size = 0;
+}
+
+/*
+ *  show_dirty()
+ *	show the dirty rate of the last interval, the pre-copy
+ *	migration estimate and the maps dirtying most
+ */
+static void show_dirty(const dirty_t *const d)
+{
+	const int x = (COLS - 76) / 2;
+	const double interval_s = (double)d->actual_ns / 1000000000.0;
+	precopy_t pc;
+	int y = 2;
+	size_t i;
+
+	dirty_precopy(d, &pc);
+	(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
+	(void)mvwprintw(g.mainwin, y++, x,
+		" Interval: %6" PRIu64 " ms  Actual: %8.1f ms  Missed: %6" PRIu64
+		"  Intervals: %5" PRIu64 " ",
+		d->interval_ms, interval_s * 1000.0, d->missed, d->intervals);
+	(void)mvwprintw(g.mainwin, y++, x,
+		" Dirtied: %10" PRIu64 " pages %13.2f MB/s  Resident: %12" PRIu64
+		" pages ",
+		d->pages, dirty_rate(d) / (double)MB, d->resident);
+	if (!d->intervals)
+		(void)mvwprintw(g.mainwin, y++, x,
+			" Link: %7.0f MB/s  Pre-copy: measuring%36s",
+			d->link_mbs, "");
+	else if (pc.converges)
+		(void)mvwprintw(g.mainwin, y++, x,
+			" Link: %7.0f MB/s  Pre-copy: %2" PRIu32 " rounds %9.1f s"
+			"  Downtime: %8.1f ms ",
+			d->link_mbs, pc.rounds, pc.total_s, pc.downtime_ms);
+	else
+		(void)mvwprintw(g.mainwin, y++, x,
+			" Link: %7.0f MB/s  Pre-copy: does not converge, "
+			"downtime %9.1f ms%5s",
+			d->link_mbs, pc.downtime_ms, "");
+	(void)mvwprintw(g.mainwin, y++, x,
+		" %-24s %10s %10s %7s %12s%8s",
+		"Map", "Resident", "Dirtied", "Dirty", "MB/s", "");
+	for (i = 0; (i < d->nmaps) && (y < LINES - 2); i++) {
+		const dirty_map_t *const map = &d->maps[i];
+
+		(void)mvwprintw(g.mainwin, y++, x,
+			" %-24.24s %10" PRIu64 " %10" PRIu64 " %6.1f%% %12.2f%8s",
+			map->name, map->resident, map->dirty,
+			map->resident ? 100.0 * (double)map->dirty /
+				(double)map->resident : 0.0,
+			interval_s > 0.0 ? (double)map->dirty *
+				(double)g.page_size / interval_s / (double)MB : 0.0, "");
+	}
+	if (!d->nmaps)
+		(void)mvwprintw(g.mainwin, y, x, " %-74s ",
+			d->intervals ? "No pages dirtied" : "Measuring");
+}
+
+/*
+ *  export_label()
+ *	write a Prometheus label value, escaping
+ *	backslash, double quote and newline
+ */
+static void export_label(FILE *fp, const char *str)
+{
+	for (; *str; str++) {
+		if ((*str == '\\') || (*str == '"'))
+			(void)fputc('\\', fp);
+		if (*str == '\n')
+			(void)fputs("\\n", fp);
+		else
+			(void)fputc(*str, fp);
+	}
+}
+
+/*
+ *  export_maps()
+ *	write the per map page state counts, these come
+ *	from the incrementally sampled page state pyramid
+ *	so no pagemap is read to build them
+ */
+static void export_maps(FILE *fp)
+{
+	static const char *const state_names[PAGE_STATE_MAX] = {
+		"not_present",		/* PAGE_STATE_NOT_PRESENT */
+		"present",		/* PAGE_STATE_PRESENT */
+		"swapped",		/* PAGE_STATE_SWAPPED */
+		"file_shared",		/* PAGE_STATE_MAPPED */
+		"dirty",		/* PAGE_STATE_DIRTY */
+	};
+	const pyramid_t *const py = &g.mem_info.pyramid;
+	uint64_t resident = 0, wss = 0;
+	uint32_t i, s;
+	addr_t idx;
+
+	if (!py->states)
+		return;
+
+	(void)fprintf(fp,
+		"# HELP pagemon_map_pages Pages of a mapping in each state.\n"
+		"# TYPE pagemon_map_pages gauge\n");
+	for (i = 0; i < g.mem_info.nmaps; i++) {
+		const map_t *const map = &g.mem_info.maps[i];
+		const index_t end = map->first +
+			(index_t)((map->end - map->begin) / g.page_size);
+		page_counts_t counts;
+
+		(void)memset(&counts, 0, sizeof(counts));
+		pyramid_count(map->first, end, &counts);
+		for (s = 0; s < PAGE_STATE_MAX; s++) {
+			(void)fprintf(fp, "pagemon_map_pages{begin=\"0x%" PRIx64
+				"\",end=\"0x%" PRIx64 "\",perms=\"%s\",name=\"",
+				map->begin, map->end, map->attr);
+			export_label(fp, map_name(map));
+			(void)fprintf(fp, "\",state=\"%s\"} %" PRIu64 "\n",
+				state_names[s], counts.n[s]);
+		}
+	}
+	/*
+	 *  Soft dirty is also set on swap entries and on the
+	 *  unpopulated pages of new mappings, so the pages in
+	 *  RAM are counted from the present and swapped bits
+	 *  and the working set only from soft dirty pages that
+	 *  are present or swapped, as dirty_sample() does
+	 */
+	for (idx = 0; idx < py->npages; idx++) {
+		const uint8_t res = py->resident[idx];
+
+		resident += (res == PAGE_STATE_PRESENT);
+		wss += ((py->states[idx] == PAGE_STATE_DIRTY) &&
+			(res != PAGE_STATE_NOT_PRESENT));
+	}
+	(void)fprintf(fp,
+		"# HELP pagemon_resident_pages Pages in RAM.\n"
+		"# TYPE pagemon_resident_pages gauge\n"
+		"pagemon_resident_pages %" PRIu64 "\n"
+		"# HELP pagemon_wss_pages Working set estimate, pages written "
+		"since the soft dirty bits were last cleared.\n"
+		"# TYPE pagemon_wss_pages gauge\n"
+		"pagemon_wss_pages %" PRIu64 "\n",
+		resident, wss);
+}
 
-	if ((fd = open(g.path_mem, O_RDONLY)) < 0)
-		return ERR_NO_MEM_INFO;
+/*
+ *  export_vm()
+ *	write the VM stats of the last sample
+ */
+static void export_vm(FILE *fp)
+{
+	const vm_t *const vm = &g.vm;
+	uint32_t i;
 
-	for (i = 1; i <= ymax; i++) {
-		int32_t j;
-		uint8_t bytes[xmax];
-		ssize_t nread = 0;
+	if (!vm->count)
+		return;
 
-		addr = g.mem_info.pages[idx].addr + data_index;
-		if (lseek(fd, (off_t)addr, SEEK_SET) == (off_t)-1) {
-			nread = -1;
-		} else {
-			nread = read(fd, bytes, (size_t)xmax);
-			if (nread < 0)
-				nread = -1;
+	(void)fprintf(fp,
+		"# HELP pagemon_vm_bytes Vm fields of /proc/PID/status.\n"
+		"# TYPE pagemon_vm_bytes gauge\n");
+	for (i = 0; i < vm->nfields; i++)
+		(void)fprintf(fp, "pagemon_vm_bytes{field=\"%.*s\"} %" PRIu64 "\n",
+			(int)vm->fields[i].len, vm->fields[i].name,
+			(uint64_t)(vm->fields[i].value * KB));
+	if (vm->have_stat)
+		(void)fprintf(fp,
+			"# TYPE pagemon_minor_faults_total counter\n"
+			"pagemon_minor_faults_total %" PRIu64 "\n"
+			"# TYPE pagemon_major_faults_total counter\n"
+			"pagemon_major_faults_total %" PRIu64 "\n",
+			vm->minflt, vm->majflt);
+	if (vm->have_io)
+		(void)fprintf(fp,
+			"# TYPE pagemon_io_read_bytes_total counter\n"
+			"pagemon_io_read_bytes_total %" PRIu64 "\n"
+			"# TYPE pagemon_io_write_bytes_total counter\n"
+			"pagemon_io_write_bytes_total %" PRIu64 "\n",
+			vm->read_bytes, vm->write_bytes);
+	if (vm->have_oom)
+		(void)fprintf(fp,
+			"# TYPE pagemon_oom_score gauge\n"
+			"pagemon_oom_score %" PRIu64 "\n",
+			vm->oom_score);
+}
+
+/*
+ *  export_pressure()
+ *	write the cgroup memory pressure of the last sample
+ */
+static void export_pressure(FILE *fp)
+{
+	static const char *const stat_names[PSTAT_MAX] = {
+		"workingset_refault_anon",	/* PSTAT_REFAULT_ANON */
+		"workingset_refault_file",	/* PSTAT_REFAULT_FILE */
+		"pgscan",			/* PSTAT_PGSCAN */
+		"pgsteal",			/* PSTAT_PGSTEAL */
+	};
+	const pressure_t *const pr = &g.pressure;
+	uint32_t i;
+
+	if (!pr->valid)
+		return;
+
+	if (pr->have_psi)
+		(void)fprintf(fp,
+			"# HELP pagemon_cgroup_memory_pressure_avg10 "
+			"cgroup memory PSI 10 second average, percent.\n"
+			"# TYPE pagemon_cgroup_memory_pressure_avg10 gauge\n"
+			"pagemon_cgroup_memory_pressure_avg10{kind=\"some\"} %.2f\n"
+			"pagemon_cgroup_memory_pressure_avg10{kind=\"full\"} %.2f\n"
+			"# TYPE pagemon_cgroup_memory_stall_seconds_total counter\n"
+			"pagemon_cgroup_memory_stall_seconds_total{kind=\"some\"} %.6f\n"
+			"pagemon_cgroup_memory_stall_seconds_total{kind=\"full\"} %.6f\n",
+			pr->some_avg10, pr->full_avg10,
+			(double)pr->some_total / 1000000.0,
+			(double)pr->full_total / 1000000.0);
+	if (pr->fd_current >= 0)
+		(void)fprintf(fp,
+			"# TYPE pagemon_cgroup_memory_current_bytes gauge\n"
+			"pagemon_cgroup_memory_current_bytes %" PRIu64 "\n",
+			pr->current);
+	if (pr->max)
+		(void)fprintf(fp,
+			"# TYPE pagemon_cgroup_memory_max_bytes gauge\n"
+			"pagemon_cgroup_memory_max_bytes %" PRIu64 "\n",
+			pr->max);
+	(void)fprintf(fp,
+		"# HELP pagemon_cgroup_memory_stat_total memory.stat counters.\n"
+		"# TYPE pagemon_cgroup_memory_stat_total counter\n");
+	for (i = 0; i < PSTAT_MAX; i++)
+		(void)fprintf(fp, "pagemon_cgroup_memory_stat_total{field=\"%s\"} %"
+			PRIu64 "\n", stat_names[i], pr->stat[i]);
+}
+
+#if defined(PERF_ENABLED)
+/*
+ *  export_perf()
+ *	write the perf counters
+ */
+static void export_perf(FILE *fp, perf_t *const p)
+{
+	int i;
+
+	(void)perf_read(p);
+	for (i = 0; i < p->perf_events; i++) {
+		if (!perf_available(p, i))
+			continue;
+		(void)fprintf(fp, "pagemon_perf_events_total{event=\"%s\"} %"
+			PRIu64 "\n", p->perf_stat[i].name, perf_counter(p, i));
+	}
+}
+#endif
+
+/*
+ *  export_snapshot()
+ *	build the metrics text once every EXPORT_NS and
+ *	swap it in for the scrapes, this is cheap to call
+ *	on every frame
+ */
+static void export_snapshot(export_t *const ex)
+{
+	const uint64_t now = prof_time_ns();
+	char *text = NULL;
+	size_t len = 0;
+	FILE *fp;
+
+	if (!ex->started ||
+	    (ex->snapshot_ns && (now - ex->snapshot_ns < EXPORT_NS)))
+		return;
+	ex->snapshot_ns = now;
+
+	fp = open_memstream(&text, &len);
+	if (!fp)
+		return;
+	(void)fprintf(fp,
+		"# HELP pagemon_info Process being monitored.\n"
+		"# TYPE pagemon_info gauge\n"
+		"pagemon_info{pid=\"%d\",version=\"%s\"} 1\n"
+		"# TYPE pagemon_restarts_total counter\n"
+		"pagemon_restarts_total %" PRIu32 "\n"
+		"# TYPE pagemon_maps gauge\n"
+		"pagemon_maps %" PRIu32 "\n"
+		"# TYPE pagemon_page_size_bytes gauge\n"
+		"pagemon_page_size_bytes %" PRIu32 "\n"
+		"# TYPE pagemon_snapshot_timestamp_seconds gauge\n"
+		"pagemon_snapshot_timestamp_seconds %ld\n",
+		g.pid, VERSION, g.restarts, g.mem_info.nmaps, g.page_size,
+		(long)time(NULL));
+	export_maps(fp);
+	export_vm(fp);
+	export_pressure(fp);
+#if defined(PERF_ENABLED)
+	if (!g.offline) {
+		(void)fprintf(fp, "# TYPE pagemon_perf_events_total counter\n");
+		export_perf(fp, &g.perf);
+		export_perf(fp, &g.perf_hw);
+	}
+#endif
+	(void)pthread_mutex_lock(&ex->lock);
+	(void)fprintf(fp,
+		"# TYPE pagemon_scrapes_total counter\n"
+		"pagemon_scrapes_total %" PRIu64 "\n", ex->scrapes);
+	(void)pthread_mutex_unlock(&ex->lock);
+	if (fclose(fp) == EOF) {
+		free(text);
+		return;
+	}
+
+	(void)pthread_mutex_lock(&ex->lock);
+	free(ex->text);
+	ex->text = text;
+	ex->len = len;
+	(void)pthread_mutex_unlock(&ex->lock);
+}
+
+/*
+ *  export_serve()
+ *	answer a scrape with a copy of the last snapshot,
+ *	as an HTTP response if it sent a GET, as plain
+ *	text otherwise
+ */
+static void export_serve(export_t *const ex, const int fd)
+{
+	static const char header[] =
+		"HTTP/1.0 200 OK\r\n"
+		"Content-Type: text/plain; version=0.0.4\r\n"
+		"Connection: close\r\n\r\n";
+	struct pollfd pfd;
+	char req[1024];
+	ssize_t n = 0;
+	size_t len, done;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	if (poll(&pfd, 1, EXPORT_REQ_MS) > 0)
+		n = recv(fd, req, sizeof(req), 0);
+
+	(void)pthread_mutex_lock(&ex->lock);
+	len = ex->len;
+	if (len > ex->serve_size) {
+		char *serve = realloc(ex->serve, len);
+
+		if (!serve) {
+			(void)pthread_mutex_unlock(&ex->lock);
+			return;
 		}
+		ex->serve = serve;
+		ex->serve_size = len;
+	}
+	if (len)
+		(void)memcpy(ex->serve, ex->text, len);
+	ex->scrapes++;
+	(void)pthread_mutex_unlock(&ex->lock);
 
-		(void)wattrset(g.mainwin, COLOR_PAIR(BLACK_WHITE));
-		if (idx >= (index_t)g.mem_info.npages)
-			(void)mvwprintw(g.mainwin, i, 0, "---------------- ");
-		else
-			(void)mvwprintw(g.mainwin, i, 0, "%16.16" PRIx64 " ", addr);
-		(void)mvwprintw(g.mainwin, i, COLS - 3, "   ");
+	if ((n >= 3) && !memcmp(req, "GET", 3) &&
+	    (send(fd, header, sizeof(header) - 1, MSG_NOSIGNAL) < 0))
+		return;
+	for (done = 0; done < len; done += (size_t)n) {
+		n = send(fd, ex->serve + done, len - done, MSG_NOSIGNAL);
+		if (n <= 0)
+			break;
+	}
+}
 
-		for (j = 0; j < xmax; j++) {
-			uint8_t byte;
+/*
+ *  export_worker()
+ *	accept and answer scrapes until the
+ *	listening socket is shut down
+ */
+static void *export_worker(void *arg)
+{
+	export_t *const ex = (export_t *)arg;
+	const struct timeval tv = { EXPORT_SEND_SEC, 0 };
 
-			addr = g.mem_info.pages[idx].addr + data_index;
-			if ((idx >= (index_t)g.mem_info.npages) ||
-			    (addr > g.mem_info.last_addr)) {
-				/* End of memory */
-				(void)wattrset(g.mainwin, COLOR_PAIR(BLACK_BLACK));
-				(void)mvwprintw(g.mainwin, i, ADDR_OFFSET +
-					(HEX_WIDTH * j), "   ");
-				(void)mvwprintw(g.mainwin, i, ADDR_OFFSET +
-					(HEX_WIDTH * xmax) + j, " ");
-				goto do_border;
-			}
-			if (j > nread) {
-				/* Failed to read data */
-				(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE));
-				(void)mvwprintw(g.mainwin, i, ADDR_OFFSET +
-					(HEX_WIDTH * j), "?? ");
-				(void)wattrset(g.mainwin, COLOR_PAIR(BLACK_WHITE));
-				(void)mvwprintw(g.mainwin, i, ADDR_OFFSET +
-					(HEX_WIDTH * xmax) + j, "?");
-				goto do_border;
-			}
+	for (;;) {
+		const int fd = accept(ex->fd, NULL, NULL);
 
-			/* We have some legimate data to display */
- 			byte = bytes[j];
-			(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE));
-			(void)mvwprintw(g.mainwin, i, ADDR_OFFSET +
-				(HEX_WIDTH * j), "%2.2" PRIx8 " ", byte);
-			(void)wattrset(g.mainwin, COLOR_PAIR(BLACK_WHITE));
-			byte &= 0x7f;
-			(void)mvwprintw(g.mainwin, i, ADDR_OFFSET +
-				(HEX_WIDTH * xmax) + j, "%c",
-				(byte < 32 || byte > 126) ? '.' : byte);
-do_border:
-			(void)wattrset(g.mainwin, COLOR_PAIR(BLACK_WHITE));
-			(void)mvwprintw(g.mainwin, i, 16 + (HEX_WIDTH * xmax), " ");
-			data_index++;
-			if (data_index >= g.page_size) {
-				data_index -= g.page_size;
-				idx++;
-			}
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
 		}
+		(void)setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+		export_serve(ex, fd);
+		(void)close(fd);
 	}
-	(void)close(fd);
+	return NULL;
+}
+
+/*
+ *  export_start()
+ *	listen on the metrics Unix socket and start the
+ *	worker that answers scrapes, returns -1 on failure
+ */
+static int export_start(export_t *const ex)
+{
+	struct sockaddr_un addr;
+	struct stat st;
+
+	if (strlen(ex->path) >= sizeof(addr.sun_path)) {
+		(void)fprintf(stderr, "Socket path %s is too long\n", ex->path);
+		return -1;
+	}
+	/* Only a stale socket of an earlier run is replaced */
+	if (lstat(ex->path, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			(void)fprintf(stderr, "Cannot serve metrics on %s: "
+				"exists and is not a socket\n", ex->path);
+			return -1;
+		}
+		if ((unlink(ex->path) < 0) && (errno != ENOENT))
+			goto err;
+	} else if (errno != ENOENT) {
+		goto err;
+	}
+	(void)memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	(void)strncpy(addr.sun_path, ex->path, sizeof(addr.sun_path) - 1);
+
+	ex->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (ex->fd < 0)
+		goto err;
+	if (bind(ex->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		goto err_close;
+	if (listen(ex->fd, 16) < 0)
+		goto err_unlink;
+	(void)pthread_mutex_init(&ex->lock, NULL);
+	if (pthread_create(&ex->thread, NULL, export_worker, ex) != 0) {
+		(void)pthread_mutex_destroy(&ex->lock);
+		goto err_unlink;
+	}
+	ex->started = true;
+	return 0;
+
+err_unlink:
+	(void)unlink(ex->path);
+err_close:
+	(void)close(ex->fd);
+err:
+	(void)fprintf(stderr, "Cannot serve metrics on %s: %s\n",
+		ex->path, strerror(errno));
+	return -1;
+}
+
+/*
+ *  export_stop()
+ *	stop the metrics worker and remove the socket
+ */
+static void export_stop(export_t *const ex)
+{
+	if (!ex->started)
+		return;
+	/* Wakes the worker from accept() */
+	(void)shutdown(ex->fd, SHUT_RDWR);
+	(void)pthread_join(ex->thread, NULL);
+	(void)close(ex->fd);
+	(void)unlink(ex->path);
+	(void)pthread_mutex_destroy(&ex->lock);
+	free(ex->text);
+	free(ex->serve);
+	ex->text = NULL;
+	ex->serve = NULL;
+	ex->len = 0;
+	ex->serve_size = 0;
+	ex->started = false;
+}
+
+/*
+ *  shm_resize()
+ *	make room for at least nmaps maps and npages pages,
+ *	the capacities are doubled so this is rare. Called
+ *	while the generation is odd, returns -1 on failure
+ */
+static int shm_resize(shm_t *const s, const uint32_t nmaps, const uint64_t npages)
+{
+	uint32_t maps_max = s->hdr ? s->maps_max : SHM_MAPS_MIN;
+	uint64_t pages_max = s->hdr ? s->pages_max : SHM_PAGES_MIN;
+	uint64_t maps_offset, states_offset, size;
+	void *ptr;
+
+	if (s->hdr && (nmaps <= maps_max) && (npages <= pages_max))
+		return 0;
+	while (maps_max < nmaps)
+		maps_max <<= 1;
+	while (pages_max < npages)
+		pages_max <<= 1;
+
+	maps_offset = (sizeof(pagemon_shm_header_t) + 63) & ~63ULL;
+	states_offset = maps_offset + ((uint64_t)maps_max * sizeof(pagemon_shm_map_t));
+	size = states_offset + ((pages_max + 1) / 2);
+	size = (size + g.page_size - 1) & ~((uint64_t)g.page_size - 1);
+
+	if (ftruncate(s->fd, (off_t)size) < 0)
+		return -1;
+	ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, s->fd, 0);
+	if (ptr == MAP_FAILED)
+		return -1;
+	if (s->hdr)
+		(void)munmap(s->hdr, s->size);
+	s->hdr = ptr;
+	s->size = size;
+	s->maps_max = maps_max;
+	s->pages_max = pages_max;
+	s->maps_offset = maps_offset;
+	s->states_offset = states_offset;
+	s->hdr->size = size;
+	s->hdr->maps_max = maps_max;
+	s->hdr->pages_max = pages_max;
+	s->hdr->maps_offset = maps_offset;
+	s->hdr->states_offset = states_offset;
 
 	return 0;
 }
 
 /*
- *  read_all_pages()
- *	read in all pages into memory, this
- *	will force swapped out pages back into
- *	memory
+ *  shm_start()
+ *	create the shared memory object the page state
+ *	snapshots are published in, returns -1 on failure
  */
-static int read_all_pages(void)
+static int shm_start(shm_t *const s)
 {
-	int fd;
-	index_t idx;
+	(void)snprintf(s->path, sizeof(s->path), "%s%.*s",
+		(s->name[0] == '/') ? "" : "/",
+		(int)sizeof(s->path) - 2, s->name);
+	/*
+	 *  Never reuse an existing object, anyone who could
+	 *  create it could also have mapped it beforehand
+	 */
+	if ((shm_unlink(s->path) < 0) && (errno != ENOENT))
+		goto err;
+	s->fd = shm_open(s->path, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (s->fd < 0)
+		goto err;
+	if (shm_resize(s, SHM_MAPS_MIN, SHM_PAGES_MIN) < 0) {
+		(void)close(s->fd);
+		(void)shm_unlink(s->path);
+		goto err;
+	}
+	s->seq = 0;
+	s->hdr->version = PAGEMON_SHM_VERSION;
+	/* Readers check the magic last, once the rest is set */
+	__atomic_store_n(&s->hdr->magic, PAGEMON_SHM_MAGIC, __ATOMIC_RELEASE);
+	s->started = true;
+	return 0;
+err:
+	(void)fprintf(stderr, "Cannot publish snapshots in %s: %s\n",
+		s->path, strerror(errno));
+	return -1;
+}
 
-	if ((fd = open(g.path_mem, O_RDONLY)) < 0)
-		return ERR_NO_MEM_INFO;
+/*
+ *  shm_stop()
+ *	remove the shared memory object, readers that
+ *	have it mapped keep the last snapshot
+ */
+static void shm_stop(shm_t *const s)
+{
+	if (!s->started)
+		return;
+	(void)munmap(s->hdr, s->size);
+	(void)close(s->fd);
+	(void)shm_unlink(s->path);
+	s->hdr = NULL;
+	s->started = false;
+}
 
-	for (idx = 0; idx < (index_t)g.mem_info.npages; idx++) {
-		const off_t addr = g.mem_info.pages[idx].addr;
-		uint8_t byte;
+/*
+ *  shm_publish()
+ *	write the maps and the page states packed 4 bits a
+ *	page into the shared memory object once every
+ *	SHM_PUBLISH_NS, bracketed by the seqlock generation
+ *	so readers can tell a torn snapshot. This is cheap
+ *	to call on every frame
+ */
+static void shm_publish(shm_t *const s)
+{
+	const uint64_t now = prof_time_ns();
+	const pyramid_t *const py = &g.mem_info.pyramid;
+	const uint32_t nmaps = g.mem_info.nmaps;
+	const uint64_t npages = py->npages;
+	pagemon_shm_header_t *hdr;
+	pagemon_shm_map_t *maps;
+	uint8_t *states;
+	struct timespec ts;
+	uint64_t seq, i;
+
+	if (!s->started || !py->states ||
+	    (s->publish_ns && (now - s->publish_ns < SHM_PUBLISH_NS)))
+		return;
+	s->publish_ns = now;
 
-		if (lseek(fd, addr, SEEK_SET) == (off_t)-1)
-			continue;
-		if (read(fd, &byte, sizeof(byte)) < 0)
-			continue;
+	/* Odd while writing, ordered before the snapshot stores */
+	seq = s->seq;
+	__atomic_store_n(&s->hdr->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	if (shm_resize(s, nmaps, npages) < 0) {
+		/* Keep the last snapshot, try again next time */
+		s->seq = seq + 2;
+		__atomic_store_n(&s->hdr->seq, s->seq, __ATOMIC_RELEASE);
+		return;
 	}
-	(void)close(fd);
+	/* The layout is ours, never trust what is in the segment */
+	hdr = s->hdr;
+	maps = (pagemon_shm_map_t *)((uint8_t *)hdr + s->maps_offset);
+	states = (uint8_t *)hdr + s->states_offset;
+
+	(void)clock_gettime(CLOCK_REALTIME, &ts);
+	hdr->timestamp_ns = ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+	hdr->pid = g.pid;
+	hdr->page_size = g.page_size;
+	hdr->nmaps = nmaps;
+	hdr->npages = npages;
+	hdr->restarts = g.restarts;
+
+	for (i = 0; i < nmaps; i++) {
+		const map_t *const map = &g.mem_info.maps[i];
+
+		maps[i].begin = map->begin;
+		maps[i].end = map->end;
+		maps[i].first = (uint64_t)map->first;
+		(void)memcpy(maps[i].attr, map->attr, sizeof(map->attr));
+		(void)memset(maps[i].attr + sizeof(map->attr), 0,
+			sizeof(maps[i].attr) - sizeof(map->attr));
+		(void)strncpy(maps[i].name, map_name(map), sizeof(maps[i].name) - 1);
+		maps[i].name[sizeof(maps[i].name) - 1] = '\0';
+	}
+	for (i = 0; i + 1 < npages; i += 2)
+		states[i >> 1] = (uint8_t)(py->states[i] | (py->states[i + 1] << 4));
+	if (i < npages)
+		states[i >> 1] = py->states[i];
+
+	/* Even again, ordered after the snapshot stores */
+	s->seq = seq + 2;
+	__atomic_store_n(&hdr->seq, s->seq, __ATOMIC_RELEASE);
+}
+
+/*
+ *  export_run()
+ *	sample the process without curses and serve the
+ *	metrics and shared snapshots until it exits or
+ *	pagemon is stopped
+ */
+static int export_run(const useconds_t udelay)
+{
+	uint64_t frame_ns = 0;
+	int rc = OK;
+
+	while (!g.terminate) {
+		uint64_t now;
+
+		if (g.follow && !proc_alive()) {
+			if (!proc_follow()) {
+				(void)usleep(FOLLOW_USEC);
+				continue;
+			}
+			rc = OK;
+		}
+		now = prof_time_ns();
+		if (sched_due(SCHED_MAPS, now)) {
+			prof_t prof;
+
+			prof_begin(&prof, PROF_MAPS);
+			rc = read_maps(false);
+			prof_end(&prof);
+			if ((rc < 0) && g.follow && !proc_alive())
+				continue;
+			if (rc < 0)
+				break;
+		}
+		if (sched_due(SCHED_PAGEMAP, now))
+			pyramid_sample_frame(0, (index_t)g.mem_info.npages);
+		if (sched_due(SCHED_VM, now))
+			vm_sample(&g.vm);
+#if defined(PERF_ENABLED)
+		if (sched_due(SCHED_PERF, now)) {
+			(void)perf_sample(&g.perf);
+			(void)perf_sample(&g.perf_hw);
+		}
+#endif
+		dirty_update(&g.dirty);
+		if (sched_due(SCHED_CLEAR_REFS, now) && !g.dirty.started)
+			clear_refs();
+		/* The rest only once a refresh, not on every task wakeup */
+		if (sched_frame(&frame_ns, (uint64_t)udelay * 1000ULL, now)) {
+			if (!g.offline)
+				pressure_sample(&g.pressure);
+			export_snapshot(&g.export);
+			shm_publish(&g.shm);
+		}
+
+		if (!g.follow && !proc_alive())
+			break;
+		sched_wait(frame_ns);
+	}
+	return rc;
+}
+
+/*
+ *  fixture_init()
+ *	set up to read a directory of captured files,
+ *	the pid and page size are those of the capture
+ */
+static int fixture_init(const char *dir)
+{
+	char path[PROCPATH_MAX], buf[4096];
+	const char *ptr;
 
+	proc_paths_init(dir);
+	g.offline = true;
+
+	(void)snprintf(path, sizeof(path), "%s/pagesize", dir);
+	if (read_buf(path, buf, sizeof(buf)) == 0)
+		g.page_size = (uint32_t)strtoul(buf, NULL, 10);
+	if (read_buf(g.path_status, buf, sizeof(buf)) == 0) {
+		ptr = strstr(buf, "\nPid:");
+		if (ptr)
+			g.pid = (pid_t)strtol(ptr + 5, NULL, 10);
+	}
+	if (access(g.path_maps, R_OK) < 0)
+		return -1;
+	if (access(g.path_pagemap, R_OK) < 0)
+		return -1;
 	return 0;
 }
 
 /*
- *  show_key()
- *	show key for mapping info
+ *  capture_copy()
+ *	copy a /proc file to the capture directory
  */
-static inline void show_key(void)
+static int capture_copy(const char *src, const char *dir, const char *name)
 {
-	banner(LINES - 1);
-	if (g.view == VIEW_PAGE) {
-		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
-		(void)mvwprintw(g.mainwin, LINES - 1, 0, "Page View: ");
-		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_RED));
-		(void)wprintw(g.mainwin, "A");
-		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
-		(void)wprintw(g.mainwin, " Anon/File, ");
-		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_YELLOW));
-		(void)wprintw(g.mainwin, "P");
-		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
-		(void)wprintw(g.mainwin, " Present in RAM, ");
-		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_CYAN));
-		(void)wprintw(g.mainwin, "D");
-		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
-		(void)wprintw(g.mainwin, " Dirty, ");
-		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_GREEN));
-		(void)wprintw(g.mainwin, "S");
-		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
-		(void)wprintw(g.mainwin, " Swap, ");
-		(void)wattrset(g.mainwin, COLOR_PAIR(BLACK_WHITE));
-		(void)wprintw(g.mainwin, ".");
-		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
-		(void)wprintw(g.mainwin, " not in RAM");
-		(void)wattrset(g.mainwin, COLOR_PAIR(BLACK_WHITE) | A_BOLD);
-	} else {
-		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
-		(void)mvwprintw(g.mainwin, LINES - 1, 0, "%-*s", COLS, "Memory View");
+	char path[PROCPATH_MAX], buf[65536];
+	int sfd, dfd, rc = 0;
+	ssize_t n;
+
+	(void)snprintf(path, sizeof(path), "%s/%s", dir, name);
+	if ((sfd = open(src, O_RDONLY)) < 0)
+		return -1;
+	if ((dfd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+		(void)close(sfd);
+		return -1;
+	}
+	while ((n = read(sfd, buf, sizeof(buf))) > 0) {
+		if (write(dfd, buf, (size_t)n) != n) {
+			rc = -1;
+			break;
+		}
+	}
+	if (n < 0)
+		rc = -1;
+	(void)close(dfd);
+	(void)close(sfd);
+
+	return rc;
+}
+
+/*
+ *  capture_pagemap()
+ *	copy the pagemap entries of every mapping in the
+ *	captured maps file, the pagemap file is written
+ *	sparsely at the same offsets as in /proc
+ */
+static int capture_pagemap(const char *dir)
+{
+	char path[PROCPATH_MAX], buffer[4096];
+	static pagemap_t buf[65536];
+	const addr_t buf_pages = sizeof(buf) / sizeof(buf[0]);
+	int sfd, dfd, rc = 0;
+	FILE *fp;
+
+	(void)snprintf(path, sizeof(path), "%s/maps", dir);
+	if ((fp = fopen(path, "r")) == NULL)
+		return -1;
+	if ((sfd = open(g.path_pagemap, O_RDONLY)) < 0) {
+		(void)fclose(fp);
+		return -1;
+	}
+	(void)snprintf(path, sizeof(path), "%s/pagemap", dir);
+	if ((dfd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+		(void)close(sfd);
+		(void)fclose(fp);
+		return -1;
+	}
+
+	while ((rc == 0) && fgets(buffer, sizeof(buffer), fp)) {
+		addr_t begin, end, page;
+
+		if (sscanf(buffer, "%" SCNx64 "-%" SCNx64, &begin, &end) != 2)
+			continue;
+		for (page = begin / g.page_size; page < end / g.page_size; ) {
+			const addr_t n = MINIMUM(buf_pages, (end / g.page_size) - page);
+			const off_t offset = (off_t)(page * sizeof(pagemap_t));
+			const ssize_t ret = pread(sfd, buf, n * sizeof(pagemap_t), offset);
+
+			if (ret <= 0)
+				break;
+			if (pwrite(dfd, buf, (size_t)ret, offset) != ret) {
+				rc = -1;
+				break;
+			}
+			page += (addr_t)ret / sizeof(pagemap_t);
+		}
 	}
+	(void)close(dfd);
+	(void)close(sfd);
+	(void)fclose(fp);
+
+	return rc;
 }
 
 /*
- *  show_help()
- *	show pop-up help info
+ *  proc_stopped()
+ *	is the process already stopped or being traced?
  */
-static inline void show_help(void)
+static bool proc_stopped(const pid_t pid)
 {
-	const int x = (COLS - 45) / 2;
-	int y = (LINES - 15) / 2;
+	char path[PROCPATH_MAX], buf[1024], *ptr;
+	int fd;
+	ssize_t ret;
 
-	(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_RED) | A_BOLD);
-	(void)mvwprintw(g.mainwin, y++,  x,
-		" Pagemon Process Memory Monitor Quick Help ");
-	(void)mvwprintw(g.mainwin, y++,  x,
-		"%43s", "");
-	(void)mvwprintw(g.mainwin, y++,  x,
-		" ? or h     This help information%10s", "");
-	(void)mvwprintw(g.mainwin, y++,  x,
-		" Esc or q   Quit%27s", "");
-	(void)mvwprintw(g.mainwin, y++,  x,
-		" Tab        Toggle page information%8s", "");
-	(void)mvwprintw(g.mainwin, y++,  x,
-		" Enter      Toggle map/memory views%8s", "");
-	(void)mvwprintw(g.mainwin, y++,  x,
-		" + or z     Zoom in memory map%13s", "");
-	(void)mvwprintw(g.mainwin, y++,  x,
-		" - or Z     Zoom out memory map%12s", "");
-	(void)mvwprintw(g.mainwin, y++,  x,
-		" R or r     Read pages (swap in all pages) ");
-	(void)mvwprintw(g.mainwin, y++,  x,
-		" A or a     Toggle Auto Zoom on/off        ");
-	(void)mvwprintw(g.mainwin, y++,  x,
-		" V or v     Toggle Virtual Memory Stats    ");
-#if defined(PERF_ENABLED)
-	(void)mvwprintw(g.mainwin, y++,  x,
-		" P or p     Toggle Perf Page Stats         ");
-#endif
-	(void)mvwprintw(g.mainwin, y++,  x,
-		" PgUp/Down  Scroll up/down 1/2 page%8s", "");
-	(void)mvwprintw(g.mainwin, y++, x,
-		" Home/End   Move cursor back to top/bottom ");
-	(void)mvwprintw(g.mainwin, y, x,
-		" [ / ]      Zoom 1 / Zoom 999              ");
-	(void)mvwprintw(g.mainwin, y, x,
-		" Cursor keys move Up/Down/Left/Right%7s", "");
+	(void)snprintf(path, sizeof(path), "/proc/%i/stat", pid);
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return false;
+	ret = read(fd, buf, sizeof(buf) - 1);
+	(void)close(fd);
+	if (ret < 1)
+		return false;
+	buf[ret] = '\0';
+
+	/* Field 3, state, follows the comm in parentheses */
+	ptr = strrchr(buf, ')');
+	if (!ptr || (ptr[1] != ' '))
+		return false;
+	return (ptr[2] == 'T') || (ptr[2] == 't');
 }
 
 /*
- *  update_xymax()
- *	set the xymax scale for a specific view v
- *	based on column width and scaling factor for
- *	page or mem (hex) views
+ *  capture_stop()
+ *	stop the process with SIGSTOP unless it is already
+ *	stopped, blocking the terminating signals so pagemon
+ *	cannot exit and leave it stopped; returns true if
+ *	the process has to be continued by capture_cont()
  */
-static inline void update_xymax(position_t *const position, const int v)
+static bool capture_stop(sigset_t *const old_mask)
 {
-	static const int32_t xmax_scale[] = {
-		1,	/* VIEW_PAGE */
-		4	/* VIEW_MEM */
+	sigset_t mask;
+
+	if (proc_stopped(g.pid))
+		return false;
+
+	(void)sigemptyset(&mask);
+	(void)sigaddset(&mask, SIGINT);
+	(void)sigaddset(&mask, SIGTERM);
+	(void)sigaddset(&mask, SIGHUP);
+	(void)sigaddset(&mask, SIGQUIT);
+	(void)sigaddset(&mask, SIGPIPE);
+	(void)sigaddset(&mask, SIGTSTP);
+	(void)sigaddset(&mask, SIGTTIN);
+	(void)sigaddset(&mask, SIGTTOU);
+	(void)sigprocmask(SIG_BLOCK, &mask, old_mask);
+
+	if (kill(g.pid, SIGSTOP) < 0) {
+		(void)sigprocmask(SIG_SETMASK, old_mask, NULL);
+		return false;
+	}
+	g.capture_stopped = true;
+	return true;
+}
+
+/*
+ *  capture_cont()
+ *	continue a process stopped by capture_stop() and
+ *	restore the signal mask
+ */
+static void capture_cont(const sigset_t *const old_mask)
+{
+	if (!g.capture_stopped)
+		return;
+	(void)kill(g.pid, SIGCONT);
+	g.capture_stopped = false;
+	(void)sigprocmask(SIG_SETMASK, old_mask, NULL);
+}
+
+/*
+ *  capture()
+ *	capture the /proc files of a process into a
+ *	directory for offline use. The process keeps running
+ *	unless -X is given, then it is stopped while the maps
+ *	and pagemap are captured so they are consistent with
+ *	each other
+ */
+static int capture(const char *dir)
+{
+	char path[PROCPATH_MAX], buf[32];
+	sigset_t old_mask;
+	int fd, rc = 0;
+	size_t i;
+	static const struct {
+		const char *name;
+		const bool stop;	/* capture while stopped with -X */
+	} files[] = {
+		{ "status",		false },
+		{ "stat",		false },
+		{ "oom_score",		false },
+		{ "io",			false },
+		{ "maps",		true },
+		{ "smaps",		true },
+		{ "smaps_rollup",	true },
 	};
 
-	position[v].xmax = (COLS - ADDR_OFFSET) / xmax_scale[v];
-	position[v].ymax = LINES - 2;
+	if ((mkdir(dir, 0755) < 0) && (errno != EEXIST)) {
+		(void)fprintf(stderr, "Cannot create directory %s\n", dir);
+		return -1;
+	}
+
+	for (i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+		if (files[i].stop)
+			continue;
+		(void)snprintf(path, sizeof(path), "/proc/%i/%s", g.pid, files[i].name);
+		(void)capture_copy(path, dir, files[i].name);
+	}
+
+	if (g.opt_flags & OPT_FLAG_CAPTURE_STOP)
+		(void)capture_stop(&old_mask);
+	for (i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+		if (!files[i].stop)
+			continue;
+		(void)snprintf(path, sizeof(path), "/proc/%i/%s", g.pid, files[i].name);
+		if (capture_copy(path, dir, files[i].name) < 0) {
+			(void)fprintf(stderr, "Cannot capture %s\n", path);
+			rc = -1;
+		}
+	}
+	if (capture_pagemap(dir) < 0) {
+		(void)fprintf(stderr, "Cannot capture %s\n", g.path_pagemap);
+		rc = -1;
+	}
+	capture_cont(&old_mask);
+
+	(void)snprintf(path, sizeof(path), "%s/pagesize", dir);
+	if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) > -1) {
+		const int len = snprintf(buf, sizeof(buf), "%" PRIu32 "\n", g.page_size);
+
+		if (write(fd, buf, (size_t)len) != len)
+			rc = -1;
+		(void)close(fd);
+	}
+	return rc;
 }
 
 /*
@@ -1121,6 +8034,24 @@ static inline void reset_cursor(
 	*page_index = 0;
 }
 
+/*
+ *  zoom_cursor()
+ *	on a zoom change keep the page that was under
+ *	the cursor, moving it to the top of the view
+ */
+static inline void zoom_cursor(
+	position_t *const p,
+	index_t *const data_index,
+	index_t *const page_index,
+	const int32_t zoom)
+{
+	const index_t cursor_index = *page_index +
+		zoom * (p->xpos + ((index_t)p->ypos * p->xmax));
+
+	reset_cursor(p, data_index, page_index);
+	*page_index = cursor_index;
+}
+
 int main(int argc, char **argv)
 {
 	struct sigaction action;
@@ -1129,8 +8060,11 @@ int main(int argc, char **argv)
 	position_t position[2];
 	index_t page_index, prev_page_index;
 	index_t data_index, prev_data_index;
-	int32_t tick, ticks, blink, zoom;
+	int32_t ticks, blink, zoom;
 	int rc, ret;
+	static char *capture_dir, *fixture_dir;
+	static index_t view_begin, view_end;
+	static uint64_t frame_ns;
 
 	if (sigsetjmp(g.env, 0)) {
 		rc = ERR_FAULT;
@@ -1138,17 +8072,20 @@ int main(int argc, char **argv)
 	}
 
 	g.pid = -1;
+	g.pidfd = -1;
 	rc = OK;
 	blink = 0;
 	zoom = MIN_ZOOM;
 	ticks = DEFAULT_TICKS;
-	tick = 0;
 	udelay = DEFAULT_UDELAY;
+	g.dirty.interval_ms = DIRTY_INTERVAL_MS;
+	g.dirty.link_mbs = DIRTY_LINK_MBS;
+	g.dirty.timer_fd = -1;
 	page_index = 0;
 	data_index = 0;
 
 	for (;;) {
-		int c = getopt(argc, argv, "ad:hp:rt:vz:");
+		int c = getopt(argc, argv, "aA:B:C:Dd:e:Ff:hi:L:M:p:P:rS:sT:t:vXz:");
 
 		if (c == -1)
 			break;
@@ -1156,6 +8093,22 @@ int main(int argc, char **argv)
 		case 'a':
 			g.auto_zoom = true;
 			break;
+		case 'A':
+			errno = 0;
+			g.ansi.max_bytes = strtoul(optarg, NULL, 10);
+			if (errno) {
+				(void)fprintf(stderr, "Invalid frame output size\n");
+				exit(EXIT_FAILURE);
+			}
+			g.ansi.enabled = true;
+			break;
+		case 'B':
+			g.dirty.link_mbs = atof(optarg);
+			if (g.dirty.link_mbs <= 0.0) {
+				(void)fprintf(stderr, "Invalid link bandwidth\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
 		case 'd':
 			udelay = strtoul(optarg, NULL, 10);
 			if (errno) {
@@ -1163,19 +8116,77 @@ int main(int argc, char **argv)
 				exit(EXIT_FAILURE);
 			}
 			break;
+#if defined(PERF_ENABLED)
+		case 'e':
+			if (!strcmp(optarg, "list")) {
+				perf_events_show();
+				exit(EXIT_SUCCESS);
+			}
+			if (perf_events_parse(&g.perf, optarg) < 0) {
+				(void)fprintf(stderr, "Invalid perf event list '%s'\n",
+					optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+#endif
 		case 'h':
 			show_usage();
 			exit(EXIT_SUCCESS);
 			break;
+		case 'i':
+			g.dirty.interval_ms = strtoull(optarg, NULL, 10);
+			if (!g.dirty.interval_ms) {
+				(void)fprintf(stderr, "Invalid dirty rate interval\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'L':
+			g.dirty.log_path = optarg;
+			break;
+		case 'F':
+			g.follow = true;
+			break;
+		case 'D':
+			g.export.daemon = true;
+			break;
+		case 'S':
+			g.export.path = optarg;
+			break;
+		case 'M':
+			g.shm.name = optarg;
+			break;
 		case 'p':
-			g.pid = proc_name_to_pid(optarg);
+		case 'P':
+			proc_match_free(&g.match);
+			g.pid = proc_lookup(optarg, c == 'P');
 			if (g.pid < 1)
 				exit(EXIT_FAILURE);
 			g.opt_flags |= OPT_FLAG_PID;
 			break;
+		case 'C':
+			capture_dir = optarg;
+			g.opt_flags |= OPT_FLAG_CAPTURE;
+			break;
+		case 'X':
+			g.opt_flags |= OPT_FLAG_CAPTURE_STOP;
+			break;
+		case 'f':
+			fixture_dir = optarg;
+			g.opt_flags |= OPT_FLAG_FIXTURE;
+			break;
 		case 'r':
 			g.opt_flags |= OPT_FLAG_READ_ALL_PAGES;
 			break;
+		case 's':
+			g.opt_flags |= OPT_FLAG_PROF_DUMP;
+			break;
+		case 'T':
+			if (sched_parse(optarg) < 0) {
+				(void)fprintf(stderr, "Invalid sampling period list '%s'\n",
+					optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
 		case 't':
 			ticks = strtol(optarg, NULL, 10);
 			if ((ticks < MIN_TICKS) || (ticks > MAX_TICKS)) {
@@ -1198,25 +8209,61 @@ int main(int argc, char **argv)
 			exit(EXIT_FAILURE);
 		}
 	}
-	if (!(g.opt_flags & OPT_FLAG_PID)) {
-		(void)fprintf(stderr, "Must provide process ID with -p option\n");
-		exit(EXIT_FAILURE);
+	g.page_size = sysconf(_SC_PAGESIZE);
+	if (g.page_size == (uint32_t)-1) {
+		/* Guess */
+		g.page_size = 4096UL;
+	}
+	if (g.opt_flags & OPT_FLAG_FIXTURE) {
+		if (fixture_init(fixture_dir) < 0) {
+			(void)fprintf(stderr, "Cannot read captured maps and "
+				"pagemap in %s\n", fixture_dir);
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		if (!(g.opt_flags & OPT_FLAG_PID)) {
+			(void)fprintf(stderr, "Must provide process ID with -p option\n");
+			exit(EXIT_FAILURE);
+		}
+		if (geteuid() != 0) {
+			(void)fprintf(stderr, "%s requires root privileges to "
+				"access memory of pid %d\n", APP_NAME, g.pid);
+			exit(EXIT_FAILURE);
+		}
+		if (kill(g.pid, 0) < 0) {
+			(void)fprintf(stderr, "No such process %d\n", g.pid);
+			exit(EXIT_FAILURE);
+		}
+		if (g.follow && (proc_follow_init(g.pid) < 0))
+			exit(EXIT_FAILURE);
+		proc_attach(g.pid);
+	}
+	if (g.opt_flags & OPT_FLAG_CAPTURE) {
+		if (g.offline) {
+			(void)fprintf(stderr, "Cannot capture from a captured fixture\n");
+			exit(EXIT_FAILURE);
+		}
+		if (capture(capture_dir) < 0)
+			exit(EXIT_FAILURE);
+		exit(EXIT_SUCCESS);
 	}
-	if (geteuid() != 0) {
-		(void)fprintf(stderr, "%s requires root privileges to "
-			"access memory of pid %d\n", APP_NAME, g.pid);
+	if (g.export.daemon && !g.export.path && !g.shm.name && !g.dirty.log_path) {
+		(void)fprintf(stderr, "Must provide a metrics socket with the -S option, "
+			"a shared memory name with the -M option or a dirty rate "
+			"log with the -L option\n");
 		exit(EXIT_FAILURE);
 	}
-	if (kill(g.pid, 0) < 0) {
-		(void)fprintf(stderr, "No such process %d\n", g.pid);
+	if (g.dirty.log_path && g.offline) {
+		(void)fprintf(stderr, "Cannot track the dirty rate of a captured fixture\n");
 		exit(EXIT_FAILURE);
 	}
-	g.page_size = sysconf(_SC_PAGESIZE);
-	if (g.page_size == (uint32_t)-1) {
-		/* Guess */
-		g.page_size = 4096UL;
+	if (g.ansi.enabled && !g.export.daemon &&
+	    (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO))) {
+		(void)fprintf(stderr, "Direct ANSI output needs a terminal\n");
+		exit(EXIT_FAILURE);
 	}
 	g.max_pages = ((addr_t)((size_t)~0)) / g.page_size;
+	sched_init(udelay, ticks);
 	(void)memset(&action, 0, sizeof(action));
 	action.sa_handler = handle_winch;
 	if (sigaction(SIGWINCH, &action, NULL) < 0) {
@@ -1234,22 +8281,72 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 
-	(void)snprintf(g.path_refs, sizeof(g.path_refs),
-		"/proc/%i/clear_refs", g.pid);
-	(void)snprintf(g.path_pagemap, sizeof(g.path_pagemap),
-		"/proc/%i/pagemap", g.pid);
-	(void)snprintf(g.path_maps, sizeof(g.path_maps),
-		"/proc/%i/maps", g.pid);
-	(void)snprintf(g.path_mem, sizeof(g.path_mem),
-		"/proc/%i/mem", g.pid);
-	(void)snprintf(g.path_status, sizeof(g.path_status),
-		"/proc/%i/status", g.pid);
-	(void)snprintf(g.path_stat, sizeof(g.path_stat),
-		"/proc/%i/stat", g.pid);
-	(void)snprintf(g.path_oom, sizeof(g.path_oom),
-		"/proc/%i/oom_score", g.pid);
+	if (g.export.path && (export_start(&g.export) < 0))
+		exit(EXIT_FAILURE);
+	if (g.shm.name && (shm_start(&g.shm) < 0)) {
+		export_stop(&g.export);
+		exit(EXIT_FAILURE);
+	}
+	if (g.dirty.log_path && (dirty_start(&g.dirty) < 0)) {
+		export_stop(&g.export);
+		shm_stop(&g.shm);
+		exit(EXIT_FAILURE);
+	}
+#if defined(PERF_ENABLED)
+	if (!g.offline) {
+		perf_start(&g.perf, g.pid);
+		perf_hw_events(&g.perf_hw);
+		perf_start(&g.perf_hw, g.pid);
+	}
+#endif
+	if (g.export.daemon) {
+		(void)memset(&action, 0, sizeof(action));
+		action.sa_handler = handle_stop;
+		if ((sigaction(SIGINT, &action, NULL) < 0) ||
+		    (sigaction(SIGTERM, &action, NULL) < 0)) {
+			(void)fprintf(stderr, "Could not set up stop handler\n");
+			rc = ERR_FAULT;
+			goto terminate;
+		}
+		rc = export_run(udelay);
+		goto terminate;
+	}
 
-	(void)initscr();
+	if (g.ansi.enabled) {
+		if (ansi_start(&g.ansi) < 0) {
+			rc = ERR_FAULT;
+			goto terminate;
+		}
+		/*
+		 *  curses' own handlers would exit or suspend without
+		 *  putting back the terminal it does not write to
+		 */
+		(void)memset(&action, 0, sizeof(action));
+		action.sa_handler = handle_stop;
+		if ((sigaction(SIGINT, &action, NULL) < 0) ||
+		    (sigaction(SIGTERM, &action, NULL) < 0) ||
+		    (sigaction(SIGHUP, &action, NULL) < 0)) {
+			(void)fprintf(stderr, "Could not set up stop handler\n");
+			rc = ERR_FAULT;
+			goto terminate;
+		}
+		action.sa_handler = handle_tstp;
+		if (sigaction(SIGTSTP, &action, NULL) < 0) {
+			(void)fprintf(stderr, "Could not set up suspend handler\n");
+			rc = ERR_FAULT;
+			goto terminate;
+		}
+		action.sa_handler = handle_cont;
+		if (sigaction(SIGCONT, &action, NULL) < 0) {
+			(void)fprintf(stderr, "Could not set up resume handler\n");
+			rc = ERR_FAULT;
+			goto terminate;
+		}
+		/* Size the screen from the terminal on the first frame */
+		g.resized = true;
+	} else {
+		(void)initscr();
+	}
 	(void)start_color();
 	(void)cbreak();
 	(void)noecho();
@@ -1269,27 +8366,50 @@ int main(int argc, char **argv)
 	(void)init_pair(RED_BLUE, COLOR_RED, COLOR_BLUE);
 	(void)init_pair(BLACK_BLACK, COLOR_BLACK, COLOR_BLACK);
 	(void)init_pair(BLUE_WHITE, COLOR_BLUE, COLOR_WHITE);
+	(void)init_pair(WHITE_MAGENTA, COLOR_WHITE, COLOR_MAGENTA);
 
 	(void)memset(position, 0, sizeof(position));
 	update_xymax(position, 0);
 	update_xymax(position, 1);
 
-#if defined(PERF_ENABLED)
-	perf_start(&g.perf, g.pid);
-#endif
-
 	for (;;) {
 		int ch, blink_attrs;
-		char cursor_ch;
+		char cursor_ch, zoom_str[8];
 		position_t *p = &position[g.view];
+		prof_t prof;
 		addr_t show_addr;
+		uint64_t now;
 		float percent;
 
-		if ((!tick) && (g.view == VIEW_PAGE)) {
-			if ((rc = read_maps(false)) < 0)
+		if (g.terminate)
+			break;
+		if (g.follow && !proc_alive()) {
+			if (!proc_follow()) {
+				/* Keep looking until it restarts */
+				show_follow_wait();
+				ch = getch();
+				if ((ch == 27) || (ch == 'q') || (ch == 'Q'))
+					break;
+				(void)usleep(FOLLOW_USEC);
+				continue;
+			}
+			rc = OK;
+		}
+		now = prof_time_ns();
+		if (sched_due(SCHED_MAPS, now) && (g.view == VIEW_PAGE)) {
+			prof_begin(&prof, PROF_MAPS);
+			rc = read_maps(false);
+			prof_end(&prof);
+			/* Exited, pick up the restart on the next frame */
+			if ((rc < 0) && g.follow && !proc_alive())
+				continue;
+			if (rc < 0)
 				break;
 		}
-		if ((g.view == VIEW_PAGE) && g.auto_zoom) {
+		if ((g.view == VIEW_PAGE) && g.auto_zoom && g.va_view) {
+			g.va_shift = va_shift_max(p);
+			va_move(p);
+		} else if ((g.view == VIEW_PAGE) && g.auto_zoom) {
 			const int32_t window_pages = p->xmax * p->ymax;
 
 			zoom = (window_pages == 0) ? 1 :
@@ -1301,20 +8421,54 @@ int main(int argc, char **argv)
 			read_all_pages();
 			g.opt_flags &= ~OPT_FLAG_READ_ALL_PAGES;
 		}
-		if (!tick) {
-			int fd;
-			tick = 0;
+		if (sched_due(SCHED_VM, now))
+			vm_sample(&g.vm);
+#if defined(PERF_ENABLED)
+		if (sched_due(SCHED_PERF, now)) {
+			(void)perf_sample(&g.perf);
+			(void)perf_sample(&g.perf_hw);
+		}
+#endif
+		if (!g.offline)
+			pressure_sample(&g.pressure);
+		reclaim_update(&g.reclaim);
+		if (g.swap_view && (!g.swapmap.scan_ns ||
+		    (prof_time_ns() - g.swapmap.scan_ns >= SWAPMAP_NS)))
+			swapmap_scan(&g.swapmap);
+		if (g.phys_view && (!g.physmap.scan_ns ||
+		    (prof_time_ns() - g.physmap.scan_ns >= PHYSMAP_NS)))
+			physmap_scan(&g.physmap);
+		dirty_update(&g.dirty);
+#if defined(PERF_ENABLED)
+		if (g.fault_view)
+			(void)perf_sample_drain(&g.sample, fault_bin, NULL);
+#endif
+		if (sched_due(SCHED_CLEAR_REFS, now)) {
+#if defined(PERF_ENABLED)
+			if (g.fault_view)
+				faults_decay();
+#endif
+			/* Dirty rate tracking clears soft dirty on its own timer */
+			if (!g.dirty.started)
+				clear_refs();
+		}
+		export_snapshot(&g.export);
+		shm_publish(&g.shm);
 
-			fd = open(g.path_refs, O_RDWR);
-			if (fd > -1) {
-				ret = write(fd, "4", 1);
-				(void)ret;
-				(void)close(fd);
-			}
+		/*
+		 *  Woken for a sampling task before the frame is due,
+		 *  sample the pages shown last frame and go back to
+		 *  sleep, the screen is only drawn once a refresh
+		 */
+		if (!sched_frame(&frame_ns, (uint64_t)udelay * 1000ULL, now)) {
+			if ((g.view == VIEW_PAGE) && sched_due(SCHED_PAGEMAP, now))
+				pyramid_sample_frame(view_begin, MINIMUM(view_end,
+					(index_t)g.mem_info.npages));
+			if (g.terminate || (!g.follow && !proc_alive()))
+				break;
+			sched_wait(frame_ns);
+			continue;
 		}
-		tick++;
-		if (tick > ticks)
-			tick = 0;
 
 		/*
 		 *  SIGWINCH window resize triggered so
@@ -1361,9 +8515,8 @@ int main(int argc, char **argv)
 			(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_RED) | A_BOLD);
 			(void)mvwprintw(g.mainwin, LINES / 2, (COLS / 2) - 8,
 				" WINDOW TOO SMALL ");
-			(void)wrefresh(g.mainwin);
-			(void)refresh();
-			(void)usleep(udelay);
+			screen_refresh();
+			sched_wait(frame_ns);
 			continue;
 		}
 
@@ -1410,6 +8563,32 @@ int main(int argc, char **argv)
 				& A_CHARTEXT;
 			(void)mvwprintw(g.mainwin, p->ypos + 1, curxpos,
 				"%c", cursor_ch);
+		} else if (g.va_view) {
+			const int32_t curxpos = p->xpos + ADDR_OFFSET;
+			const uint64_t cell = va_cursor_cell(p);
+			const index_t cursor_index = va_cell_index(cell);
+			index_t begin, end;
+
+			va_index_range(p, &begin, &end);
+			view_begin = begin;
+			view_end = end;
+			if (sched_due(SCHED_PAGEMAP, now))
+				pyramid_sample_frame(begin, end);
+			percent = 100.0 * (double)cell / (double)va_cells();
+			map = (cursor_index < 0) ? NULL :
+				g.mem_info.pages[cursor_index].map;
+			show_addr = cell << g.va_shift;
+			if (show_va(cursor_index, p) < 0)
+				break;
+
+			blink_attrs = A_BOLD | ((blink & BLINK_MASK) ?
+				COLOR_PAIR(BLACK_WHITE) :
+				COLOR_PAIR(WHITE_BLACK));
+			(void)wattrset(g.mainwin, blink_attrs);
+			cursor_ch = mvwinch(g.mainwin, p->ypos + 1, curxpos)
+				& A_CHARTEXT;
+			(void)mvwprintw(g.mainwin, p->ypos + 1, curxpos,
+				"%c", cursor_ch);
 		} else {
 			int32_t curxpos = p->xpos + ADDR_OFFSET;
 			const index_t cursor_index = page_index +
@@ -1426,6 +8605,14 @@ int main(int argc, char **argv)
 
 			map = g.mem_info.pages[cursor_index].map;
 			show_addr = g.mem_info.pages[cursor_index].addr;
+			if (g.selecting)
+				g.sel_end = show_addr;
+			view_begin = page_index;
+			view_end = MINIMUM(page_index +
+				(index_t)zoom * p->xmax * p->ymax,
+				(index_t)g.mem_info.npages);
+			if (sched_due(SCHED_PAGEMAP, now))
+				pyramid_sample_frame(view_begin, view_end);
 			show_pages(cursor_index, page_index, p, zoom);
 
 			blink_attrs = A_BOLD | ((blink & BLINK_MASK) ?
@@ -1444,29 +8631,59 @@ int main(int argc, char **argv)
 
 		(void)wattrset(g.mainwin, COLOR_PAIR(WHITE_BLUE) | A_BOLD);
 		banner(0);
-		if (!map) {
+		if ((g.view == VIEW_PAGE) && g.va_view)
+			va_cell_str(zoom_str, sizeof(zoom_str));
+		else
+			(void)snprintf(zoom_str, sizeof(zoom_str), "x %-3d", zoom);
+		if (!map && !((g.view == VIEW_PAGE) && g.va_view)) {
 			(void)mvwprintw(g.mainwin, 0, 0,
-				"Pagemon 0x---------------- %4.4s x %-3d ",
+				"Pagemon 0x---------------- %4.4s %-5.5s ",
 				g.auto_zoom && ((blink & BLINK_MASK)) ?
-				"Auto" : "Zoom", zoom);
-			(void)wprintw(g.mainwin, "---- --:-- %-20.20s",
-				"[Not Mapped]");
+				"Auto" : "Zoom", zoom_str);
 		} else {
 			(void)mvwprintw(g.mainwin, 0, 0, "Pagemon 0x%16.16" PRIx64
-				" %4.4s x %-3d ", show_addr,
+				" %4.4s %-5.5s ", show_addr,
 				g.auto_zoom && ((blink & BLINK_MASK)) ?
-					"Auto" : "Zoom", zoom);
+					"Auto" : "Zoom", zoom_str);
+		}
+		if (!map) {
+			(void)wprintw(g.mainwin, "---- --:-- %-20.20s",
+				"[Not Mapped]");
+		} else {
 			(void)wprintw(g.mainwin, "%s %s %-20.20s",
-				map->attr, map->dev,
-				map->name[0] == '\0' ?
-					"[Anonymous]" : basename(map->name));
+				map->attr, map_dev(map),
+				map_basename(map));
 		}
-		(void)mvwprintw(g.mainwin, 0, COLS - 20, " PID %7d", g.pid);
+		(void)mvwprintw(g.mainwin, 0, COLS - 20, " PID%c%7d",
+			g.follow ? '+' : ' ', g.pid);
 		(void)mvwprintw(g.mainwin, 0, COLS - 8, " %6.1f%%", percent);
 
-		(void)wrefresh(g.mainwin);
-		(void)refresh();
+		if (g.reclaim.active && (g.view == VIEW_PAGE))
+			show_reclaim(&g.reclaim);
+		if (g.pressure_view)
+			show_pressure(&g.pressure);
+		if (g.swap_view)
+			show_swapmap(&g.swapmap);
+		if (g.dirty_view)
+			show_dirty(&g.dirty);
+		if (g.prof_view)
+			show_prof();
+
+		prof_begin(&prof, PROF_REFRESH);
+		screen_refresh();
+		prof_end(&prof);
 force_ch:
+		/* Argument of a g or k command, anything else cancels */
+		if ((g.prompt != PROMPT_NONE) && (ch != ERR)) {
+			if ((g.prompt == PROMPT_MIGRATE) && isdigit(ch))
+				migrate_start(&g.migrate, ch - '0');
+			else if ((g.prompt == PROMPT_RECLAIM) && (ch == 'c'))
+				reclaim_start(&g.reclaim, MADV_COLD);
+			else if ((g.prompt == PROMPT_RECLAIM) && (ch == 'p'))
+				reclaim_start(&g.reclaim, MADV_PAGEOUT);
+			g.prompt = PROMPT_NONE;
+			ch = ERR;
+		}
 		prev_page_index = page_index;
 		prev_data_index = data_index;
 		p->xpos_prev = p->xpos;
@@ -1485,16 +8702,105 @@ force_ch:
 			/* Toggle perf stats */
 			g.perf_view = !g.perf_view;
 			break;
+		case 'f':
+		case 'F':
+			/* Toggle page fault sampling */
+			if (g.offline) {
+				break;
+			} else if (g.fault_view) {
+				perf_sample_stop(&g.sample);
+				g.fault_view = false;
+			} else if (perf_sample_start(&g.sample, g.pid) == 0) {
+				g.fault_view = true;
+			}
+			break;
 #endif
 		case '\t':
 			/* Toggle Tab view */
 			g.tab_view = !g.tab_view;
 			break;
+		case 'm':
+			/* Mark selection start, then end, then clear */
+			if (g.selecting) {
+				g.selecting = false;
+			} else if (g.selection) {
+				g.selection = false;
+			} else if ((g.view == VIEW_PAGE) && !g.va_view && map) {
+				g.sel_begin = show_addr;
+				g.sel_end = show_addr;
+				g.selection = true;
+				g.selecting = true;
+			}
+			break;
+		case 'M':
+			/* Select the map under the cursor */
+			if ((g.view == VIEW_PAGE) && !g.va_view && map) {
+				g.sel_begin = map->begin;
+				g.sel_end = map->end - g.page_size;
+				g.selection = true;
+				g.selecting = false;
+			}
+			break;
+		case 'g':
+		case 'G':
+			/* Migrate selection to a NUMA node */
+			if (g.selection && !g.offline)
+				g.prompt = PROMPT_MIGRATE;
+			break;
+		case 'k':
+		case 'K':
+			/* Reclaim selection, or close the report */
+			if (g.reclaim.active)
+				reclaim_free(&g.reclaim);
+			else if (g.selection && !g.offline)
+				g.prompt = PROMPT_RECLAIM;
+			break;
+		case 'n':
+		case 'N':
+			/* Toggle NUMA node view */
+			if (!g.offline)
+				g.numa_view = !g.numa_view;
+			break;
 		case 'v':
 		case 'V':
 			/* Toggle VM stats view */
 			g.vm_view = !g.vm_view;
 			break;
+		case 'b':
+		case 'B':
+			/* Toggle page cache of file pages not in RAM */
+			if (!g.offline)
+				g.cache_view = !g.cache_view;
+			break;
+		case 'i':
+		case 'I':
+			/* Toggle dirty rate tracking, the log keeps it running */
+			if (g.offline)
+				break;
+			g.dirty_view = !g.dirty_view;
+			if (g.dirty_view)
+				g.dirty_view = (dirty_start(&g.dirty) == 0);
+			else if (!g.dirty.log_path)
+				dirty_stop(&g.dirty);
+			break;
+		case 'y':
+		case 'Y':
+			/* Toggle physical contiguity view, scan again when shown */
+			g.phys_view = !g.phys_view;
+			g.physmap.scan_ns = 0;
+			break;
+		case 'w':
+		case 'W':
+			/* Toggle swap layout analysis, scan again when shown */
+			g.swap_view = !g.swap_view;
+			g.swapmap.scan_ns = 0;
+			break;
+		case 'u':
+		case 'U':
+			/* Toggle cgroup memory pressure view */
+			if (!g.offline)
+				g.pressure_view = !g.pressure_view;
+			break;
 		case '?':
 		case 'h':
 			/* Toggle Help */
@@ -1504,13 +8810,47 @@ force_ch:
 		case 'R':
 			read_all_pages();
 			break;
+		case 'o':
+		case 'O':
+			/* Toggle self profiling stats */
+			g.prof_view = !g.prof_view;
+			break;
 		case 'a':
 		case 'A':
 			/* Toggle auto zoom */
 			g.auto_zoom = !g.auto_zoom;
 			break;
+		case 'x':
+		case 'X':
+			/* Toggle address space view */
+			if (g.view != VIEW_PAGE)
+				break;
+			if (!g.va_view) {
+				const index_t cursor_index = page_index +
+					zoom * (p->xpos + ((index_t)p->ypos * p->xmax));
+
+				g.va_view = true;
+				va_goto(p, (cursor_index < (index_t)g.mem_info.npages) ?
+					g.mem_info.pages[cursor_index].addr : 0,
+					g.va_shift);
+				break;
+			}
+			/* fall through */
 		case '\n':
-			/* Toggle MAP / MEMORY views */
+			if (g.va_view && (g.view == VIEW_PAGE)) {
+				/* Page view from the cursor cell onwards */
+				const index_t cursor_index =
+					va_cell_index(va_cursor_cell(p));
+
+				g.va_view = false;
+				reset_cursor(p, &data_index, &page_index);
+				if (cursor_index >= 0)
+					page_index = cursor_index;
+				break;
+			}
+			/* Toggle MAP / MEMORY views, memory is not captured */
+			if (g.offline)
+				break;
 			g.view ^= 1;
 			p = &position[g.view];
 			blink = 0;
@@ -1518,46 +8858,62 @@ force_ch:
 		case '+':
 		case 'z':
 			/* Zoom in */
-			if (g.view == VIEW_PAGE) {
+			if ((g.view == VIEW_PAGE) && g.va_view) {
+				va_goto(p, va_cursor_cell(p) << g.va_shift,
+					g.va_shift - 1);
+			} else if (g.view == VIEW_PAGE) {
+				zoom_cursor(p, &data_index, &page_index, zoom);
 				zoom++ ;
 				zoom = MINIMUM(MAX_ZOOM, zoom);
-				reset_cursor(p, &data_index, &page_index);
 			}
 			break;
 		case '-':
 		case 'Z':
 			/* Zoom out */
-			if (g.view == VIEW_PAGE) {
+			if ((g.view == VIEW_PAGE) && g.va_view) {
+				va_goto(p, va_cursor_cell(p) << g.va_shift,
+					g.va_shift + 1);
+			} else if (g.view == VIEW_PAGE) {
+				zoom_cursor(p, &data_index, &page_index, zoom);
 				zoom--;
 				zoom = MAXIMUM(MIN_ZOOM, zoom);
-				reset_cursor(p, &data_index, &page_index);
 			}
 			break;
 		case '[':
 			/* Reset zoom to MIN_ZOOM */
-			if (g.view == VIEW_PAGE) {
+			if ((g.view == VIEW_PAGE) && g.va_view) {
+				g.auto_zoom = false;
+				va_goto(p, va_cursor_cell(p) << g.va_shift, 0);
+			} else if (g.view == VIEW_PAGE) {
 				g.auto_zoom = false;
+				zoom_cursor(p, &data_index, &page_index, zoom);
 				zoom = MIN_ZOOM;
-				reset_cursor(p, &data_index, &page_index);
 			}
 			break;
 		case ']':
-			/* Reset zoom to MAX_ZOOM */
-			if (g.view == VIEW_PAGE) {
+			/* Reset zoom to MAX_ZOOM, whole address space */
+			if ((g.view == VIEW_PAGE) && g.va_view) {
+				g.auto_zoom = false;
+				va_goto(p, va_cursor_cell(p) << g.va_shift, 64);
+			} else if (g.view == VIEW_PAGE) {
 				g.auto_zoom = false;
+				zoom_cursor(p, &data_index, &page_index, zoom);
 				zoom = MAX_ZOOM;
-				reset_cursor(p, &data_index, &page_index);
 			}
 			break;
 		case 't':
 			/* Tick increase */
 			ticks++;
 			ticks = MINIMUM(MAX_TICKS, ticks);
+			sched_period(SCHED_CLEAR_REFS,
+				(uint64_t)udelay * 1000ULL * (uint64_t)ticks);
 			break;
 		case 'T':
 			/* Tick decrease */
 			ticks--;
 			ticks = MAXIMUM(MIN_TICKS, ticks);
+			sched_period(SCHED_CLEAR_REFS,
+				(uint64_t)udelay * 1000ULL * (uint64_t)ticks);
 			break;
 		case 'c':
 		case 'C':
@@ -1566,8 +8922,14 @@ force_ch:
 			g.perf_view = false;
 #endif
 			g.vm_view = false;
+			g.pressure_view = false;
+			g.swap_view = false;
 			g.tab_view = false;
+			if (g.dirty_view && !g.dirty.log_path)
+				dirty_stop(&g.dirty);
+			g.dirty_view = false;
 			g.help_view = false;
+			g.prof_view = false;
 			break;
 		case KEY_DOWN:
 			blink = 0;
@@ -1607,9 +8969,12 @@ force_ch:
 			break;
 		case KEY_HOME:
 			reset_cursor(p, &data_index, &page_index);
+			g.va_row = 0;
 			break;
 		case KEY_END:
-			if (g.view == VIEW_PAGE) {
+			if ((g.view == VIEW_PAGE) && g.va_view) {
+				g.va_row = ~0ULL >> 1;
+			} else if (g.view == VIEW_PAGE) {
 				page_index = g.mem_info.npages - 1;
 				p->xpos = 0;
 			} else {
@@ -1620,6 +8985,10 @@ force_ch:
 			p->xpos = p->xmax - 1;
 			break;
 		}
+		if ((g.view == VIEW_PAGE) && g.va_view) {
+			va_move(p);
+			goto next;
+		}
 		if (page_index < 0)
 			page_index = 0;
 
@@ -1718,12 +9087,13 @@ force_ch:
 					p->xpos = last - 1;
 			}
 		}
+next:
 		if (g.terminate)
 			break;
 
-		if (kill(g.pid, 0) < 0)
+		if (!g.follow && !proc_alive())
 			break;
-		(void)usleep(udelay);
+		sched_wait(frame_ns);
 	}
 
 	(void)werase(g.mainwin);
@@ -1732,15 +9102,45 @@ force_ch:
 	(void)delwin(g.mainwin);
 
 terminate:
+	if (g.capture_stopped)
+		(void)kill(g.pid, SIGCONT);
 	if (g.curses_started) {
 		(void)clear();
 		(void)endwin();
 	}
+	ansi_stop(&g.ansi);
 
 #if defined(PERF_ENABLED)
 	perf_stop(&g.perf);
+	perf_stop(&g.perf_hw);
+	perf_sample_stop(&g.sample);
+	free(g.faults);
 #endif
+	export_stop(&g.export);
+	shm_stop(&g.shm);
 	free(g.mem_info.pages);
+	migrate_stop(&g.migrate);
+	reclaim_free(&g.reclaim);
+	swapmap_free(&g.swapmap);
+	physmap_free(&g.physmap);
+	dirty_free(&g.dirty);
+	fcache_reset(&g.fcache);
+	pyramid_free(&g.mem_info.pyramid);
+	numa_free();
+	free(g.numa.buf);
+	free(g.mem_info.maps);
+	free(g.mem_info.map_info);
+	free(g.mem_info.names.buf);
+	free(g.mem_info.names.hash);
+	free(g.mem_info.buf);
+	vm_close(&g.vm);
+	pressure_close(&g.pressure);
+	proc_match_free(&g.match);
+	if (g.pidfd >= 0)
+		(void)close(g.pidfd);
+
+	if (g.opt_flags & OPT_FLAG_PROF_DUMP)
+		dump_prof();
 
 	ret = EXIT_FAILURE;
 	switch (rc) {
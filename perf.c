@@ -32,86 +32,482 @@
 #include <errno.h>
 #include <sys/ioctl.h>
 #include <limits.h>
+#include <dirent.h>
+#include <ctype.h>
+#include <sys/mman.h>
+#include <time.h>
 #include <linux/perf_event.h>
 
 #define UNRESOLVED	(~0UL)
 
-static perf_tp_info_t perf_tp_info[] = {
-	{ PERF_TP_PAGE_FAULT_USER,	"exceptions/page_fault_user" },
-	{ PERF_TP_PAGE_FAULT_KERNEL,	"exceptions/page_fault_kernel" },
-	{ PERF_TP_MM_PAGE_ALLOC,	"kmem/mm_page_alloc" },
-	{ PERF_TP_MM_PAGE_FREE,		"kmem/mm_page_free" },
+static const perf_tp_info_t perf_tp_info[] = {
+	{ "page_fault_user",	"Page Faults (User Space)",
+	  "exceptions/page_fault_user",			NULL,	true },
+	{ "page_fault_kernel",	"Page Faults (Kernel Space)",
+	  "exceptions/page_fault_kernel",		NULL,	true },
+	{ "page_alloc",		"Kernel Page Allocate",
+	  "kmem/mm_page_alloc",				NULL,	true },
+	{ "page_free",		"Kernel Page Free",
+	  "kmem/mm_page_free",				NULL,	true },
+	{ "swap_out",		"Swap Out (Reclaim Write)",
+	  "vmscan/mm_vmscan_write_folio",	"vmscan/mm_vmscan_writepage", false },
+	{ "filemap_add",	"Page Cache Add",
+	  "filemap/mm_filemap_add_to_page_cache",	NULL,	false },
+	{ "filemap_delete",	"Page Cache Delete",
+	  "filemap/mm_filemap_delete_from_page_cache",	NULL,	false },
+	{ "compaction",		"Compaction",
+	  "compaction/mm_compaction_begin",		NULL,	false },
+	{ "migrate",		"Page Migration",
+	  "migrate/mm_migrate_pages",			NULL,	false },
+	{ "thp_collapse",	"THP Collapse",
+	  "huge_memory/mm_collapse_huge_page",		NULL,	false },
+	{ "direct_reclaim",	"Direct Reclaim",
+	  "vmscan/mm_vmscan_direct_reclaim_begin",	NULL,	false },
+	{ "lru_shrink",		"LRU Shrink Inactive",
+	  "vmscan/mm_vmscan_lru_shrink_inactive",	NULL,	false },
+};
+
+#define HW_CACHE(cache, op, result)			\
+	((PERF_COUNT_HW_CACHE_ ## cache) |		\
+	 (PERF_COUNT_HW_CACHE_OP_ ## op << 8) |		\
+	 (PERF_COUNT_HW_CACHE_RESULT_ ## result << 16))
+
+static const perf_info_t perf_hw_info[] = {
+	{ "cycles",		"CPU Cycles",
+	  PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CPU_CYCLES,
+	  "task_clock",		"Task Clock (ns)",	PERF_COUNT_SW_TASK_CLOCK },
+	{ "dtlb_load_misses",	"dTLB Load Misses",
+	  PERF_TYPE_HW_CACHE,	HW_CACHE(DTLB, READ, MISS),
+	  "minor_faults",	"Minor Page Faults",	PERF_COUNT_SW_PAGE_FAULTS_MIN },
+	{ "itlb_load_misses",	"iTLB Load Misses",
+	  PERF_TYPE_HW_CACHE,	HW_CACHE(ITLB, READ, MISS),
+	  "major_faults",	"Major Page Faults",	PERF_COUNT_SW_PAGE_FAULTS_MAJ },
+	{ "llc_load_misses",	"LLC Load Misses",
+	  PERF_TYPE_HW_CACHE,	HW_CACHE(LL, READ, MISS),
+	  NULL,			NULL,			0 },
+	{ "cache_misses",	"Cache Misses",
+	  PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CACHE_MISSES,
+	  NULL,			NULL,			0 },
+};
 
+/* tracefs mount points, newer location first */
+static const char *perf_tracefs[] = {
+	"/sys/kernel/tracing",
+	"/sys/kernel/debug/tracing",
 };
 
+/*
+ *  perf_time_now()
+ *	monotonic time in seconds
+ */
+static double perf_time_now(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		return 0.0;
+	return (double)ts.tv_sec + ((double)ts.tv_nsec / 1000000000.0);
+}
+
 static inline unsigned long
 perf_type_tracepoint_resolve_config(const char *path)
 {
-	char perf_path[PATH_MAX];
-	unsigned long config;
-	FILE *fp;
+	size_t i;
 
-	(void)snprintf(perf_path, sizeof(perf_path),
-		"/sys/kernel/debug/tracing/events/%s/id", path);
-	if ((fp = fopen(perf_path, "r")) == NULL)
-		return UNRESOLVED;
-	if (fscanf(fp, "%lu", &config) != 1) {
-		fclose(fp);
+	if (!path)
 		return UNRESOLVED;
+
+	for (i = 0; i < sizeof(perf_tracefs) / sizeof(perf_tracefs[0]); i++) {
+		char perf_path[PATH_MAX];
+		unsigned long config;
+		FILE *fp;
+
+		(void)snprintf(perf_path, sizeof(perf_path),
+			"%s/events/%s/id", perf_tracefs[i], path);
+		if ((fp = fopen(perf_path, "r")) == NULL)
+			continue;
+		if (fscanf(fp, "%lu", &config) != 1) {
+			(void)fclose(fp);
+			continue;
+		}
+		(void)fclose(fp);
+		return config;
+	}
+	return UNRESOLVED;
+}
+
+/*
+ *  perf_tp_config()
+ *	get tracepoint config, resolve only once
+ */
+static unsigned long perf_tp_config(perf_stat_t *ps)
+{
+	if (ps->config == UNRESOLVED) {
+		ps->config = perf_type_tracepoint_resolve_config(ps->path);
+		if (ps->config == UNRESOLVED)
+			ps->config = perf_type_tracepoint_resolve_config(ps->alt_path);
 	}
-	(void)fclose(fp);
+	return ps->config;
+}
+
+/*
+ *  perf_event_add()
+ *	add an event to the set of events to be counted,
+ *	either a known event name or a system/event
+ *	tracepoint name
+ */
+static int perf_event_add(
+	perf_t *p,
+	const char *name,
+	const size_t len)
+{
+	size_t i;
+	perf_stat_t *ps;
+
+	if ((len == 0) || (len >= PERF_TP_PATH_MAX))
+		return -1;
+	if (p->perf_events >= PERF_MAX)
+		return -1;
 
-	return config;
+	ps = &p->perf_stat[p->perf_events];
+	(void)memset(ps, 0, sizeof(*ps));
+	ps->fd = -1;
+	ps->type = PERF_TYPE_TRACEPOINT;
+	ps->config = UNRESOLVED;
+
+	for (i = 0; i < sizeof(perf_tp_info) / sizeof(perf_tp_info[0]); i++) {
+		const perf_tp_info_t *tp = &perf_tp_info[i];
+
+		if ((strlen(tp->name) == len) && !strncmp(tp->name, name, len)) {
+			(void)snprintf(ps->path, sizeof(ps->path), "%s", tp->path);
+			ps->alt_path = tp->alt_path;
+			ps->name = tp->name;
+			ps->label = tp->label;
+			p->perf_events++;
+			return 0;
+		}
+	}
+	if (!memchr(name, '/', len))
+		return -1;
+	(void)memcpy(ps->path, name, len);
+	ps->path[len] = '\0';
+	ps->name = ps->path;
+	ps->label = ps->path;
+	p->perf_events++;
+
+	return 0;
+}
+
+/*
+ *  perf_events_parse()
+ *	parse a comma separated list of events, "default"
+ *	and "all" select the default and all known events
+ */
+int perf_events_parse(perf_t *p, const char *list)
+{
+	const char *ptr = list;
+
+	while (*ptr) {
+		const char *end = strchr(ptr, ',');
+		const size_t len = end ? (size_t)(end - ptr) : strlen(ptr);
+		size_t i;
+
+		if (((len == 3) && !strncmp(ptr, "all", len)) ||
+		    ((len == 7) && !strncmp(ptr, "default", len))) {
+			const bool all = (len == 3);
+
+			for (i = 0; i < sizeof(perf_tp_info) / sizeof(perf_tp_info[0]); i++) {
+				const perf_tp_info_t *tp = &perf_tp_info[i];
+
+				if (!all && !tp->def)
+					continue;
+				if (perf_find(p, tp->name) >= 0)
+					continue;
+				if (perf_event_add(p, tp->name, strlen(tp->name)) < 0)
+					return -1;
+			}
+		} else if (perf_event_add(p, ptr, len) < 0) {
+			return -1;
+		}
+		if (!end)
+			break;
+		ptr = end + 1;
+	}
+	return 0;
+}
+
+/*
+ *  perf_hw_events()
+ *	set up the hardware TLB and cache miss events,
+ *	these are opened one by one rather than as a group
+ *	as there may not be enough free PMU counters to
+ *	schedule them all at once, e.g. with SMT and the
+ *	NMI watchdog, each is scaled by its running time
+ */
+void perf_hw_events(perf_t *p)
+{
+	size_t i;
+
+	p->perf_events = 0;
+	p->ungrouped = true;
+	for (i = 0; i < sizeof(perf_hw_info) / sizeof(perf_hw_info[0]); i++) {
+		const perf_info_t *info = &perf_hw_info[i];
+		perf_stat_t *ps = &p->perf_stat[p->perf_events++];
+
+		(void)memset(ps, 0, sizeof(*ps));
+		ps->fd = -1;
+		ps->type = info->type;
+		ps->config = info->config;
+		ps->info = info;
+		ps->name = info->name;
+		ps->label = info->label;
+	}
 }
 
+/*
+ *  perf_open()
+ *	open a counter, as part of the group if
+ *	there is already a group leader
+ */
+static int perf_open(
+	const perf_t *p,
+	const unsigned long type,
+	const unsigned long config,
+	const pid_t pid)
+{
+	struct perf_event_attr attr;
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = (p->ungrouped || (p->group_fd < 0)) ? 1 : 0;
+	attr.inherit = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_ID |
+			   PERF_FORMAT_TOTAL_TIME_ENABLED |
+			   PERF_FORMAT_TOTAL_TIME_RUNNING;
+	if (!p->ungrouped)
+		attr.read_format |= PERF_FORMAT_GROUP;
+	attr.size = sizeof(attr);
+
+	return syscall(__NR_perf_event_open, &attr, pid, -1,
+		p->ungrouped ? -1 : p->group_fd, 0);
+}
+
+/*
+ *  perf_events_show()
+ *	list the known event names
+ */
+void perf_events_show(void)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(perf_tp_info) / sizeof(perf_tp_info[0]); i++) {
+		const perf_tp_info_t *tp = &perf_tp_info[i];
+
+		(void)printf(" %-18s %-27s %s\n", tp->name, tp->label,
+			tp->def ? "(default)" : "");
+	}
+}
+
+/*
+ *  perf_start()
+ *	open all the counters as one group and
+ *	enable them, they are left running until
+ *	perf_stop() is called. Events that are not
+ *	available are skipped, it is only an error
+ *	if none can be opened
+ */
 int perf_start(perf_t *p, const pid_t pid)
 {
 	int i;
 
+	if (!p->perf_events)
+		(void)perf_events_parse(p, "default");
+
+	p->perf_opened = 0;
+	p->group_fd = -1;
+	for (i = 0; i < p->perf_events; i++)
+		p->perf_stat[i].fd = -1;
 	if (pid <= 0)
 		return 0;
-	p->perf_opened = 0;
-	for (i = 0; i < PERF_MAX; i++) {
-		struct perf_event_attr attr;
-
-		(void)memset(&attr, 0, sizeof(attr));
-		attr.type = PERF_TYPE_TRACEPOINT;
-		attr.config = perf_type_tracepoint_resolve_config(perf_tp_info[i].path);
-		attr.disabled = 1;
-		attr.inherit = 1;
-		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
-				   PERF_FORMAT_TOTAL_TIME_RUNNING;
-		attr.size = sizeof(attr);
-		p->perf_stat[i].fd = syscall(__NR_perf_event_open, &attr, pid, -1, -1, 0);
-		if (p->perf_stat[i].fd > -1)
-			p->perf_opened++;
-		else
-			return -1;
+
+	for (i = 0; i < p->perf_events; i++) {
+		perf_stat_t *ps = &p->perf_stat[i];
+		const perf_info_t *info = ps->info;
+
+		ps->counter = 0;
+		ps->prev_counter = 0;
+		ps->rate = 0.0;
+		ps->valid = false;
+
+		if (ps->type == PERF_TYPE_TRACEPOINT) {
+			const unsigned long config = perf_tp_config(ps);
+
+			if (config == UNRESOLVED)
+				continue;
+			ps->fd = perf_open(p, ps->type, config, pid);
+		} else {
+			ps->fd = perf_open(p, ps->type, ps->config, pid);
+			/* No PMU support? Try the software fallback */
+			if ((ps->fd < 0) && info && info->fb_label) {
+				ps->fd = perf_open(p, PERF_TYPE_SOFTWARE,
+						   info->fb_config, pid);
+				if (ps->fd > -1) {
+					ps->type = PERF_TYPE_SOFTWARE;
+					ps->config = info->fb_config;
+					ps->name = info->fb_name;
+					ps->label = info->fb_label;
+				}
+			}
+		}
+		if (ps->fd < 0)
+			continue;
+		if (ioctl(ps->fd, PERF_EVENT_IOC_ID, &ps->id) < 0) {
+			(void)close(ps->fd);
+			ps->fd = -1;
+			continue;
+		}
+		if (p->group_fd < 0)
+			p->group_fd = ps->fd;
+		p->perf_opened++;
+	}
+	if (!p->perf_opened)
+		return -1;
+
+	for (i = 0; i < p->perf_events; i++) {
+		const int fd = p->ungrouped ? p->perf_stat[i].fd : p->group_fd;
+
+		if (fd < 0)
+			continue;
+		if (ioctl(fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP) < 0)
+			goto err;
+		if (ioctl(fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) < 0)
+			goto err;
+		if (!p->ungrouped)
+			break;
+	}
+	p->rate_time = perf_time_now();
+
+	return 0;
+err:
+	(void)perf_stop(p);
+	return -1;
+}
+
+/*
+ *  perf_scale()
+ *	scale a counter up for the time it was not
+ *	running because the PMU was multiplexed
+ */
+static uint64_t perf_scale(
+	const uint64_t counter,
+	const uint64_t time_enabled,
+	const uint64_t time_running)
+{
+	const double scale = time_running ?
+		(double)time_enabled / (double)time_running :
+		((time_enabled == 0) ? 1.0 : 0.0);
+
+	return (uint64_t)((double)counter * scale);
+}
+
+/*
+ *  perf_read_ungrouped()
+ *	read the counters one by one, each is scaled by
+ *	its own running time as they are scheduled apart
+ */
+static int perf_read_ungrouped(perf_t *p)
+{
+	int i;
+
+	for (i = 0; i < p->perf_events; i++) {
+		perf_stat_t *ps = &p->perf_stat[i];
+		perf_single_t data;
+
+		if (ps->fd < 0)
+			continue;
+		if (read(ps->fd, &data, sizeof(data)) != (ssize_t)sizeof(data))
+			continue;
+		ps->counter = perf_scale(data.counter,
+			data.time_enabled, data.time_running);
+		ps->valid = true;
 	}
+	return 0;
+}
+
+/*
+ *  perf_read()
+ *	read all the counters in the group with one read
+ */
+int perf_read(perf_t *p)
+{
+	perf_data_t data;
+	ssize_t ret;
+	uint64_t i;
+	size_t j;
+
+	if (!p)
+		return -1;
 	if (!p->perf_opened)
 		return -1;
+	if (p->ungrouped)
+		return perf_read_ungrouped(p);
 
-	for (i = 0; i < PERF_MAX; i++) {
-		int fd = p->perf_stat[i].fd;
+	ret = read(p->group_fd, &data, sizeof(data));
+	if (ret < (ssize_t)(3 * sizeof(uint64_t)))
+		return -1;
+	if (data.nr > PERF_MAX)
+		return -1;
 
-		if (fd > -1) {
-			if (ioctl(fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP) < 0) {
-				(void)close(fd);
-				p->perf_stat[i].fd = -1;
+	for (i = 0; i < data.nr; i++) {
+		for (j = 0; j < (size_t)p->perf_events; j++) {
+			perf_stat_t *ps = &p->perf_stat[j];
+
+			if ((ps->fd < 0) || (ps->id != data.values[i].id))
 				continue;
-			}
-			if (ioctl(fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) < 0) {
-				(void)close(fd);
-				p->perf_stat[i].fd = -1;
-			}
+			ps->counter = perf_scale(data.values[i].counter,
+				data.time_enabled, data.time_running);
+			ps->valid = true;
+			break;
 		}
 	}
 	return 0;
 }
 
+/*
+ *  perf_sample()
+ *	read the counters and update the per second rates
+ *	over the time since the previous sample, the caller
+ *	decides how often to sample
+ */
+int perf_sample(perf_t *p)
+{
+	size_t j;
+	double now, duration;
+
+	if (perf_read(p) < 0)
+		return -1;
+
+	now = perf_time_now();
+	duration = now - p->rate_time;
+	if (duration <= 0.0)
+		return 0;
+	for (j = 0; j < (size_t)p->perf_events; j++) {
+		perf_stat_t *ps = &p->perf_stat[j];
+
+		if (!ps->valid)
+			continue;
+		ps->rate = (double)(ps->counter - ps->prev_counter) / duration;
+		ps->prev_counter = ps->counter;
+	}
+	p->rate_time = now;
+	return 0;
+}
+
 /*
  *  perf_stop()
- *	stop and read counters
+ *	stop, read and close counters
  */
 int perf_stop(perf_t *p)
 {
@@ -121,29 +517,27 @@ int perf_stop(perf_t *p)
 		return -1;
 	if (!p->perf_opened)
 		return -1;
-	for (i = 0; i < PERF_MAX; i++) {
+
+	if (p->ungrouped) {
+		for (i = 0; i < (size_t)p->perf_events; i++) {
+			if (p->perf_stat[i].fd > -1)
+				(void)ioctl(p->perf_stat[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+		}
+		(void)perf_read(p);
+	} else if (p->group_fd > -1) {
+		if (ioctl(p->group_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP) == 0)
+			(void)perf_read(p);
+	}
+	for (i = 0; i < (size_t)p->perf_events; i++) {
 		const int fd = p->perf_stat[i].fd;
 
-		/* assume invalid unless we get good data */
-		p->perf_stat[i].valid = false;
 		if (fd < 0)
 			continue;
-		if (ioctl(fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP) == 0) {
-			perf_data_t data;
-
-			if (read(fd, &data, sizeof(data)) == sizeof(data)) {
-				const double scale = data.time_running ?
-					data.time_enabled / data.time_running :
-					((data.time_enabled == 0) ? 1.0 : 0.0);
-
-				p->perf_stat[i].valid = true;
-				p->perf_stat[i].counter += (uint64_t)
-					((double)data.counter * scale);
-			}
-		}
 		(void)close(fd);
 		p->perf_stat[i].fd = -1;
 	}
+	p->group_fd = -1;
+	p->perf_opened = 0;
 	return 0;
 }
 
@@ -155,10 +549,217 @@ uint64_t perf_counter(
 	const perf_t *p,
 	const int i)
 {
-	if ((i < 0) || (i >= PERF_MAX))
+	if ((i < 0) || (i >= p->perf_events))
 		return 0ULL;
 	if (p->perf_stat[i].valid)
 		return p->perf_stat[i].counter;
 	return 0ULL;
 }
+
+/*
+ *  perf_rate
+ *	fetch counter rate per second via perf index
+ */
+double perf_rate(
+	const perf_t *p,
+	const int i)
+{
+	if ((i < 0) || (i >= p->perf_events))
+		return 0.0;
+	if (p->perf_stat[i].valid)
+		return p->perf_stat[i].rate;
+	return 0.0;
+}
+
+/*
+ *  perf_available
+ *	is the counter at perf index opened
+ */
+bool perf_available(
+	const perf_t *p,
+	const int i)
+{
+	if ((i < 0) || (i >= p->perf_events))
+		return false;
+	return p->perf_stat[i].fd > -1;
+}
+
+/*
+ *  perf_label
+ *	fetch human readable counter label via perf index
+ */
+const char *perf_label(
+	const perf_t *p,
+	const int i)
+{
+	if ((i < 0) || (i >= p->perf_events))
+		return "";
+	return p->perf_stat[i].label;
+}
+
+/*
+ *  perf_find
+ *	find perf index of a named event, -1 if not found
+ */
+int perf_find(
+	const perf_t *p,
+	const char *name)
+{
+	int i;
+
+	for (i = 0; i < p->perf_events; i++) {
+		if (!strcmp(p->perf_stat[i].name, name))
+			return i;
+	}
+	return -1;
+}
+
+/*
+ *  perf_sample_open()
+ *	open a page fault sampler on a thread and
+ *	mmap its ring buffer
+ */
+static int perf_sample_open(perf_ring_t *r, const pid_t tid, const size_t page_size)
+{
+	struct perf_event_attr attr;
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_SOFTWARE;
+	attr.config = PERF_COUNT_SW_PAGE_FAULTS;
+	attr.sample_period = 1;
+	attr.sample_type = PERF_SAMPLE_ADDR;
+	attr.exclude_kernel = 1;
+	attr.size = sizeof(attr);
+
+	r->fd = syscall(__NR_perf_event_open, &attr, tid, -1, -1, 0);
+	if (r->fd < 0)
+		return -1;
+
+	r->size = (1 + PERF_SAMPLE_DATA_PAGES) * page_size;
+	r->buf = mmap(NULL, r->size, PROT_READ | PROT_WRITE, MAP_SHARED, r->fd, 0);
+	if (r->buf == MAP_FAILED) {
+		(void)close(r->fd);
+		r->fd = -1;
+		r->buf = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  perf_sample_start()
+ *	start sampling user space page fault addresses on
+ *	all the threads of a process. mmap'd ring buffers
+ *	cannot be inherited, so open one per thread
+ */
+int perf_sample_start(perf_sample_t *ps, const pid_t pid)
+{
+	char path[PATH_MAX];
+	const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	DIR *dir;
+	struct dirent *d;
+
+	ps->nrings = 0;
+	ps->lost = 0;
+	if (pid <= 0)
+		return -1;
+
+	(void)snprintf(path, sizeof(path), "/proc/%d/task", pid);
+	dir = opendir(path);
+	if (!dir)
+		return -1;
+	while ((d = readdir(dir)) != NULL) {
+		pid_t tid;
+
+		if (ps->nrings >= PERF_SAMPLE_MAX_RINGS)
+			break;
+		if (!isdigit(d->d_name[0]))
+			continue;
+		tid = (pid_t)strtol(d->d_name, NULL, 10);
+		if (perf_sample_open(&ps->rings[ps->nrings], tid, page_size) == 0)
+			ps->nrings++;
+	}
+	(void)closedir(dir);
+
+	return ps->nrings ? 0 : -1;
+}
+
+/*
+ *  perf_sample_drain()
+ *	consume all the samples in the ring buffers in
+ *	place, calling func on each fault address. Returns
+ *	number of samples consumed
+ */
+uint64_t perf_sample_drain(
+	perf_sample_t *ps,
+	perf_sample_func_t func,
+	void *arg)
+{
+	int i;
+	uint64_t n = 0;
+
+	for (i = 0; i < ps->nrings; i++) {
+		struct perf_event_mmap_page *mp = ps->rings[i].buf;
+		const uint8_t *data = (uint8_t *)mp + mp->data_offset;
+		const uint64_t mask = mp->data_size - 1;
+		const uint64_t head = __atomic_load_n(&mp->data_head, __ATOMIC_ACQUIRE);
+		uint64_t tail = mp->data_tail;
+
+		/*
+		 *  Records are 8 byte aligned so the header never
+		 *  straddles the end of the buffer, but a record can,
+		 *  e.g. samples following a 24 byte lost record, so
+		 *  those are copied out in two parts first
+		 */
+		while (tail < head) {
+			const uint64_t offset = tail & mask;
+			const struct perf_event_header *hdr =
+				(const struct perf_event_header *)(data + offset);
+			uint64_t record[8];
+
+			if (hdr->size == 0)
+				break;
+			if (offset + hdr->size > mp->data_size) {
+				const size_t first = (size_t)(mp->data_size - offset);
+
+				if (hdr->size > sizeof(record)) {
+					tail += hdr->size;
+					continue;
+				}
+				(void)memcpy(record, hdr, first);
+				(void)memcpy((uint8_t *)record + first, data,
+					hdr->size - first);
+				hdr = (const struct perf_event_header *)record;
+			}
+			if (hdr->type == PERF_RECORD_SAMPLE) {
+				const uint64_t *addr = (const uint64_t *)(hdr + 1);
+
+				func(*addr, arg);
+				n++;
+			} else if (hdr->type == PERF_RECORD_LOST) {
+				const uint64_t *lost = (const uint64_t *)(hdr + 1);
+
+				ps->lost += lost[1];
+			}
+			tail += hdr->size;
+		}
+		__atomic_store_n(&mp->data_tail, tail, __ATOMIC_RELEASE);
+	}
+	return n;
+}
+
+/*
+ *  perf_sample_stop()
+ *	unmap and close all the sample ring buffers
+ */
+void perf_sample_stop(perf_sample_t *ps)
+{
+	int i;
+
+	for (i = 0; i < ps->nrings; i++) {
+		(void)munmap(ps->rings[i].buf, ps->rings[i].size);
+		(void)close(ps->rings[i].fd);
+	}
+	ps->nrings = 0;
+}
 #endif
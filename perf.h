@@ -31,48 +31,109 @@
 #define PERF_ENABLED
 #endif
 
-enum {
-	PERF_TP_PAGE_FAULT_USER = 0,
-	PERF_TP_PAGE_FAULT_KERNEL,
-	PERF_TP_MM_PAGE_ALLOC,
-	PERF_TP_MM_PAGE_FREE,
-	PERF_MAX
-};
+#define PERF_MAX		(32)	/* Max events per group */
+#define PERF_TP_PATH_MAX	(64)	/* Max tracepoint system/event length */
 
 /* per perf counter info */
 typedef struct {
 	uint64_t counter;               /* perf counter */
+	uint64_t prev_counter;		/* counter at last rate sample */
+	uint64_t id;			/* perf event id */
+	double	 rate;			/* events per second */
+	unsigned long type;		/* perf type */
+	unsigned long config;		/* config, cached if a tracepoint */
+	const void *info;		/* hardware event info, or NULL */
+	const char *name;		/* short event name */
+	const char *label;		/* human readable label */
+	const char *alt_path;		/* alternative tracepoint, or NULL */
+	char	 path[PERF_TP_PATH_MAX];/* tracepoint system/event */
 	bool	 valid;			/* is it valid */
 	int      fd;                    /* perf per counter fd */
 } perf_stat_t;
 
 typedef struct {
 	perf_stat_t perf_stat[PERF_MAX];/* perf counters */
+	double rate_time;		/* time of last rate sample */
+	int group_fd;			/* group leader fd */
 	int perf_opened;		/* count of opened counters */
+	int perf_events;		/* count of configured counters */
+	bool ungrouped;			/* counters opened and scaled one by one */
 } perf_t;
 
-/* used for table of perf events to gather */
+/* used for table of hardware perf events to gather */
 typedef struct {
-	int id;				/* stress-ng perf ID */
+	const char *name;		/* short event name */
+	const char *label;		/* human readable label */
 	unsigned long type;		/* perf types */
 	unsigned long config;		/* perf type specific config */
+	const char *fb_name;		/* software fallback name, or NULL */
+	const char *fb_label;		/* software fallback label, or NULL */
+	unsigned long fb_config;	/* software fallback config */
 } perf_info_t;
 
-/* perf trace point id -> path resolution */
+/* perf trace point name -> path resolution */
 typedef struct {
-	int id;				/* stress-ng perf ID */
-	char *path;			/* path to config value */
+	const char *name;		/* short event name */
+	const char *label;		/* human readable label */
+	const char *path;		/* tracepoint system/event */
+	const char *alt_path;		/* older kernel tracepoint, or NULL */
+	bool def;			/* enabled by default */
 } perf_tp_info_t;
 
-/* perf data */
+/* perf group read data, PERF_FORMAT_GROUP | PERF_FORMAT_ID layout */
 typedef struct {
-	uint64_t counter;		/* perf counter */
+	uint64_t nr;			/* number of counters */
 	uint64_t time_enabled;		/* perf time enabled */
 	uint64_t time_running;		/* perf time running */
+	struct {
+		uint64_t counter;	/* perf counter */
+		uint64_t id;		/* perf event id */
+	} values[PERF_MAX];
 } perf_data_t;
 
+/* single counter read data, PERF_FORMAT_ID layout */
+typedef struct {
+	uint64_t counter;		/* perf counter */
+	uint64_t time_enabled;		/* perf time enabled */
+	uint64_t time_running;		/* perf time running */
+	uint64_t id;			/* perf event id */
+} perf_single_t;
+
+#define PERF_SAMPLE_MAX_RINGS	(64)	/* Max threads sampled */
+#define PERF_SAMPLE_DATA_PAGES	(32)	/* Ring buffer data pages, power of 2 */
+
+/* per thread mmap'd sample ring buffer */
+typedef struct {
+	void	*buf;			/* mmap'd ring buffer */
+	size_t	size;			/* size of mapping */
+	int	fd;			/* perf sampling fd */
+} perf_ring_t;
+
+/* fault address sampling context */
+typedef struct {
+	perf_ring_t rings[PERF_SAMPLE_MAX_RINGS];
+	int	nrings;			/* number of rings in use */
+	uint64_t lost;			/* lost sample count */
+} perf_sample_t;
+
+/* callback for each sampled fault address */
+typedef void (*perf_sample_func_t)(const uint64_t addr, void *arg);
+
+extern int perf_events_parse(perf_t *p, const char *list);
+extern void perf_hw_events(perf_t *p);
+extern void perf_events_show(void);
 extern int perf_start(perf_t *p, const pid_t pid);
 extern int perf_stop(perf_t *p);
+extern int perf_read(perf_t *p);
+extern int perf_sample(perf_t *p);
 extern uint64_t perf_counter(const perf_t *p, const int id);
+extern double perf_rate(const perf_t *p, const int id);
+extern bool perf_available(const perf_t *p, const int id);
+extern const char *perf_label(const perf_t *p, const int id);
+extern int perf_find(const perf_t *p, const char *name);
+extern int perf_sample_start(perf_sample_t *ps, const pid_t pid);
+extern uint64_t perf_sample_drain(perf_sample_t *ps,
+	perf_sample_func_t func, void *arg);
+extern void perf_sample_stop(perf_sample_t *ps);
 
 #endif